@@ -0,0 +1,141 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+
+Arena::Arena()
+	: current(nullptr), usedBlocks(0), capacity(0), peakUsed(0), blockAllocations(0)
+{
+}
+
+void *Arena::allocateFrom(Block &block, size_t size, size_t alignment)
+{
+	size_t offset = block.offset.load(std::memory_order_relaxed);
+	for (;;) {
+		uintptr_t start = reinterpret_cast<uintptr_t>(block.data.get()) + offset;
+		size_t padding = (alignment - start % alignment) % alignment;
+		if (padding + size > block.size - offset) return nullptr;
+		// On failure offset is reloaded, another thread was faster
+		if (block.offset.compare_exchange_weak(offset, offset + padding + size, std::memory_order_relaxed)) {
+			return reinterpret_cast<void *>(start + padding);
+		}
+	}
+}
+
+void *Arena::allocate(size_t size, size_t alignment)
+{
+	if (size == 0) size = 1;
+	for (;;) {
+		Block *block = this->current.load(std::memory_order_acquire);
+		if (block != nullptr) {
+			void *memory = allocateFrom(*block, size, alignment);
+			if (memory != nullptr) return memory;
+		}
+
+		// Only one thread adds the block, the others use it
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->current.load(std::memory_order_relaxed) == block) this->addBlock(size + alignment);
+	}
+}
+
+void Arena::addBlock(size_t minimumSize)
+{
+	// The blocks that rewind() gave back come first. The ones that are too small go, their memory is worth less
+	// than a block that fits.
+	while (this->usedBlocks < this->blocks.size()) {
+		Block *spare = this->blocks[this->usedBlocks].get();
+		if (spare->size >= minimumSize) {
+			spare->offset.store(0, std::memory_order_relaxed);
+			this->usedBlocks++;
+			this->current.store(spare, std::memory_order_release);
+			return;
+		}
+		this->capacity -= spare->size;
+		this->blocks.erase(this->blocks.begin() + this->usedBlocks);
+	}
+
+	// Every block is at least as big as all blocks before it, so a file needs few of them.
+	size_t size = std::max(std::max(minimumSize, static_cast<size_t>(MinBlockSize)), this->capacity);
+	this->blocks.push_back(std::unique_ptr<Block>(new Block(size)));
+	this->capacity += size;
+	this->blockAllocations++;
+	this->usedBlocks = this->blocks.size();
+	this->current.store(this->blocks.back().get(), std::memory_order_release);
+}
+
+void Arena::reset()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	// One block that holds the biggest file so far, but not more than MaxRetainedSize
+	size_t used = std::max(this->peakUsed, this->sumUsed());
+	size_t retained = this->blocks.empty() ? 0 : this->blocks.front()->size;
+	size_t size = std::min(std::max(retained, used), static_cast<size_t>(MaxRetainedSize));
+	this->peakUsed = 0;
+	if (retained == size) {
+		this->blocks.resize(std::min(this->blocks.size(), static_cast<size_t>(1)));
+	}
+	else {
+		this->blocks.clear();
+		this->blocks.push_back(std::unique_ptr<Block>(new Block(size)));
+		this->blockAllocations++;
+	}
+	this->capacity = size;
+	this->usedBlocks = this->blocks.size();
+	if (this->blocks.empty()) return;
+	this->blocks.front()->offset.store(0, std::memory_order_relaxed);
+	this->current.store(this->blocks.front().get(), std::memory_order_release);
+}
+
+Arena::Marker Arena::mark() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Marker marker;
+	marker.blockCount = this->usedBlocks;
+	if (this->usedBlocks > 0) marker.offset = this->blocks[this->usedBlocks - 1]->offset.load(std::memory_order_relaxed);
+	return marker;
+}
+
+void Arena::rewind(const Marker &marker)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->peakUsed = std::max(this->peakUsed, this->sumUsed());
+	// The blocks after the marker become spares
+	for (size_t i = marker.blockCount; i < this->usedBlocks; i++) {
+		this->blocks[i]->offset.store(0, std::memory_order_relaxed);
+	}
+	this->usedBlocks = marker.blockCount;
+	if (this->usedBlocks == 0) {
+		this->current.store(nullptr, std::memory_order_release);
+		return;
+	}
+	Block *block = this->blocks[this->usedBlocks - 1].get();
+	block->offset.store(marker.offset, std::memory_order_relaxed);
+	this->current.store(block, std::memory_order_release);
+}
+
+size_t Arena::sumUsed() const
+{
+	size_t used = 0;
+	for (size_t i = 0; i < this->usedBlocks; i++) {
+		used += this->blocks[i]->offset.load(std::memory_order_relaxed);
+	}
+	return used;
+}
+
+size_t Arena::getUsed() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->sumUsed();
+}
+
+size_t Arena::getCapacity() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->capacity;
+}
+
+uint64_t Arena::getBlockAllocations() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->blockAllocations;
+}
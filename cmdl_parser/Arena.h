@@ -0,0 +1,178 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+// Monotonic allocator for everything that is parsed from one file: the section table, the materials, the vertex
+// attributes and the submeshes. Allocating is a pointer bump, freeing does nothing, and reset() drops everything
+// at once when the file is done. reset() keeps one block that holds the biggest file so far, up to MaxRetainedSize,
+// so an arena that is reused for the next file (one per worker in batch mode) stops allocating once it has seen the
+// biggest file, and a single huge file doesn't keep its memory for the rest of the batch.
+// Memory that is only needed for a while, e.g. the buffers of a writer, is given back with rewind() (or ArenaScope)
+// and handed out again. The blocks added in the meantime are kept and reused.
+// The memory is handed out uninitialized.
+// Can be used from several threads at the same time, e.g. by the submesh sections that are decoded in parallel: the
+// bump is a compare-and-swap on the offset of the current block, only adding a block takes the mutex.
+class Arena
+{
+public:
+	static const size_t MinBlockSize = 256 * 1024;
+	static const size_t MaxRetainedSize = 64 * 1024 * 1024;
+
+	// A position in the arena to rewind to
+	struct Marker
+	{
+		size_t blockCount;	// Blocks in use
+		size_t offset;		// In the last of them
+
+		Marker() : blockCount(0), offset(0) {}
+	};
+
+	Arena();
+
+	void *allocate(size_t size, size_t alignment);
+	// Everything allocated before is invalid afterwards. Objects in the arena must have been destroyed before.
+	void reset();
+	// Everything allocated after the marker was taken is invalid afterwards, like with reset(). Markers are rewound
+	// in the reverse order they were taken, and not while other threads allocate.
+	Marker mark() const;
+	void rewind(const Marker &marker);
+
+	// Bytes handed out since the last reset and not rewound
+	size_t getUsed() const;
+	size_t getCapacity() const;
+	// Blocks allocated from the heap since the arena was made
+	uint64_t getBlockAllocations() const;
+
+private:
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	struct Block
+	{
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+		std::atomic<size_t> offset;
+
+		explicit Block(size_t size) : data(new uint8_t[size]), size(size), offset(0) {}
+	};
+
+	// Bumps the offset of the block, returns null if the block is full.
+	static void *allocateFrom(Block &block, size_t size, size_t alignment);
+	// Moves on to the next spare block that is big enough, or allocates one.
+	void addBlock(size_t minimumSize);
+	// The mutex must be held
+	size_t sumUsed() const;
+
+private:
+	mutable std::mutex mutex;						// Guards everything but current and the block offsets
+	std::vector<std::unique_ptr<Block> > blocks;	// The ones in use, followed by the spares
+	std::atomic<Block *> current;					// The last block in use, the one allocated from
+	size_t usedBlocks;
+	size_t capacity;								// Of all blocks
+	size_t peakUsed;								// Since the last reset, updated by rewind()
+	uint64_t blockAllocations;
+};
+
+// Rewinds the arena to where it was when the scope was made, when the scope goes away. Everything made from the
+// arena in the scope must be gone by then. Does nothing without an arena.
+class ArenaScope
+{
+public:
+	explicit ArenaScope(Arena *arena) : arena(arena)
+	{
+		if (arena != nullptr) this->marker = arena->mark();
+	}
+	~ArenaScope()
+	{
+		if (this->arena != nullptr) this->arena->rewind(this->marker);
+	}
+
+private:
+	ArenaScope(const ArenaScope &) = delete;
+	ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+	Arena *arena;
+	Arena::Marker marker;
+};
+
+// Standard allocator on top of an Arena, or on the heap without one (the default).
+// A copy of a container is always made on the heap, so it can outlive the file, e.g. a material in the
+// MaterialLibrary. Moving a container takes its allocator along.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator() : arena(nullptr) {}
+	explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+	template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.getArena()) {}
+
+	T *allocate(size_t count)
+	{
+		if (this->arena != nullptr) return static_cast<T *>(this->arena->allocate(count * sizeof(T), alignof(T)));
+		return static_cast<T *>(::operator new(count * sizeof(T)));
+	}
+	void deallocate(T *pointer, size_t)
+	{
+		if (this->arena == nullptr) ::operator delete(pointer);
+	}
+	ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+	Arena *getArena() const { return this->arena; }
+
+	template <typename U> bool operator==(const ArenaAllocator<U> &other) const { return this->arena == other.getArena(); }
+	template <typename U> bool operator!=(const ArenaAllocator<U> &other) const { return this->arena != other.getArena(); }
+
+private:
+	Arena *arena;
+};
+
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > ArenaString;
+
+// Empties the container and lets go of its memory, so it doesn't point into the arena after a reset.
+template <typename Container>
+void releaseArenaMemory(Container &container)
+{
+	Container(container.get_allocator()).swap(container);
+}
+
+// Deletes objects made by makeArenaObject(). Objects in an arena are only destroyed, their memory goes with the arena.
+template <typename T>
+struct ArenaDeleter
+{
+	bool inArena;
+
+	ArenaDeleter() : inArena(false) {}
+	explicit ArenaDeleter(bool inArena) : inArena(inArena) {}
+	// Takes over objects made with new
+	ArenaDeleter(const std::default_delete<T> &) : inArena(false) {}
+
+	void operator()(T *object) const
+	{
+		if (this->inArena) object->~T();
+		else delete object;
+	}
+};
+
+template <typename T> using ArenaPtr = std::unique_ptr<T, ArenaDeleter<T> >;
+
+// Makes the object in the arena, or with new if arena is null.
+template <typename T, typename... Args>
+ArenaPtr<T> makeArenaObject(Arena *arena, Args &&... args)
+{
+	if (arena == nullptr) return ArenaPtr<T>(new T(std::forward<Args>(args)...));
+	void *memory = arena->allocate(sizeof(T), alignof(T));
+	return ArenaPtr<T>(new (memory) T(std::forward<Args>(args)...), ArenaDeleter<T>(true));
+}
@@ -0,0 +1,153 @@
+#include "AssetSource.h"
+#include "ConversionCache.h"
+
+
+BufferPool::BufferPool()
+{
+}
+
+std::vector<uint8_t> BufferPool::acquire(size_t size)
+{
+	std::vector<uint8_t> buffer;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		// The smallest free buffer that is big enough, so big buffers are kept for big resources
+		size_t best = this->freeBuffers.size();
+		for (size_t i = 0; i < this->freeBuffers.size(); i++) {
+			if (this->freeBuffers[i].capacity() < size) continue;
+			if (best == this->freeBuffers.size() || this->freeBuffers[i].capacity() < this->freeBuffers[best].capacity()) best = i;
+		}
+		if (best < this->freeBuffers.size()) {
+			buffer.swap(this->freeBuffers[best]);
+			this->freeBuffers.erase(this->freeBuffers.begin() + best);
+		}
+	}
+	buffer.resize(size);
+	return buffer;
+}
+
+void BufferPool::release(std::vector<uint8_t> &&buffer)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->freeBuffers.size() < MaxFreeBuffers) {
+		this->freeBuffers.push_back(std::move(buffer));
+	}
+}
+
+
+Asset::Asset()
+	: pool(nullptr)
+{
+}
+
+Asset::~Asset()
+{
+	this->release();
+}
+
+ByteSpan Asset::span() const
+{
+	return this->data;
+}
+
+void Asset::release()
+{
+	this->file.reset();
+	if (this->pool != nullptr) {
+		this->pool->release(std::move(this->buffer));
+		this->pool = nullptr;
+	}
+	this->buffer = std::vector<uint8_t>();
+	this->data = ByteSpan();
+}
+
+void Asset::setFile(std::unique_ptr<MappedFile> file)
+{
+	this->release();
+	this->file = std::move(file);
+	this->data = this->file->span();
+}
+
+void Asset::setView(const ByteSpan &data)
+{
+	this->release();
+	this->data = data;
+}
+
+void Asset::setBuffer(std::vector<uint8_t> &&buffer, BufferPool *pool)
+{
+	this->release();
+	this->buffer = std::move(buffer);
+	this->pool = pool;
+	this->data = ByteSpan(this->buffer.data(), this->buffer.size());
+}
+
+
+LooseFileSource::LooseFileSource(const std::string &directory, const std::string &extension)
+	: directory(directory), extension(extension)
+{
+}
+
+bool LooseFileSource::contains(uint64_t id) const
+{
+	return MappedFile::getFileSize(this->getFileName(id)) >= 0;
+}
+
+bool LooseFileSource::load(uint64_t id, Asset &asset, std::string &error)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->open(this->getFileName(id))) {
+		error = "Failed to open " + this->getFileName(id);
+		return false;
+	}
+	asset.setFile(std::move(file));
+	return true;
+}
+
+std::string LooseFileSource::describe(uint64_t id) const
+{
+	return this->getFileName(id);
+}
+
+std::string LooseFileSource::getFileName(uint64_t id) const
+{
+	return this->directory + ConversionCache::getTextureFileName(id, this->extension.c_str());
+}
+
+
+void AssetSourceList::add(AssetSource *source)
+{
+	this->sources.push_back(source);
+}
+
+bool AssetSourceList::contains(uint64_t id) const
+{
+	for (size_t i = 0; i < this->sources.size(); i++) {
+		if (this->sources[i]->contains(id)) return true;
+	}
+	return false;
+}
+
+bool AssetSourceList::load(uint64_t id, Asset &asset, std::string &error)
+{
+	AssetSource *source = this->find(id);
+	if (source == nullptr) {
+		error = "No source for the resource";
+		return false;
+	}
+	return source->load(id, asset, error);
+}
+
+std::string AssetSourceList::describe(uint64_t id) const
+{
+	AssetSource *source = this->find(id);
+	return source != nullptr ? source->describe(id) : std::string();
+}
+
+AssetSource *AssetSourceList::find(uint64_t id) const
+{
+	for (size_t i = 0; i < this->sources.size(); i++) {
+		if (this->sources[i]->contains(id)) return this->sources[i];
+	}
+	return this->sources.empty() ? nullptr : this->sources.back();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <stdint.h>
+
+#include "MappedFile.h"
+
+// Recycles the buffers that compressed resources are decompressed into, so converting many resources doesn't
+// allocate and free big blocks all the time. Can be used from any number of threads.
+class BufferPool
+{
+public:
+	// Free buffers beyond this are released
+	static const size_t MaxFreeBuffers = 16;
+
+	BufferPool();
+
+	// Returns a buffer of the size, with undefined contents.
+	std::vector<uint8_t> acquire(size_t size);
+	void release(std::vector<uint8_t> &&buffer);
+
+private:
+	BufferPool(const BufferPool &) = delete;
+	BufferPool &operator=(const BufferPool &) = delete;
+
+private:
+	std::mutex mutex;
+	std::vector<std::vector<uint8_t> > freeBuffers;
+};
+
+// The bytes of one loaded resource: a loose file mapped into memory, a resource stored uncompressed in a mapped
+// archive, or a decompressed copy in a pooled buffer. The bytes stay valid until the asset is released or destroyed.
+class Asset
+{
+public:
+	Asset();
+	~Asset();
+
+	ByteSpan span() const;
+	void release();
+
+	void setFile(std::unique_ptr<MappedFile> file);
+	void setView(const ByteSpan &data);
+	// The buffer goes back to the pool on release.
+	void setBuffer(std::vector<uint8_t> &&buffer, BufferPool *pool);
+
+private:
+	Asset(const Asset &) = delete;
+	Asset &operator=(const Asset &) = delete;
+
+private:
+	std::unique_ptr<MappedFile> file;
+	std::vector<uint8_t> buffer;
+	BufferPool *pool;
+	ByteSpan data;
+};
+
+// Where models and textures are read from, by their 64-bit file id.
+// load() can be called from any number of threads at the same time.
+class AssetSource
+{
+public:
+	virtual ~AssetSource() {}
+
+	virtual bool contains(uint64_t id) const = 0;
+	// Fills asset with the bytes of the resource. On failure error receives the reason.
+	virtual bool load(uint64_t id, Asset &asset, std::string &error) = 0;
+	// Describes where the resource comes from, for messages
+	virtual std::string describe(uint64_t id) const = 0;
+};
+
+// Loose files named <directory><id as 16 hex digits><extension>, e.g. Textures/0123456789abcdef.TXTR
+class LooseFileSource : public AssetSource
+{
+public:
+	// directory needs a trailing slash.
+	LooseFileSource(const std::string &directory, const std::string &extension);
+
+	bool contains(uint64_t id) const override;
+	bool load(uint64_t id, Asset &asset, std::string &error) override;
+	std::string describe(uint64_t id) const override;
+
+private:
+	std::string getFileName(uint64_t id) const;
+
+private:
+	std::string directory;
+	std::string extension;
+};
+
+// Tries several sources in order, e.g. the archives of the run and then the loose files.
+class AssetSourceList : public AssetSource
+{
+public:
+	// The list doesn't own the sources.
+	void add(AssetSource *source);
+
+	bool contains(uint64_t id) const override;
+	bool load(uint64_t id, Asset &asset, std::string &error) override;
+	std::string describe(uint64_t id) const override;
+
+private:
+	// The first source that has the resource, or the last one
+	AssetSource *find(uint64_t id) const;
+
+private:
+	std::vector<AssetSource *> sources;
+};
@@ -0,0 +1,225 @@
+#include "Benchmark.h"
+#include "CmdlParser.h"
+#include "ObjWriter.h"
+#include "Material.h"
+#include "ConversionCache.h"
+#include "Stopwatch.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+
+// Texture ids of the synthetic models. Only the textures of the texture cases are generated.
+static const uint64_t benchmarkTextureIds[] = {
+	0x1000000000000001ULL, 0x1000000000000002ULL, 0x1000000000000003ULL,
+	0x1000000000000004ULL, 0x1000000000000005ULL, 0x1000000000000006ULL
+};
+
+
+void Benchmark::StageResult::addRun(double runSeconds)
+{
+	if (this->seconds == 0.0 || runSeconds < this->seconds) {
+		this->seconds = runSeconds;
+	}
+}
+
+Benchmark::Benchmark(const std::string &workDir, unsigned int iterations, std::ostream &out)
+	: workDir(workDir), iterations(iterations > 0 ? iterations : 1), out(out), pool(0)
+{
+	if (!this->workDir.empty() && this->workDir[this->workDir.length() - 1] != '/' && this->workDir[this->workDir.length() - 1] != '\\') {
+		this->workDir += "/";
+	}
+}
+
+bool Benchmark::run()
+{
+	CreateDirectoryA(this->workDir.c_str(), NULL);
+	CreateDirectoryA((this->workDir + "Textures/").c_str(), NULL);
+	CreateDirectoryA((this->workDir + "Textures/dds/").c_str(), NULL);
+
+	this->out << "Benchmark in " << (this->workDir.empty() ? "." : this->workDir) << ", best of " << this->iterations << " runs, "
+		<< this->pool.getThreadCount() << " threads" << std::endl;
+
+	SyntheticData::ModelParameters parameters;
+	parameters.vertexCount = 60000;
+	parameters.submeshCount = 64;
+	parameters.primitivesPerSubmesh = 400;
+	parameters.textureIds.assign(benchmarkTextureIds, benchmarkTextureIds + sizeof(benchmarkTextureIds) / sizeof(benchmarkTextureIds[0]));
+
+	bool success = this->runModel("float_positions", parameters);
+
+	parameters.quantizedPositions = true;
+	parameters.seed = 2;
+	success &= this->runModel("quantized_positions", parameters);
+
+	parameters.visibilityGroups = true;
+	parameters.seed = 3;
+	success &= this->runModel("visibility_groups", parameters);
+
+	success &= this->runTexture("texture_1024", 1024, 1024, 11);
+	success &= this->runTexture("texture_256", 256, 256, 9);
+	return success;
+}
+
+bool Benchmark::runModel(const std::string &name, const SyntheticData::ModelParameters &parameters)
+{
+	std::string inputFile = this->workDir + name + ".CMDL";
+	std::string objFile = this->workDir + name + ".obj";
+	if (!SyntheticData::writeFile(inputFile, SyntheticData::generateCmdl(parameters))) {
+		this->out << "Failed to write " << inputFile << std::endl;
+		return false;
+	}
+
+	// The parser reports nothing of interest here, and printing would be measured too.
+	std::ostream nullLog(nullptr);
+	StageResult header, materials, vertices, primitives, parallelPrimitives, objOutput, optimization;
+	MeshOptimizer::Result optimizationResult;
+
+	for (unsigned int i = 0; i < this->iterations; i++) {
+		CmdlParser parser(nullLog);
+		Mesh mesh;
+
+		Stopwatch stopwatch;
+		if (!parser.open(inputFile)) {
+			this->out << "Failed to open " << inputFile << std::endl;
+			return false;
+		}
+		header.addRun(stopwatch.getSeconds());
+
+		stopwatch.restart();
+		if (!parser.parseMaterials(mesh)) {
+			this->out << "Failed to parse the materials of " << inputFile << std::endl;
+			return false;
+		}
+		materials.addRun(stopwatch.getSeconds());
+
+		stopwatch.restart();
+		parser.decodeVertices(mesh);
+		vertices.addRun(stopwatch.getSeconds());
+
+		const CMDL_HEADER &fileHeader = parser.getHeader();
+		stopwatch.restart();
+		mesh.resizeSubmeshes(fileHeader.sectionCount > CmdlParser::FirstSubmeshSection ? fileHeader.sectionCount - CmdlParser::FirstSubmeshSection : 0);
+		for (unsigned int s = CmdlParser::FirstSubmeshSection; s < fileHeader.sectionCount; s++) {
+			if (!parser.decodeSubmesh(s, mesh, mesh.submeshes[s - CmdlParser::FirstSubmeshSection])) {
+				this->out << "Failed to decode submesh " << s << " of " << inputFile << std::endl;
+				return false;
+			}
+		}
+		primitives.addRun(stopwatch.getSeconds());
+
+		// The same sections again, spread over the pool like CmdlConverter does
+		std::vector<Submesh> parallelSubmeshes(mesh.submeshes.size());
+		std::vector<char> decoded(mesh.submeshes.size());
+		std::vector<ParseError> errors(mesh.submeshes.size());
+		stopwatch.restart();
+		this->pool.parallelFor(parallelSubmeshes.size(), [&parser, &mesh, &parallelSubmeshes, &decoded, &errors, &nullLog](size_t s) {
+			decoded[s] = parser.decodeSubmesh(CmdlParser::FirstSubmeshSection + static_cast<unsigned int>(s), mesh, parallelSubmeshes[s], nullLog, errors[s]);
+		});
+		parallelPrimitives.addRun(stopwatch.getSeconds());
+		if (std::find(decoded.begin(), decoded.end(), 0) != decoded.end()) {
+			this->out << "Failed to decode the submeshes of " << inputFile << " in parallel" << std::endl;
+			return false;
+		}
+
+		stopwatch.restart();
+		ObjWriter writer(objFile);
+		writer.writeMesh(mesh, name + ".mtl");
+		if (!writer.close()) {
+			this->out << "Failed to write " << objFile << std::endl;
+			return false;
+		}
+		objOutput.addRun(stopwatch.getSeconds());
+
+		stopwatch.restart();
+		MeshOptimizer optimizer;
+		optimizationResult = optimizer.optimize(mesh);
+		optimization.addRun(stopwatch.getSeconds());
+
+		if (i == 0) {
+			header.bytes = fileHeader.sectionOffsets[0];
+			materials.bytes = fileHeader.sectionSizes[0];
+			vertices.bytes = static_cast<uint64_t>(fileHeader.sectionSizes[1]) + fileHeader.sectionSizes[2] + fileHeader.sectionSizes[5];
+			for (unsigned int s = CmdlParser::FirstSubmeshSection; s < fileHeader.sectionCount; s++) {
+				primitives.bytes += fileHeader.sectionSizes[s];
+			}
+			for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+				primitives.triangles += mesh.submeshes[s].triangleCount();
+			}
+			parallelPrimitives.bytes = primitives.bytes;
+			parallelPrimitives.triangles = primitives.triangles;
+			objOutput.triangles = primitives.triangles;
+			optimization.triangles = primitives.triangles;
+		}
+		parser.close();
+		objOutput.bytes = static_cast<uint64_t>(MappedFile::getFileSize(objFile));
+	}
+
+	this->printHeader(name);
+	this->printStage("header parse", header);
+	this->printStage("material parse", materials);
+	this->printStage("vertex decode", vertices);
+	this->printStage("primitive decode", primitives);
+	this->printStage("  parallel", parallelPrimitives);
+	this->printStage("OBJ write", objOutput);
+	this->printStage("mesh optimize", optimization);
+	char acmr[64];
+	sprintf_s(acmr, sizeof(acmr), "    ACMR %.3f -> %.3f", optimizationResult.getAcmrBefore(), optimizationResult.getAcmrAfter());
+	this->out << acmr << std::endl;
+	return true;
+}
+
+bool Benchmark::runTexture(const std::string &name, uint16_t width, uint16_t height, uint32_t mipCount)
+{
+	std::string textureDir = this->workDir + "Textures/";
+	uint64_t textureId = benchmarkTextureIds[0] ^ (static_cast<uint64_t>(width) << 16 | height);
+	std::vector<uint8_t> txtr = SyntheticData::generateTxtr(width, height, mipCount, width);
+	if (!SyntheticData::writeFile(textureDir + ConversionCache::getTextureFileName(textureId, ".TXTR"), txtr)) {
+		this->out << "Failed to write the texture of " << name << std::endl;
+		return false;
+	}
+
+	std::ostream nullLog(nullptr);
+	StageResult conversion;
+	conversion.bytes = txtr.size();
+	for (unsigned int i = 0; i < this->iterations; i++) {
+		Stopwatch stopwatch;
+		if (!Material::convertTXTRtoDDS(textureId, textureDir, nullLog)) {
+			this->out << "Failed to convert the texture of " << name << std::endl;
+			return false;
+		}
+		conversion.addRun(stopwatch.getSeconds());
+	}
+
+	this->printHeader(name);
+	this->printStage("texture convert", conversion);
+	return true;
+}
+
+void Benchmark::printHeader(const std::string &caseName)
+{
+	char line[128];
+	sprintf_s(line, sizeof(line), "%-20s %10s %10s %10s %10s", caseName.c_str(), "ms", "MB", "MB/s", "Mtris/s");
+	this->out << std::endl << line << std::endl;
+}
+
+void Benchmark::printStage(const char *stageName, const StageResult &result)
+{
+	double megabytes = static_cast<double>(result.bytes) / (1024.0 * 1024.0);
+	double seconds = result.seconds > 0.0 ? result.seconds : 1e-9;
+	char line[128];
+	if (result.triangles > 0) {
+		sprintf_s(line, sizeof(line), "  %-18s %10.3f %10.2f %10.1f %10.2f", stageName, result.seconds * 1000.0, megabytes,
+			megabytes / seconds, static_cast<double>(result.triangles) / seconds / 1e6);
+	}
+	else {
+		sprintf_s(line, sizeof(line), "  %-18s %10.3f %10.2f %10.1f %10s", stageName, result.seconds * 1000.0, megabytes, megabytes / seconds, "-");
+	}
+	this->out << line << std::endl;
+}
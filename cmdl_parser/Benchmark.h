@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#include "SyntheticData.h"
+#include "ThreadPool.h"
+
+// Times every stage of the conversion on synthetic files (-bench), so changes can be measured without game data.
+// Every stage is run several times and the fastest run is reported, as MB/s of its input and triangles/s.
+class Benchmark
+{
+public:
+	// The synthetic files and all outputs are written to workDir (with trailing slash).
+	Benchmark(const std::string &workDir, unsigned int iterations, std::ostream &out);
+
+	// Returns false if a file could not be written or converted.
+	bool run();
+
+private:
+	struct StageResult
+	{
+		double seconds;		// Fastest run
+		uint64_t bytes;		// Bytes consumed (or written by the output stages)
+		uint64_t triangles;
+
+		StageResult() : seconds(0.0), bytes(0), triangles(0) {}
+		void addRun(double runSeconds);
+	};
+
+	bool runModel(const std::string &name, const SyntheticData::ModelParameters &parameters);
+	bool runTexture(const std::string &name, uint16_t width, uint16_t height, uint32_t mipCount);
+	void printHeader(const std::string &caseName);
+	void printStage(const char *stageName, const StageResult &result);
+
+private:
+	std::string workDir;
+	unsigned int iterations;
+	std::ostream &out;
+	ThreadPool pool;	// For the parallel stages, one thread per hardware thread
+};
@@ -0,0 +1,215 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+
+// Cost of visiting a node, relative to intersecting one triangle
+static const float TraversalCost = 1.0f;
+
+
+static void setEmpty(float3 boundingBox[2])
+{
+	const float infinity = std::numeric_limits<float>::infinity();
+	boundingBox[0].x = boundingBox[0].y = boundingBox[0].z = infinity;
+	boundingBox[1].x = boundingBox[1].y = boundingBox[1].z = -infinity;
+}
+
+static void extend(float3 boundingBox[2], const float3 &min, const float3 &max)
+{
+	boundingBox[0].x = std::min(boundingBox[0].x, min.x);
+	boundingBox[0].y = std::min(boundingBox[0].y, min.y);
+	boundingBox[0].z = std::min(boundingBox[0].z, min.z);
+	boundingBox[1].x = std::max(boundingBox[1].x, max.x);
+	boundingBox[1].y = std::max(boundingBox[1].y, max.y);
+	boundingBox[1].z = std::max(boundingBox[1].z, max.z);
+}
+
+// Half the surface area, the factor doesn't matter for the SAH
+static float halfArea(const float3 boundingBox[2])
+{
+	float dx = boundingBox[1].x - boundingBox[0].x;
+	float dy = boundingBox[1].y - boundingBox[0].y;
+	float dz = boundingBox[1].z - boundingBox[0].z;
+	if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static float getComponent(const float3 &value, int axis)
+{
+	return (axis == 0) ? value.x : ((axis == 1) ? value.y : value.z);
+}
+
+static unsigned int getBin(float centroid, float axisMin, float binScale)
+{
+	float bin = (centroid - axisMin) * binScale;
+	return bin > 0.0f ? std::min(static_cast<unsigned int>(bin), Bvh::BinCount - 1) : 0; // NaN goes to bin 0
+}
+
+// Indices past the end of the positions are the origin, like in the writers.
+static float3 getPosition(const AttributeArray3 &positions, unsigned short index)
+{
+	float3 position = { 0.0f, 0.0f, 0.0f };
+	if (index < positions.size()) {
+		position.x = positions.x[index];
+		position.y = positions.y[index];
+		position.z = positions.z[index];
+	}
+	return position;
+}
+
+
+void Bvh::build(const Mesh &mesh)
+{
+	this->nodes.clear();
+	this->triangles.clear();
+	this->depth = 0;
+
+	size_t triangleCount = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		triangleCount += mesh.submeshes[s].indices.size() / 3;
+	}
+	if (triangleCount == 0) return;
+
+	this->triangleMin.resize(triangleCount);
+	this->triangleMax.resize(triangleCount);
+	this->centroids.resize(triangleCount);
+	this->triangles.resize(triangleCount);
+	uint32_t t = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const ArenaVector<IndexTriplet> &indices = mesh.submeshes[s].indices;
+		for (size_t c = 0; c + 2 < indices.size(); c += 3, t++) {
+			float3 a = getPosition(mesh.positions, indices[c].pos);
+			float3 b = getPosition(mesh.positions, indices[c + 1].pos);
+			float3 d = getPosition(mesh.positions, indices[c + 2].pos);
+			float3 &min = this->triangleMin[t];
+			float3 &max = this->triangleMax[t];
+			min.x = std::min(std::min(a.x, b.x), d.x);
+			min.y = std::min(std::min(a.y, b.y), d.y);
+			min.z = std::min(std::min(a.z, b.z), d.z);
+			max.x = std::max(std::max(a.x, b.x), d.x);
+			max.y = std::max(std::max(a.y, b.y), d.y);
+			max.z = std::max(std::max(a.z, b.z), d.z);
+			this->centroids[t].x = 0.5f * (min.x + max.x);
+			this->centroids[t].y = 0.5f * (min.y + max.y);
+			this->centroids[t].z = 0.5f * (min.z + max.z);
+			this->triangles[t] = t;
+		}
+	}
+
+	// Depth first, so the children of a node are next to each other and close to it
+	this->nodes.resize(1);
+	Task root = { 0, 0, static_cast<uint32_t>(triangleCount), 1 };
+	this->tasks.assign(1, root);
+	while (!this->tasks.empty()) {
+		Task task = this->tasks.back();
+		this->tasks.pop_back();
+		this->splitNode(task);
+	}
+}
+
+void Bvh::splitNode(const Task &task)
+{
+	this->depth = std::max(this->depth, task.depth);
+
+	float3 bounds[2], centroidBounds[2];
+	setEmpty(bounds);
+	setEmpty(centroidBounds);
+	for (uint32_t i = task.first; i < task.first + task.count; i++) {
+		uint32_t t = this->triangles[i];
+		extend(bounds, this->triangleMin[t], this->triangleMax[t]);
+		extend(centroidBounds, this->centroids[t], this->centroids[t]);
+	}
+	BvhNode &node = this->nodes[task.node];
+	node.boundingBox[0] = bounds[0];
+	node.boundingBox[1] = bounds[1];
+	node.first = task.first;
+	node.triangleCount = task.count;
+	if (task.count <= 2) return;
+
+	// The axis along which the centroids spread the most
+	float extents[3] = { centroidBounds[1].x - centroidBounds[0].x, centroidBounds[1].y - centroidBounds[0].y, centroidBounds[1].z - centroidBounds[0].z };
+	int axis = 0;
+	if (extents[1] > extents[axis]) axis = 1;
+	if (extents[2] > extents[axis]) axis = 2;
+
+	// The middle of the list if the bins can't split the triangles
+	uint32_t middle = task.first + task.count / 2;
+	if (extents[axis] > 0.0f) {
+		Bin bins[BinCount];
+		for (unsigned int b = 0; b < BinCount; b++) {
+			setEmpty(bins[b].boundingBox);
+			bins[b].count = 0;
+		}
+		float binScale = BinCount / extents[axis];
+		float axisMin = getComponent(centroidBounds[0], axis);
+		for (uint32_t i = task.first; i < task.first + task.count; i++) {
+			uint32_t t = this->triangles[i];
+			unsigned int b = getBin(getComponent(this->centroids[t], axis), axisMin, binScale);
+			extend(bins[b].boundingBox, this->triangleMin[t], this->triangleMax[t]);
+			bins[b].count++;
+		}
+
+		// Cost of splitting after bin b: the areas and triangle counts of both sides
+		float rightCost[BinCount];
+		float3 side[2];
+		setEmpty(side);
+		uint32_t sideCount = 0;
+		for (unsigned int b = BinCount - 1; b > 0; b--) {
+			extend(side, bins[b].boundingBox[0], bins[b].boundingBox[1]);
+			sideCount += bins[b].count;
+			rightCost[b - 1] = halfArea(side) * sideCount;
+		}
+		float bestCost = std::numeric_limits<float>::infinity();
+		unsigned int bestSplit = 0;
+		setEmpty(side);
+		sideCount = 0;
+		for (unsigned int b = 0; b + 1 < BinCount; b++) {
+			extend(side, bins[b].boundingBox[0], bins[b].boundingBox[1]);
+			sideCount += bins[b].count;
+			float cost = halfArea(side) * sideCount + rightCost[b];
+			if (sideCount > 0 && sideCount < task.count && cost < bestCost) {
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		// A leaf is cheaper if intersecting all its triangles costs less than visiting the children
+		float area = halfArea(bounds);
+		if (area > 0.0f && TraversalCost + bestCost / area >= task.count && task.count <= MaxLeafTriangles) return;
+
+		if (bestCost < std::numeric_limits<float>::infinity()) {
+			const std::vector<float3> &centroids = this->centroids;
+			middle = static_cast<uint32_t>(std::partition(this->triangles.begin() + task.first, this->triangles.begin() + task.first + task.count,
+				[&centroids, axis, axisMin, binScale, bestSplit](uint32_t t) { return getBin(getComponent(centroids[t], axis), axisMin, binScale) <= bestSplit; }) - this->triangles.begin());
+		}
+	}
+	else if (task.count <= MaxLeafTriangles) {
+		return; // All centroids in one point, no split separates them
+	}
+
+	uint32_t children = static_cast<uint32_t>(this->nodes.size());
+	this->nodes.resize(this->nodes.size() + 2);
+	BvhNode &parent = this->nodes[task.node];
+	parent.first = children;
+	parent.triangleCount = 0;
+	Task left = { children, task.first, middle - task.first, task.depth + 1 };
+	Task right = { children + 1, middle, task.first + task.count - middle, task.depth + 1 };
+	this->tasks.push_back(right);
+	this->tasks.push_back(left);
+}
+
+const std::vector<BvhNode> &Bvh::getNodes() const
+{
+	return this->nodes;
+}
+
+const std::vector<uint32_t> &Bvh::getTriangles() const
+{
+	return this->triangles;
+}
+
+unsigned int Bvh::getDepth() const
+{
+	return this->depth;
+}
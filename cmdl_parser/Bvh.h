@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+
+struct BvhNode
+{
+	float3 boundingBox[2];	// Min and max
+	uint32_t first;			// Interior node: index of the left child, the right one follows it. Leaf: first entry of the triangle list.
+	uint32_t triangleCount;	// 0 for interior nodes
+};
+
+// Bounding volume hierarchy over the triangles of a Mesh (-bvh), for culling and ray picking without loading the
+// whole mesh. Built top-down with the surface area heuristic (SAH) on binned triangle centroids.
+// The triangles are numbered like in the mesh file: the triangle lists of all submeshes one after the other. Kept
+// strips are left out.
+class Bvh
+{
+public:
+	static const unsigned int BinCount = 16;
+	static const unsigned int MaxLeafTriangles = 16;	// Bigger leaves are always split
+
+	// Node 0 is the root. Without triangles there are no nodes.
+	void build(const Mesh &mesh);
+
+	const std::vector<BvhNode> &getNodes() const;
+	// Triangle numbers. Every leaf holds a range of them.
+	const std::vector<uint32_t> &getTriangles() const;
+	unsigned int getDepth() const;
+
+private:
+	struct Bin
+	{
+		float3 boundingBox[2];
+		uint32_t count;
+	};
+
+	struct Task
+	{
+		uint32_t node;
+		uint32_t first;
+		uint32_t count;
+		unsigned int depth;
+	};
+
+	// Makes the node of the task a leaf, or splits it and adds its children to the tasks.
+	void splitNode(const Task &task);
+
+private:
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> triangles;
+	// Bounds and centroid of every triangle
+	std::vector<float3> triangleMin, triangleMax, centroids;
+	std::vector<Task> tasks;
+	unsigned int depth;
+};
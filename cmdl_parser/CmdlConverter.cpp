@@ -0,0 +1,527 @@
+#include "CmdlConverter.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+
+
+// Everything in the options that changes the output
+static std::string getOptionsKey(const ConversionOptions &options)
+{
+	char text[160];
+	sprintf_s(text, sizeof(text), "obj=%d glb=%d cmesh=%d float=%d precision=%d glbTextures=%d strips=%d optimize=%d quantize=%d", options.writeObj ? 1 : 0, options.writeGlb ? 1 : 0, options.writeCmesh ? 1 : 0,
+		static_cast<int>(options.floatFormat), options.floatPrecision, static_cast<int>(options.glbTextures), options.keepStrips ? 1 : 0, options.optimize ? 1 : 0, options.quantize ? 1 : 0);
+	std::string key = text;
+	if (options.writeCmesh) key += " cmeshVersion=" + std::to_string(MeshFile::Version);
+	if (options.buildBvh) key += " bvh=1";
+	if (options.splitGroups) key += " split=1";
+	for (size_t i = 0; i < options.visibilityGroups.size(); i++) {
+		key += " group=" + options.visibilityGroups[i];
+	}
+	return key;
+}
+
+// Group names can hold any character, the output names only the ones that are safe in file names.
+static std::string getGroupOutputName(const std::string &outputName, const ArenaString &group)
+{
+	std::string name = outputName + "_" + std::string(group.data(), group.size());
+	for (size_t i = outputName.length() + 1; i < name.length(); i++) {
+		if (!isalnum(static_cast<unsigned char>(name[i])) && name[i] != '_' && name[i] != '-' && name[i] != '.') name[i] = '_';
+	}
+	return name;
+}
+
+
+CmdlConverter::CmdlConverter(const ConversionJob &job, TextureQueue &textureQueue, ConversionCache *cache, ThreadPool *pool, std::ostream &log, Arena *arena /*= nullptr*/)
+	: job(job), textureQueue(textureQueue), cache(cache), pool(pool), log(log), arena(arena), parser(log, arena), mesh(arena), submeshSections(ArenaAllocator<unsigned int>(arena))
+{
+}
+
+bool CmdlConverter::convert()
+{
+	Stopwatch stopwatch;
+	this->stats = FileStats();
+	this->stats.inputFile = this->job.inputFile;
+	this->stats.success = this->convertModel();
+
+	// The whole parse state goes at once
+	this->parser.close();
+	this->mesh.clear();
+	releaseArenaMemory(this->submeshSections);
+	this->input.release();
+	if (this->arena != nullptr) this->arena->reset();
+	this->stats.totalSeconds = stopwatch.getSeconds();
+	return this->stats.success;
+}
+
+const FileStats &CmdlConverter::getStats() const
+{
+	return this->stats;
+}
+
+bool CmdlConverter::convertModel()
+{
+	this->stats.bytesRead = this->job.fileSize;
+	this->outputNames.assign(1, this->job.outputName);
+	if (this->job.source != nullptr && !this->loadInput()) {
+		return false;
+	}
+
+	uint64_t cacheKey = 0;
+	if (this->cache != nullptr && this->isCached(cacheKey)) {
+		this->stats.cached = true;
+		return true;
+	}
+
+	// The GLB and mesh file writers, the optimization and the atlas need the whole mesh, so streaming only works for plain OBJ output.
+	// Models from a source are in memory already.
+	bool streaming = this->job.options.streamSubmeshes && this->job.options.writeObj && !this->job.options.writeGlb && !this->job.options.writeCmesh
+		&& !this->job.options.optimize && this->job.options.atlas == nullptr && !this->job.options.splitGroups && this->job.source == nullptr;
+	Stopwatch stopwatch;
+	bool opened = (this->job.source != nullptr) ? this->parser.open(this->input.span())
+		: this->parser.open(this->job.inputFile, streaming ? CmdlParser::StreamSubmeshes : CmdlParser::MapFile);
+	if (!opened) {
+		this->setError(this->parser.getError());
+		return false;
+	}
+	this->stats.headerSeconds = stopwatch.getSeconds();
+	// The OBJ and mesh file writers only understand triangles.
+	if (this->job.options.keepStrips && !this->job.options.writeObj && !this->job.options.writeCmesh) {
+		this->parser.setStripMode(PrimitiveDecoder::KeepStrips);
+	}
+
+	// The textures are converted while the geometry is decoded and written.
+	stopwatch.restart();
+	bool success = this->parser.parseMaterials(this->mesh);
+	this->stats.materialSeconds = stopwatch.getSeconds();
+	if (success) {
+		for (size_t i = 0; i < this->mesh.materials.size(); i++) {
+			if (this->mesh.materials[i]->getTextureId() != 0) this->textureQueue.request(this->mesh.materials[i]->getTextureId());
+		}
+		this->selectSubmeshSections();
+		success = streaming ? this->writeObjStreamed() : this->decodeGeometry();
+	}
+	if (!success && this->stats.error.empty()) {
+		this->setError(this->parser.getError());
+	}
+	this->parser.close();
+	this->input.release();
+	if (!success) return false;
+
+	this->log << "Triangles: " << this->stats.triangleListCount << std::endl;
+	this->log << "Fans: " << this->stats.fanCount << std::endl;
+	this->log << "Strips: " << this->stats.stripCount << std::endl;
+	if (this->stats.submeshesOutsideHeaderBox > 0) {
+		this->log << "Warning: " << this->stats.submeshesOutsideHeaderBox << " submeshes reach outside of the bounding box in the header" << std::endl;
+	}
+	this->stats.materialCount = this->mesh.materials.size();
+	this->stats.positionCount = this->mesh.positions.size();
+	this->stats.normalCount = this->mesh.normals.size();
+	this->stats.uvCount = this->mesh.uvs.size();
+
+	// Before the optimization, so it welds the moved UVs
+	if (this->job.options.atlas != nullptr) {
+		this->applyAtlas();
+	}
+	if (this->job.options.optimize) {
+		this->optimizeMesh();
+	}
+	if (this->job.options.materialLibrary != nullptr && !streaming) { // The streaming writer shares them before it starts
+		this->shareMaterials();
+	}
+
+	if (this->job.options.splitGroups && !this->mesh.visibilityGroups.empty()) {
+		success = this->writeGroups();
+	}
+	else if (!streaming) { // The streaming writer is done already
+		success = this->writeOutputs(this->mesh, this->job.outputName);
+	}
+
+	std::vector<std::string> outputFiles = this->getOutputFiles();
+	for (size_t i = 0; i < outputFiles.size(); i++) {
+		int64_t size = MappedFile::getFileSize(outputFiles[i]);
+		if (size > 0) this->stats.bytesWritten += size;
+	}
+
+	if (success && this->cache != nullptr) {
+		this->storeInCache(cacheKey);
+	}
+	return success;
+}
+
+void CmdlConverter::selectSubmeshSections()
+{
+	const CMDL_HEADER &header = this->parser.getHeader();
+	unsigned int sectionCount = static_cast<unsigned int>(header.sectionSizes.size());
+	const std::vector<std::string> &selectedNames = this->job.options.visibilityGroups;
+	this->submeshSections.clear();
+	this->submeshSections.reserve(sectionCount - CmdlParser::FirstSubmeshSection);
+	this->stats.submeshes.reserve(sectionCount - CmdlParser::FirstSubmeshSection);
+	if (selectedNames.empty() || header.visibilityGroups.empty()) {
+		for (unsigned int i = CmdlParser::FirstSubmeshSection; i < sectionCount; i++) {
+			this->submeshSections.push_back(i);
+		}
+		return;
+	}
+
+	std::vector<char> selected(header.visibilityGroups.size(), 0);
+	size_t selectedCount = 0;
+	for (size_t g = 0; g < header.visibilityGroups.size(); g++) {
+		std::string name(header.visibilityGroups[g].data(), header.visibilityGroups[g].size());
+		selected[g] = std::find(selectedNames.begin(), selectedNames.end(), name) != selectedNames.end();
+		if (selected[g]) selectedCount++;
+	}
+	// Submeshes that aren't in any group aren't selected either
+	for (unsigned int i = CmdlParser::FirstSubmeshSection; i < sectionCount; i++) {
+		uint16_t group = this->parser.getVisibilityGroup(i);
+		if (group != Submesh::NoVisibilityGroup && selected[group]) this->submeshSections.push_back(i);
+	}
+	this->stats.skippedSubmeshCount = sectionCount - CmdlParser::FirstSubmeshSection - this->submeshSections.size();
+	this->log << "Visibility groups selected: " << selectedCount << " of " << header.visibilityGroups.size() << ", submesh sections skipped: " << this->stats.skippedSubmeshCount << std::endl;
+}
+
+bool CmdlConverter::decodeGeometry()
+{
+	this->decodeVertexSections();
+
+	size_t submeshCount = this->submeshSections.size();
+	this->mesh.resizeSubmeshes(submeshCount);
+	if (this->pool == nullptr || this->pool->getThreadCount() < 2 || submeshCount < 2) {
+		for (size_t i = 0; i < submeshCount; i++) {
+			if (!this->decodeSubmeshSection(this->submeshSections[i], this->mesh.submeshes[i])) return false;
+		}
+		return true;
+	}
+
+	// Every section is decoded into its own Submesh. The logs and stats are merged in section order afterwards,
+	// so the result doesn't depend on which thread finished first.
+	// The section logs stay empty unless a section has something to report.
+	ArenaVector<LogBuffer> sectionLogs((ArenaAllocator<LogBuffer>(this->arena)));
+	sectionLogs.reserve(submeshCount);
+	for (size_t i = 0; i < submeshCount; i++) {
+		sectionLogs.emplace_back(this->arena);
+	}
+	ArenaVector<double> sectionSeconds(submeshCount, 0.0, ArenaAllocator<double>(this->arena));
+	ArenaVector<char> decoded(submeshCount, 0, ArenaAllocator<char>(this->arena));
+	ArenaVector<ParseError> errors(submeshCount, ParseError(), ArenaAllocator<ParseError>(this->arena));
+	const CmdlParser &parser = this->parser;
+	const ArenaVector<unsigned int> &sections = this->submeshSections;
+	Mesh &mesh = this->mesh;
+	this->pool->parallelFor(submeshCount, [&parser, &sections, &mesh, &sectionLogs, &sectionSeconds, &decoded, &errors](size_t i) {
+		Stopwatch stopwatch;
+		std::ostream sectionLog(&sectionLogs[i]);
+		decoded[i] = parser.decodeSubmesh(sections[i], mesh, mesh.submeshes[i], sectionLog, errors[i]);
+		sectionSeconds[i] = stopwatch.getSeconds();
+	});
+
+	for (size_t i = 0; i < submeshCount; i++) {
+		this->log << sectionLogs[i].getText();
+		if (!decoded[i]) {
+			this->setError(errors[i]);
+			return false;
+		}
+		this->addSubmeshStats(this->mesh.submeshes[i], sectionSeconds[i]);
+	}
+	return true;
+}
+
+void CmdlConverter::decodeVertexSections()
+{
+	Stopwatch stopwatch;
+	this->parser.decodePositions(this->mesh);
+	this->stats.positionSeconds = stopwatch.getSeconds();
+
+	stopwatch.restart();
+	this->parser.decodeNormals(this->mesh);
+	this->stats.normalSeconds = stopwatch.getSeconds();
+
+	stopwatch.restart();
+	this->parser.decodeUvs(this->mesh);
+	this->stats.uvSeconds = stopwatch.getSeconds();
+}
+
+bool CmdlConverter::decodeSubmeshSection(unsigned int sectionIndex, Submesh &submesh)
+{
+	Stopwatch stopwatch;
+	if (!this->parser.decodeSubmesh(sectionIndex, this->mesh, submesh)) return false;
+	this->addSubmeshStats(submesh, stopwatch.getSeconds());
+	return true;
+}
+
+void CmdlConverter::addSubmeshStats(const Submesh &submesh, double seconds)
+{
+	SubmeshStats submeshStats;
+	submeshStats.sectionIndex = submesh.sectionIndex;
+	submeshStats.seconds = seconds;
+	submeshStats.bytes = this->parser.getHeader().sectionSizes[submesh.sectionIndex];
+	submeshStats.triangles = submesh.triangleCount();
+	this->stats.submeshes.push_back(submeshStats);
+	this->stats.submeshSeconds += submeshStats.seconds;
+	this->stats.triangleCount += submeshStats.triangles;
+	this->stats.triangleListCount += submesh.triangleListCount;
+	this->stats.stripCount += submesh.stripCount;
+	this->stats.fanCount += submesh.fanCount;
+
+	// The header box should hold every submesh
+	const float3 *headerBox = this->mesh.boundingBox;
+	if (submesh.triangleCount() > 0 && (submesh.boundingBox[0].x < headerBox[0].x || submesh.boundingBox[0].y < headerBox[0].y || submesh.boundingBox[0].z < headerBox[0].z
+		|| submesh.boundingBox[1].x > headerBox[1].x || submesh.boundingBox[1].y > headerBox[1].y || submesh.boundingBox[1].z > headerBox[1].z)) {
+		this->stats.submeshesOutsideHeaderBox++;
+	}
+}
+
+bool CmdlConverter::loadInput()
+{
+	std::string error;
+	if (!this->job.source->load(this->job.assetId, this->input, error)) {
+		this->log << error << std::endl;
+		ParseError loadError;
+		loadError.message = error;
+		this->setError(loadError);
+		return false;
+	}
+	this->stats.bytesRead = this->input.span().size();
+	return true;
+}
+
+void CmdlConverter::setError(const ParseError &error)
+{
+	this->stats.error = error.message;
+	this->stats.errorSection = error.section;
+	this->stats.errorOffset = error.offset;
+}
+
+void CmdlConverter::optimizeMesh()
+{
+	Stopwatch stopwatch;
+	MeshOptimizer optimizer;
+	MeshOptimizer::Result result = optimizer.optimize(this->mesh);
+	this->stats.optimizeSeconds = stopwatch.getSeconds();
+	this->stats.optimizedVertexCount = result.vertexCount;
+	this->stats.degenerateTriangleCount = result.degenerateTriangles;
+	this->stats.acmrTrianglesBefore = result.trianglesBefore;
+	this->stats.cacheMissesBefore = result.cacheMissesBefore;
+	this->stats.acmrTrianglesAfter = result.trianglesAfter;
+	this->stats.cacheMissesAfter = result.cacheMissesAfter;
+
+	this->log << "Vertices: " << result.vertexCount << (result.welded ? "" : " (too many for 16-bit indices, not welded)") << std::endl;
+	this->log << "Degenerate triangles: " << result.degenerateTriangles << std::endl;
+	this->log << "ACMR: " << result.getAcmrBefore() << " -> " << result.getAcmrAfter() << std::endl;
+}
+
+void CmdlConverter::applyAtlas()
+{
+	size_t moved = this->job.options.atlas->apply(this->mesh, this->log);
+	this->log << "Submeshes moved into an atlas: " << moved << std::endl;
+}
+
+void CmdlConverter::shareMaterials()
+{
+	for (size_t i = 0; i < this->mesh.materials.size(); i++) {
+		Material &material = *this->mesh.materials[i];
+		material.setMaterialName(this->job.options.materialLibrary->add(material));
+	}
+}
+
+std::string CmdlConverter::getMaterialLibraryName(const std::string &outputName) const
+{
+	if (this->job.options.materialLibrary != nullptr) return this->job.options.materialLibrary->getFileName();
+	return outputName + ".mtl";
+}
+
+bool CmdlConverter::writeObjStreamed()
+{
+	this->decodeVertexSections();
+	if (this->job.options.materialLibrary != nullptr) {
+		this->shareMaterials();
+	}
+
+	Stopwatch stopwatch;
+	if (!this->writeMaterialLibrary(this->mesh, this->job.outputName)) return false;
+	ObjWriter outFile(this->job.outputDir + this->job.outputName + ".obj", this->job.options.floatFormat, this->job.options.floatPrecision, this->mesh.getArena());
+	if (!outFile.isOpen()) {
+		this->log << "Failed to create " << this->job.outputDir << this->job.outputName << ".obj" << std::endl;
+		return false;
+	}
+	outFile.writeVertexAttributes(this->mesh, this->getMaterialLibraryName(this->job.outputName));
+	this->stats.objSeconds += stopwatch.getSeconds();
+
+	// Every submesh is written as soon as it is decoded, so only one of them is in memory at a time.
+	Submesh submesh(this->mesh.getArena());
+	for (size_t i = 0; i < this->submeshSections.size(); i++) {
+		if (!this->decodeSubmeshSection(this->submeshSections[i], submesh)) return false;
+		stopwatch.restart();
+		outFile.writeSubmesh(this->mesh, submesh);
+		this->stats.objSeconds += stopwatch.getSeconds();
+	}
+
+	stopwatch.restart();
+	bool closed = outFile.close();
+	this->stats.objSeconds += stopwatch.getSeconds();
+	if (!closed) {
+		this->log << "Failed to write " << this->job.outputDir << this->job.outputName << ".obj" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CmdlConverter::isCached(uint64_t &key)
+{
+	uint64_t inputHash;
+	if (this->job.source != nullptr) {
+		inputHash = ConversionCache::hashBytes(this->input.span().data(), this->input.span().size());
+	}
+	else if (!ConversionCache::hashFile(this->job.inputFile, inputHash)) {
+		return false; // The conversion reports the error
+	}
+	key = ConversionCache::makeKey(inputHash, getOptionsKey(this->job.options));
+
+	CacheEntry entry;
+	if (!this->cache->lookup(ConversionCache::getModelEntryName(this->job.outputDir, this->job.outputName), key, entry)) {
+		return false;
+	}
+
+	// The textures are not part of the entry, they have their own ones. Requesting them checks these.
+	for (size_t i = 0; i < entry.textureIds.size(); i++) {
+		this->textureQueue.request(entry.textureIds[i]);
+	}
+	this->log << "Up to date (cached)" << std::endl;
+	return true;
+}
+
+void CmdlConverter::storeInCache(uint64_t key)
+{
+	CacheEntry entry;
+	entry.key = key;
+	entry.outputFiles = this->getOutputFiles();
+	for (size_t i = 0; i < this->mesh.materials.size(); i++) {
+		uint64_t textureId = this->mesh.materials[i]->getTextureId();
+		if (textureId != 0 && std::find(entry.textureIds.begin(), entry.textureIds.end(), textureId) == entry.textureIds.end()) {
+			entry.textureIds.push_back(textureId);
+		}
+	}
+
+	if (!this->cache->store(ConversionCache::getModelEntryName(this->job.outputDir, this->job.outputName), entry)) {
+		this->log << "Warning: Failed to write the cache entry" << std::endl;
+	}
+}
+
+std::vector<std::string> CmdlConverter::getOutputFiles() const
+{
+	std::vector<std::string> outputFiles;
+	for (size_t i = 0; i < this->outputNames.size(); i++) {
+		std::string outputPath = this->job.outputDir + this->outputNames[i];
+		if (this->job.options.writeObj) {
+			outputFiles.push_back(outputPath + ".obj");
+			if (this->job.options.materialLibrary == nullptr) outputFiles.push_back(outputPath + ".mtl");
+		}
+		if (this->job.options.writeGlb) {
+			outputFiles.push_back(outputPath + ".glb");
+		}
+		if (this->job.options.writeCmesh) {
+			outputFiles.push_back(outputPath + ".cmesh");
+		}
+	}
+	return outputFiles;
+}
+
+bool CmdlConverter::writeOutputs(const Mesh &mesh, const std::string &outputName)
+{
+	// The buffers of the writers are only needed until their file is written
+	ArenaScope writerScope(mesh.getArena());
+	Stopwatch stopwatch;
+	bool success = true;
+	if (this->job.options.writeObj) {
+		success = this->writeMaterialLibrary(mesh, outputName) && this->writeObj(mesh, outputName);
+		this->stats.objSeconds += stopwatch.getSeconds();
+	}
+	if (success && this->job.options.writeGlb) {
+		stopwatch.restart();
+		success = this->writeGlb(mesh, outputName);
+		this->stats.glbSeconds += stopwatch.getSeconds();
+	}
+	if (success && this->job.options.writeCmesh) {
+		stopwatch.restart();
+		success = this->writeCmesh(mesh, outputName);
+		this->stats.cmeshSeconds += stopwatch.getSeconds();
+	}
+	return success;
+}
+
+bool CmdlConverter::writeGroups()
+{
+	// The submeshes that aren't in any group go to the outputs of the job, if there are any
+	this->outputNames.clear();
+	MeshSplitter splitter;
+	bool success = true;
+	for (size_t g = 0; g <= this->mesh.visibilityGroups.size() && success; g++) {
+		uint16_t group = (g < this->mesh.visibilityGroups.size()) ? static_cast<uint16_t>(g) : Submesh::NoVisibilityGroup;
+		// Every group reuses the memory of the one before
+		ArenaScope groupScope(this->mesh.getArena());
+		Mesh groupMesh(this->mesh.getArena());
+		if (splitter.extractGroup(this->mesh, group, groupMesh) == 0) continue; // Nothing selected from the group
+
+		std::string outputName = (group == Submesh::NoVisibilityGroup) ? this->job.outputName : getGroupOutputName(this->job.outputName, this->mesh.visibilityGroups[g]);
+		// Names that only differ in the replaced characters
+		if (std::find(this->outputNames.begin(), this->outputNames.end(), outputName) != this->outputNames.end()) {
+			outputName += "_" + std::to_string(g);
+		}
+		this->outputNames.push_back(outputName);
+		this->log << "Visibility group " << outputName << ": " << groupMesh.submeshes.size() << " submeshes, " << groupMesh.positions.size() << " positions" << std::endl;
+		success = this->writeOutputs(groupMesh, outputName);
+		groupMesh.clear();
+	}
+	return success;
+}
+
+bool CmdlConverter::writeMaterialLibrary(const Mesh &mesh, const std::string &outputName)
+{
+	if (this->job.options.materialLibrary != nullptr) return true; // Written once for the whole batch
+	if (!ObjWriter::writeMaterialLibrary(this->job.outputDir + outputName + ".mtl", mesh)) {
+		this->log << "Failed to write " << this->job.outputDir << outputName << ".mtl" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CmdlConverter::writeObj(const Mesh &mesh, const std::string &outputName)
+{
+	ObjWriter outFile(this->job.outputDir + outputName + ".obj", this->job.options.floatFormat, this->job.options.floatPrecision, mesh.getArena());
+	if (!outFile.isOpen()) {
+		this->log << "Failed to create " << this->job.outputDir << outputName << ".obj" << std::endl;
+		return false;
+	}
+	outFile.writeMesh(mesh, this->getMaterialLibraryName(outputName));
+	if (!outFile.close()) {
+		this->log << "Failed to write " << this->job.outputDir << outputName << ".obj" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool CmdlConverter::writeGlb(const Mesh &mesh, const std::string &outputName)
+{
+	if (this->job.options.glbTextures == GlbWriter::EmbedTextures) { // The DDS files have to be complete before they can be copied
+		// Atlases are only written at the end of the batch, so they are referenced
+		for (size_t i = 0; i < mesh.materials.size(); i++) {
+			uint64_t textureId = mesh.materials[i]->getTextureId();
+			if (textureId != 0 && !TextureAtlas::isAtlasTexture(textureId)) this->textureQueue.waitFor(textureId);
+		}
+	}
+
+	GlbWriter glbWriter(this->log);
+	return glbWriter.write(this->job.outputDir + outputName + ".glb", mesh, this->job.options.glbTextures, this->textureQueue.getTextureDir() + "dds/", this->job.options.quantize);
+}
+
+bool CmdlConverter::writeCmesh(const Mesh &mesh, const std::string &outputName)
+{
+	Bvh bvh;
+	if (this->job.options.buildBvh) {
+		Stopwatch stopwatch;
+		bvh.build(mesh);
+		this->stats.bvhSeconds += stopwatch.getSeconds();
+		this->stats.bvhNodeCount += bvh.getNodes().size();
+		this->log << "BVH: " << bvh.getNodes().size() << " nodes, depth " << bvh.getDepth() << std::endl;
+	}
+	return MeshFile::write(this->job.outputDir + outputName + ".cmesh", mesh, this->job.options.quantize, this->job.options.buildBvh ? &bvh : nullptr, this->log);
+}
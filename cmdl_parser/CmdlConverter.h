@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#include "CmdlParser.h"
+#include "Mesh.h"
+#include "ObjWriter.h"
+#include "GlbWriter.h"
+#include "TextureQueue.h"
+#include "ConversionCache.h"
+#include "ConversionStats.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include "MeshFile.h"
+#include "MaterialLibrary.h"
+#include "TextureAtlas.h"
+#include "AssetSource.h"
+#include "MeshSplitter.h"
+#include "Bvh.h"
+#include "LogBuffer.h"
+
+// Settings shared by all files of a run.
+struct ConversionOptions
+{
+	bool writeObj;
+	bool writeGlb;
+	bool writeCmesh;		// Binary mesh file (MeshFile)
+	ObjWriter::FloatFormat floatFormat;
+	int floatPrecision;
+	GlbWriter::TextureMode glbTextures;
+	bool streamSubmeshes;	// Keep only one submesh section in memory (OBJ output only)
+	bool keepStrips;		// Write triangle strips as strips (GLB output only)
+	bool optimize;			// Weld the vertices and reorder triangles and vertices for the GPU caches (MeshOptimizer)
+	bool quantize;			// Keep the 16-bit vertex attributes of the file (GLB and mesh file output only)
+	bool buildBvh;			// Write a BVH over the triangles into the mesh file (Bvh)
+	// Only the submeshes in these visibility groups are decoded, all if empty. Files without groups are converted whole.
+	std::vector<std::string> visibilityGroups;
+	bool splitGroups;		// One output per visibility group, X_<group>
+	// Batch state shared by all files, null if not used. The outputs depend on the other files, so they can't be cached.
+	MaterialLibrary *materialLibrary;	// One MTL file and shared material names for all models
+	const TextureAtlas *atlas;			// Move the UVs of small textures into atlases
+
+	ConversionOptions() : writeObj(true), writeGlb(false), writeCmesh(false), floatFormat(ObjWriter::Shortest), floatPrecision(6), glbTextures(GlbWriter::ReferenceTextures), streamSubmeshes(false), keepStrips(false), optimize(false), quantize(false),
+		buildBvh(false), splitGroups(false), materialLibrary(nullptr), atlas(nullptr) {}
+};
+
+// One file to convert.
+struct ConversionJob
+{
+	std::string inputFile;	// For the messages only if the model comes from a source
+	std::string outputDir;	// With trailing slash, empty for the working directory
+	std::string outputName;	// File name of the outputs without extension
+	uint64_t fileSize;
+	ConversionOptions options;
+	AssetSource *source;	// Null for a loose file, else the model is assetId of the source, e.g. an archive
+	uint64_t assetId;
+
+	ConversionJob() : fileSize(0), source(nullptr), assetId(0) {}
+};
+
+// Converts one CMDL file to OBJ/MTL, GLB and/or binary mesh files: the file is parsed into a Mesh first, which is then handed to the
+// writers. All the state of a conversion lives in here, so any number of converters can run at the same time.
+class CmdlConverter
+{
+public:
+	// The textures of the model are handed to textureQueue and converted in the background.
+	// With a cache, the conversion is skipped if the cache has valid outputs for the same input and options.
+	// With a pool, the submesh sections are decoded in parallel on it.
+	// With an arena everything parsed from the file is allocated from it, and the arena is reset when convert() is done.
+	// The arena must not be used by anything else in the meantime.
+	CmdlConverter(const ConversionJob &job, TextureQueue &textureQueue, ConversionCache *cache, ThreadPool *pool, std::ostream &log, Arena *arena = nullptr);
+
+	bool convert();
+	// Stage times and counters of the last convert()
+	const FileStats &getStats() const;
+
+private:
+	bool convertModel();
+	// Reads the model from the source of the job into input.
+	bool loadInput();
+	// Picks the submesh sections in the selected visibility groups. The others are skipped without being decoded.
+	void selectSubmeshSections();
+	// Decodes the vertex sections and the selected submeshes, timing each of them.
+	bool decodeGeometry();
+	void decodeVertexSections();
+	bool decodeSubmeshSection(unsigned int sectionIndex, Submesh &submesh);
+	void addSubmeshStats(const Submesh &submesh, double seconds);
+	// Records why the file couldn't be parsed in the stats.
+	void setError(const ParseError &error);
+	void optimizeMesh();
+	void applyAtlas();
+	// Gives the materials their names in the shared material library.
+	void shareMaterials();
+	std::string getMaterialLibraryName(const std::string &outputName) const;
+	// Decodes and writes one submesh at a time, for the streaming mode.
+	bool writeObjStreamed();
+	// Returns true if the outputs in the cache are up to date. key receives the cache key of this conversion.
+	bool isCached(uint64_t &key);
+	void storeInCache(uint64_t key);
+	std::vector<std::string> getOutputFiles() const;
+	// Writes the OBJ, GLB and mesh files of mesh, named outputName.
+	bool writeOutputs(const Mesh &mesh, const std::string &outputName);
+	// Writes every visibility group to its own outputs.
+	bool writeGroups();
+	bool writeMaterialLibrary(const Mesh &mesh, const std::string &outputName);
+	bool writeObj(const Mesh &mesh, const std::string &outputName);
+	bool writeGlb(const Mesh &mesh, const std::string &outputName);
+	bool writeCmesh(const Mesh &mesh, const std::string &outputName);
+
+private:
+	ConversionJob job;
+	TextureQueue &textureQueue;
+	ConversionCache *cache;
+	ThreadPool *pool;
+	std::ostream &log;
+	Arena *arena;
+
+	Asset input;
+	CmdlParser parser;
+	Mesh mesh;
+	ArenaVector<unsigned int> submeshSections;	// The ones that are decoded
+	std::vector<std::string> outputNames;		// The job's output name, or one per visibility group
+	FileStats stats;
+};
@@ -0,0 +1,459 @@
+#include "CmdlParser.h"
+#include "VertexDecoder.h"
+
+#include <algorithm>
+
+
+// Submesh section header: the material index is at 0x1A and the index of the visibility group at 0x1C.
+static const size_t SubmeshMaterialOffset = 0x1A;
+static const size_t SubmeshGroupOffset = 0x1C;
+
+
+// Fills in error without logging it. offset is a file offset.
+static bool setError(ParseError &error, int section, uint64_t offset, const std::string &message)
+{
+	error.message = message;
+	error.section = section;
+	error.offset = offset;
+	return false;
+}
+
+static void logError(const ParseError &error, std::ostream &log)
+{
+	log << "Error: " << error.message << " (";
+	if (error.section == ParseError::HeaderSection) {
+		log << "header";
+	}
+	else {
+		log << "section " << error.section;
+	}
+	log << ", offset 0x" << std::hex << error.offset << std::dec << ")" << std::endl;
+}
+
+
+CmdlParser::CmdlParser(std::ostream &log, Arena *arena /*= nullptr*/)
+	: log(log), arena(arena), streaming(false), loadedSection(0), fileHeader(arena), sections(ArenaAllocator<ByteSpan>(arena)), stripMode(PrimitiveDecoder::TriangulateStrips)
+{
+}
+
+bool CmdlParser::open(const std::string &fileName, AccessMode mode /*= MapFile*/)
+{
+	this->close();
+	if (mode == StreamSubmeshes) {
+		return this->openStreamed(fileName);
+	}
+
+	if (!this->inputFile.open(fileName)) {
+		return this->fail(this->error, this->log, ParseError::HeaderSection, 0, "Failed to open input file " + fileName);
+	}
+	return this->openSpan(this->inputFile.span());
+}
+
+bool CmdlParser::open(const ByteSpan &data)
+{
+	this->close();
+	return this->openSpan(data);
+}
+
+bool CmdlParser::openSpan(const ByteSpan &data)
+{
+	if (!this->parseHeader(data)) {
+		logError(this->error, this->log);
+		return false;
+	}
+	this->logHeader();
+	this->setSections(data);
+	return true;
+}
+
+bool CmdlParser::openStreamed(const std::string &fileName)
+{
+	if (!this->streamFile.open(fileName)) {
+		return this->fail(this->error, this->log, ParseError::HeaderSection, 0, "Failed to open input file " + fileName);
+	}
+	this->streaming = true;
+
+	// The size of the header isn't known before it is parsed, so a bigger part is read until it fits.
+	size_t readSize = 0x10000;
+	for (;;) {
+		if (!this->streamFile.read(0, readSize, this->headerData)) {
+			return this->fail(this->error, this->log, ParseError::HeaderSection, 0, "Failed to read input file " + fileName);
+		}
+		if (this->parseHeader(ByteSpan(this->headerData.data(), this->headerData.size()))) break;
+		if (this->headerData.size() < readSize) { // The whole file was read
+			logError(this->error, this->log);
+			return false;
+		}
+		readSize *= 4;
+	}
+	this->logHeader();
+
+	// The header, the materials and the vertex attributes are kept in memory. The submesh sections are read one at
+	// a time into the same buffer.
+	size_t attributesEnd = this->fileHeader.sectionOffsets[FirstSubmeshSection - 1] + this->fileHeader.sectionSizes[FirstSubmeshSection - 1];
+	if (!this->streamFile.read(0, attributesEnd, this->headerData)) {
+		return this->fail(this->error, this->log, ParseError::HeaderSection, 0, "Failed to read input file " + fileName);
+	}
+	this->setSections(ByteSpan(this->headerData.data(), this->headerData.size()));
+	return true;
+}
+
+void CmdlParser::close()
+{
+	this->inputFile.close();
+	this->streamFile.close();
+	this->streaming = false;
+	this->loadedSection = 0;
+	this->headerData.clear();
+	releaseArenaMemory(this->sections);
+	releaseArenaMemory(this->fileHeader.sectionSizes);
+	releaseArenaMemory(this->fileHeader.sectionOffsets);
+	releaseArenaMemory(this->fileHeader.visibilityGroups);
+	this->error = ParseError();
+}
+
+const CMDL_HEADER &CmdlParser::getHeader() const
+{
+	return this->fileHeader;
+}
+
+const ParseError &CmdlParser::getError() const
+{
+	return this->error;
+}
+
+bool CmdlParser::fail(ParseError &error, std::ostream &log, int section, uint64_t offset, const std::string &message) const
+{
+	if (section != ParseError::HeaderSection) {
+		offset += this->fileHeader.sectionOffsets[section];
+	}
+	setError(error, section, offset, message);
+	logError(error, log);
+	return false;
+}
+
+void CmdlParser::setStripMode(PrimitiveDecoder::StripMode stripMode)
+{
+	this->stripMode = stripMode;
+}
+
+bool CmdlParser::parse(Mesh &mesh)
+{
+	return this->parseMaterials(mesh) && this->decodeGeometry(mesh);
+}
+
+bool CmdlParser::decodeGeometry(Mesh &mesh)
+{
+	this->decodeVertices(mesh);
+
+	mesh.resizeSubmeshes(this->sections.size() - FirstSubmeshSection);
+	for (unsigned int i = FirstSubmeshSection; i < this->sections.size(); i++) {
+		if (!this->decodeSubmesh(i, mesh, mesh.submeshes[i - FirstSubmeshSection])) return false;
+	}
+	return true;
+}
+
+bool CmdlParser::parseHeader(const ByteSpan &data)
+{
+	this->fileHeader.sectionSizes.clear();
+	this->fileHeader.sectionOffsets.clear();
+	this->fileHeader.visibilityGroups.clear();
+
+	SpanReader header(data);
+	header.skip(4); // Magic
+
+	this->fileHeader.flags = header.readU32();
+
+	// Min and Max Bounding Box
+	for (int i = 0; i < 2; i++) {
+		this->fileHeader.boundingBox[i].x = header.readFloat();
+		this->fileHeader.boundingBox[i].y = header.readFloat();
+		this->fileHeader.boundingBox[i].z = header.readFloat();
+	}
+
+	// Section Count
+	size_t sectionCountOffset = header.tell();
+	this->fileHeader.sectionCount = header.readU32();
+
+	// Material Set Count
+	this->fileHeader.materialSetCount = header.readU32();
+
+	if ((this->fileHeader.flags & 0x10) == 0x10) { // We need to parse/skip visibility groups...
+		header.skip(4); // Ignore Unknown bytes.
+		uint32_t visGroupCount = header.readU32();
+		this->fileHeader.visibilityGroups.reserve(std::min<size_t>(visGroupCount, header.remaining() / 4));
+		for (unsigned int i = 0; i < visGroupCount && !header.fail(); i++) {
+			uint32_t visGroupNameLength = header.readU32();
+			ByteSpan visGroupName = header.readBytes(visGroupNameLength);
+			this->fileHeader.visibilityGroups.push_back(ArenaString(reinterpret_cast<const char *>(visGroupName.data()), visGroupName.size(), ArenaAllocator<char>(this->arena)));
+		}
+		header.skip(20); // Ignore the last 20 bytes (unknown)
+	}
+
+	// Section Sizes. The count is only trusted as far as the data goes.
+	this->fileHeader.sectionSizes.reserve(std::min<size_t>(this->fileHeader.sectionCount, header.remaining() / 4));
+	for (unsigned int i = 0; i < this->fileHeader.sectionCount && !header.fail(); i++) {
+		this->fileHeader.sectionSizes.push_back(header.readU32());
+	}
+	if (header.fail()) {
+		return setError(this->error, ParseError::HeaderSection, header.tell(), "The file is truncated or not a CMDL file");
+	}
+	if (this->fileHeader.sectionCount < FirstSubmeshSection) {
+		return setError(this->error, ParseError::HeaderSection, sectionCountOffset, "The file has " + std::to_string(this->fileHeader.sectionCount) + " sections, a model has at least " + std::to_string(FirstSubmeshSection));
+	}
+
+	// The header is padded to 32 bytes. Every section after it starts right behind its predecessor.
+	size_t headerSize = header.tell();
+	uint64_t sectionOffset = headerSize + (32 - (headerSize % 32));
+	this->fileHeader.sectionOffsets.reserve(this->fileHeader.sectionCount);
+	for (unsigned int i = 0; i < this->fileHeader.sectionCount; i++) {
+		this->fileHeader.sectionOffsets.push_back(static_cast<uint32_t>(sectionOffset));
+		sectionOffset += this->fileHeader.sectionSizes[i];
+		if (sectionOffset > 0xFFFFFFFF) {
+			return setError(this->error, ParseError::HeaderSection, headerSize - 4 * (this->fileHeader.sectionCount - i), "Section " + std::to_string(i) + " ends past 4 GB");
+		}
+	}
+
+	return true;
+}
+
+void CmdlParser::logHeader()
+{
+	this->log << "Header Flags: " << std::hex << this->fileHeader.flags << std::dec << std::endl;
+	this->log << "Section Count: " << this->fileHeader.sectionCount << std::endl;
+	this->log << "Material-Set Count: " << this->fileHeader.materialSetCount << std::endl;
+	if ((this->fileHeader.flags & 0x10) == 0x10) {
+		this->log << "Visibility Group Count: " << this->fileHeader.visibilityGroups.size() << std::endl;
+		for (size_t i = 0; i < this->fileHeader.visibilityGroups.size(); i++) {
+			this->log << '\t' << this->fileHeader.visibilityGroups[i] << std::endl;
+		}
+	}
+
+	this->log << "Section Sizes: " << std::endl;
+	for (unsigned int i = 0; i < this->fileHeader.sectionCount; i++) {
+		this->log << "\tSection" << i << ": " << this->fileHeader.sectionSizes[i] << std::endl;
+	}
+
+	//this->log << "Min Bounding Box: " << "x: " << this->fileHeader.boundingBox[0].x << '\t' << "y: " << this->fileHeader.boundingBox[0].y << '\t' << "z: " << this->fileHeader.boundingBox[0].z << std::endl;
+	//this->log << "Max Bounding Box: " << "x: " << this->fileHeader.boundingBox[1].x << '\t' << "y: " << this->fileHeader.boundingBox[1].y << '\t' << "z: " << this->fileHeader.boundingBox[1].z << std::endl;
+}
+
+void CmdlParser::setSections(const ByteSpan &data)
+{
+	// data starts at the beginning of the file. Sections past its end are empty (until they are loaded when streaming).
+	this->sections.clear();
+	this->sections.reserve(this->fileHeader.sectionCount);
+	for (unsigned int i = 0; i < this->fileHeader.sectionCount; i++) {
+		this->sections.push_back(data.subSpan(this->fileHeader.sectionOffsets[i], this->fileHeader.sectionSizes[i]));
+	}
+}
+
+const ByteSpan &CmdlParser::getSection(unsigned int sectionIndex)
+{
+	if (this->streaming && sectionIndex >= FirstSubmeshSection && sectionIndex != this->loadedSection) {
+		if (this->loadedSection != 0) this->sections[this->loadedSection] = ByteSpan();
+		this->loadedSection = sectionIndex;
+		if (!this->streamFile.read(this->fileHeader.sectionOffsets[sectionIndex], this->fileHeader.sectionSizes[sectionIndex], this->sectionBuffer)) {
+			this->log << "Failed to read section " << sectionIndex << std::endl;
+			this->sectionBuffer.clear();
+		}
+		this->sections[sectionIndex] = ByteSpan(this->sectionBuffer.data(), this->sectionBuffer.size());
+	}
+	return this->sections[sectionIndex];
+}
+
+bool CmdlParser::parseMaterials(Mesh &mesh)
+{
+	// Materials
+	SpanReader materialSection(this->sections[0]);
+	uint32_t materialCount = materialSection.readU32();
+	// At least 4 bytes per material
+	mesh.materials.reserve(mesh.materials.size() + std::min<size_t>(materialCount, materialSection.remaining() / 4));
+
+	for (unsigned int i = 0; i < materialCount && !materialSection.fail(); i++) {
+		uint32_t mSize = materialSection.readU32();
+		size_t materialOffset = materialSection.tell(); // Of materialData in the section
+		SpanReader materialData(materialSection.readBytes(mSize));
+
+		materialData.skip(12);
+		uint32_t mFlags = materialData.readU32();
+		this->log << "Flag" << i << ": " << std::hex << mFlags << std::dec << std::endl;
+		materialData.skip(12);
+
+		char matName[16];
+		sprintf_s(matName, sizeof(matName), "mat%u", i);
+		ArenaPtr<Material> matPtr = makeArenaObject<Material>(mesh.getArena(), matName, mesh.getArena());
+		matPtr->setVertexAttributeFlags(mFlags);
+
+		while (materialData.remaining() > 4) { // > 4 because we ignore the END
+			uint32_t mSectionType = materialData.readU32();
+
+			switch (mSectionType) {
+			case Material::PassSection:
+			{
+				uint32_t sectionSize = materialData.readU32();
+				SpanReader passData(materialData.readBytes(sectionSize));
+				if (materialData.fail()) break;
+				if (sectionSize < 16) { // The texture id is at 8
+					return this->fail(this->error, this->log, 0, materialOffset + materialData.tell() - sectionSize - 4,
+						"Material " + std::to_string(i) + " has a PASS section of " + std::to_string(sectionSize) + " bytes, too small for a texture");
+				}
+
+				// The texture is converted to DDS by the TextureQueue. Shorter passes end after the texture id, the
+				// fields behind it are 0 then.
+				MaterialPass pass;
+				pass.type = passData.readU32();
+				pass.flags = passData.readU32();
+				pass.textureId = passData.readU64();
+				pass.uvSource = passData.readU32();
+				pass.uvAnimationSize = passData.readU32();
+				matPtr->addPass(pass);
+				this->log << "Pass " << Material::fourCCToString(pass.type) << ": Texture File ID: " << std::hex << pass.textureId << std::dec << ", UV Source: " << pass.uvSource << std::endl;
+			}
+			break;
+			case Material::ColorSection:
+			{
+				MaterialColor color;
+				color.type = materialData.readU32();
+				color.rgba = materialData.readU32();
+				if (materialData.fail()) break;
+				matPtr->addColor(color);
+				this->log << "Color " << Material::fourCCToString(color.type) << ": " << std::hex << color.rgba << std::dec << std::endl;
+			}
+			break;
+			case Material::IntSection:
+			{
+				MaterialInt value;
+				value.type = materialData.readU32();
+				value.value = materialData.readU32();
+				if (materialData.fail()) break;
+				matPtr->addInt(value);
+				this->log << "Int " << Material::fourCCToString(value.type) << ": " << value.value << std::endl;
+			}
+			break;
+			default:
+			{
+				char typeName[16];
+				sprintf_s(typeName, sizeof(typeName), "0x%08X", mSectionType);
+				return this->fail(this->error, this->log, 0, materialOffset + materialData.tell() - 4, "Material " + std::to_string(i) + " has an unknown section type " + typeName);
+			}
+			}
+		}
+
+		mesh.materials.push_back(std::move(matPtr));
+	}
+
+	return true;
+}
+
+
+void CmdlParser::decodeVertices(Mesh &mesh)
+{
+	this->decodePositions(mesh);
+	this->decodeNormals(mesh);
+	// Sections 3 and 4 are skipped.
+	this->decodeUvs(mesh);
+	// Section 6 is skipped.
+}
+
+void CmdlParser::decodePositions(Mesh &mesh)
+{
+	mesh.flags = this->fileHeader.flags;
+	mesh.boundingBox[0] = this->fileHeader.boundingBox[0];
+	mesh.boundingBox[1] = this->fileHeader.boundingBox[1];
+	mesh.visibilityGroups.clear();
+	mesh.visibilityGroups.reserve(this->fileHeader.visibilityGroups.size());
+	for (size_t i = 0; i < this->fileHeader.visibilityGroups.size(); i++) {
+		const ArenaString &name = this->fileHeader.visibilityGroups[i];
+		mesh.visibilityGroups.push_back(ArenaString(name.data(), name.size(), ArenaAllocator<char>(mesh.getArena())));
+	}
+
+	// Get the Vertex coordinates.
+	if ((this->fileHeader.flags & 0x20) == 0x20) {
+		VertexDecoder::decodeQuantizedPositions(this->sections[1], mesh.positions);
+	}
+	else {
+		VertexDecoder::decodeFloatPositions(this->sections[1], mesh.positions);
+	}
+}
+
+void CmdlParser::decodeNormals(Mesh &mesh)
+{
+	VertexDecoder::decodeNormals(this->sections[2], mesh.normals);
+}
+
+void CmdlParser::decodeUvs(Mesh &mesh)
+{
+	VertexDecoder::decodeUvs(this->sections[5], mesh.uvs);
+}
+
+bool CmdlParser::decodeSubmesh(unsigned int sectionIndex, const Mesh &mesh, Submesh &result)
+{
+	this->getSection(sectionIndex);
+	return this->decodeSubmesh(sectionIndex, mesh, result, this->log, this->error);
+}
+
+uint16_t CmdlParser::getVisibilityGroup(unsigned int sectionIndex)
+{
+	if (this->fileHeader.visibilityGroups.empty()) return Submesh::NoVisibilityGroup;
+
+	uint16_t group;
+	if (this->streaming) {
+		// Skips the rest of the section, its offset is known from the section sizes
+		if (this->fileHeader.sectionSizes[sectionIndex] < SubmeshGroupOffset + 2
+			|| !this->streamFile.read(this->fileHeader.sectionOffsets[sectionIndex] + SubmeshGroupOffset, 2, this->groupBuffer)) {
+			return Submesh::NoVisibilityGroup;
+		}
+		SpanReader reader(ByteSpan(this->groupBuffer.data(), this->groupBuffer.size()));
+		group = reader.readU16();
+		if (reader.fail()) return Submesh::NoVisibilityGroup;
+	}
+	else {
+		SpanReader reader(this->sections[sectionIndex]);
+		reader.skip(SubmeshGroupOffset);
+		group = reader.readU16();
+		if (reader.fail()) return Submesh::NoVisibilityGroup;
+	}
+	return group < this->fileHeader.visibilityGroups.size() ? group : Submesh::NoVisibilityGroup;
+}
+
+bool CmdlParser::decodeSubmesh(unsigned int sectionIndex, const Mesh &mesh, Submesh &result, std::ostream &log, ParseError &error) const
+{
+	SpanReader submesh(this->sections[sectionIndex]);
+	submesh.skip(SubmeshMaterialOffset);
+	uint16_t matID = submesh.readU16();
+
+	if (submesh.fail()) {
+		return this->fail(error, log, sectionIndex, submesh.tell(), "The submesh header is truncated");
+	}
+	if (matID >= mesh.materials.size()) {
+		return this->fail(error, log, sectionIndex, SubmeshMaterialOffset, "Material " + std::to_string(matID) + " doesn't exist, the model has " + std::to_string(mesh.materials.size()));
+	}
+	if ((mesh.materials[matID]->getVertexAttributeFlags() & 0x3) != 0x3) {
+		return this->fail(error, log, sectionIndex, SubmeshMaterialOffset, "Material " + std::to_string(matID) + " has no position attribute");
+	}
+	uint16_t group = submesh.readU16();
+	submesh.skip(2); // Unknown flag
+
+	const VertexFormat &vertexFormat = mesh.materials[matID]->getVertexFormat();
+	result.sectionIndex = sectionIndex;
+	result.materialIndex = matID;
+	result.visibilityGroup = (group < this->fileHeader.visibilityGroups.size()) ? group : Submesh::NoVisibilityGroup;
+	result.hasNormals = vertexFormat.hasNormal;
+	result.hasUvs = vertexFormat.uvCount >= 1;
+	result.indices.clear();
+	result.stripCorners.clear();
+	result.stripLengths.clear();
+	result.triangleListCount = result.stripCount = result.fanCount = 0;
+
+	PrimitiveDecoder decoder(vertexFormat, this->stripMode);
+	uint8_t primitveFlag = 0;
+	if (decoder.decode(submesh, result, primitveFlag) == PrimitiveDecoder::UnknownPrimitive) {
+		// This could already be the header of the next section...
+		log << "Warning: Encountered unknown primitive Flag (" << std::to_string(primitveFlag) << ") in Section: " << sectionIndex << " at global offset " << std::hex << (this->fileHeader.sectionOffsets[sectionIndex] + submesh.tell()) << std::dec << std::endl;
+	}
+	// The header only has the box of the whole model
+	VertexDecoder::computeBounds(mesh.positions, result);
+
+	return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "PrimitiveDecoder.h"
+#include "Arena.h"
+
+struct CMDL_HEADER
+{
+	// 0x00
+	uint32_t flags;
+	float3 boundingBox[2];
+	uint32_t sectionCount; // includes header count
+	uint32_t headerCount; // number of header sections
+	uint32_t materialSetCount;
+	ArenaVector<uint32_t> sectionSizes;
+	ArenaVector<uint32_t> sectionOffsets; // file offset of each section
+	ArenaVector<ArenaString> visibilityGroups; // Names, if flags & 0x10
+
+	explicit CMDL_HEADER(Arena *arena = nullptr) : flags(0), sectionCount(0), headerCount(0), materialSetCount(0),
+		sectionSizes(ArenaAllocator<uint32_t>(arena)), sectionOffsets(ArenaAllocator<uint32_t>(arena)), visibilityGroups(ArenaAllocator<ArenaString>(arena)) {}
+};
+
+// Why a file couldn't be parsed and where.
+struct ParseError
+{
+	static const int HeaderSection = -1;
+
+	std::string message;	// Empty if there was no error
+	int section;			// Section the parser was in, or HeaderSection
+	uint64_t offset;		// File offset of the value that was rejected
+
+	ParseError() : section(HeaderSection), offset(0) {}
+};
+
+// Decodes a CMDL file into a Mesh. Nothing is written here, that is up to the writers.
+class CmdlParser
+{
+public:
+	// Sections 0-6 hold the materials and vertex attributes, every section after that is a submesh.
+	static const unsigned int FirstSubmeshSection = 7;
+
+	enum AccessMode
+	{
+		MapFile,			// The whole file is mapped into memory
+		StreamSubmeshes		// Only the header, materials and vertex attributes are kept in memory. The submesh sections
+							// are read one at a time into a reused buffer when they are decoded.
+	};
+
+	// With an arena the section table and the header are allocated from it, and so are the materials of the meshes
+	// that have the same arena. close() lets go of everything in the arena.
+	CmdlParser(std::ostream &log, Arena *arena = nullptr);
+
+	// Opens the file and reads the header and the section table.
+	bool open(const std::string &fileName, AccessMode mode = MapFile);
+	// Reads a file that is already in memory. data must stay valid until close().
+	bool open(const ByteSpan &data);
+	void close();
+
+	// Decodes the whole model: materials, vertex attributes and all submeshes.
+	bool parse(Mesh &mesh);
+
+	// The single stages of parse(). The materials must be parsed before any submesh is decoded.
+	bool parseMaterials(Mesh &mesh);
+	// Vertex attributes and all submeshes
+	bool decodeGeometry(Mesh &mesh);
+	void decodeVertices(Mesh &mesh);
+	// The single vertex sections of decodeVertices()
+	void decodePositions(Mesh &mesh);
+	void decodeNormals(Mesh &mesh);
+	void decodeUvs(Mesh &mesh);
+	bool decodeSubmesh(unsigned int sectionIndex, const Mesh &mesh, Submesh &submesh);
+	// The visibility group of a submesh section (Submesh::visibilityGroup) without decoding it. Only the group index
+	// is read when streaming, so the sections that aren't needed are never read.
+	uint16_t getVisibilityGroup(unsigned int sectionIndex);
+	// Can be called from several threads at the same time (not when streaming): the caller provides the log and the error.
+	bool decodeSubmesh(unsigned int sectionIndex, const Mesh &mesh, Submesh &submesh, std::ostream &log, ParseError &error) const;
+	// Triangulates the strips by default.
+	void setStripMode(PrimitiveDecoder::StripMode stripMode);
+
+	const CMDL_HEADER &getHeader() const;
+	// Why the last call that returned false failed. Broken files don't crash the parser, they fail with an error.
+	const ParseError &getError() const;
+
+private:
+	bool openStreamed(const std::string &fileName);
+	// Reads the header and the section table of a whole file in data.
+	bool openSpan(const ByteSpan &data);
+	// Reads the header from data, which starts at the beginning of the file. Returns false and sets error if it doesn't fit into data
+	// or is broken.
+	bool parseHeader(const ByteSpan &data);
+	void logHeader();
+	void setSections(const ByteSpan &data);
+	// Reads a submesh section first when streaming.
+	const ByteSpan &getSection(unsigned int sectionIndex);
+	// Sets error, writes it to log and returns false. offset is relative to the start of the section.
+	bool fail(ParseError &error, std::ostream &log, int section, uint64_t offset, const std::string &message) const;
+
+private:
+	std::ostream &log;
+	Arena *arena;
+
+	MappedFile inputFile;
+	FileReader streamFile;
+	bool streaming;
+	std::vector<uint8_t> headerData;	// Header, materials and vertex attributes when streaming
+	std::vector<uint8_t> sectionBuffer;	// The submesh section last read when streaming
+	std::vector<uint8_t> groupBuffer;	// Visibility group index read by getVisibilityGroup() when streaming
+	unsigned int loadedSection;
+	CMDL_HEADER fileHeader;
+	ArenaVector<ByteSpan> sections;
+	PrimitiveDecoder::StripMode stripMode;
+	ParseError error;
+};
@@ -0,0 +1,204 @@
+#include "ConversionCache.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+
+// XXH64 (https://github.com/Cyan4973/xxHash), fast enough to hash a whole game dump on every run.
+static const uint64_t Prime1 = 11400714785074694791ULL;
+static const uint64_t Prime2 = 14029467366897019727ULL;
+static const uint64_t Prime3 = 1609587929392839161ULL;
+static const uint64_t Prime4 = 9650029242287828579ULL;
+static const uint64_t Prime5 = 2870177450012600261ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const uint8_t *data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * Prime2;
+	return rotateLeft(accumulator, 31) * Prime1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator)
+{
+	hash ^= hashRound(0, accumulator);
+	return hash * Prime1 + Prime4;
+}
+
+static std::string formatHex64(uint64_t value)
+{
+	char text[17];
+	sprintf_s(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+	return text;
+}
+
+
+ConversionCache::ConversionCache(const std::string &cacheDir)
+	: cacheDir(cacheDir)
+{
+	if (!this->cacheDir.empty() && this->cacheDir[this->cacheDir.length() - 1] != '/' && this->cacheDir[this->cacheDir.length() - 1] != '\\') {
+		this->cacheDir += "/";
+	}
+	CreateDirectoryA(this->cacheDir.c_str(), NULL);
+}
+
+uint64_t ConversionCache::hashBytes(const void *data, size_t size, uint64_t seed /*= 0*/)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	const uint8_t *end = bytes + size;
+	uint64_t hash;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + Prime1 + Prime2;
+		uint64_t v2 = seed + Prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - Prime1;
+		const uint8_t *lastStripe = end - 32;
+		do {
+			v1 = hashRound(v1, read64(bytes));
+			v2 = hashRound(v2, read64(bytes + 8));
+			v3 = hashRound(v3, read64(bytes + 16));
+			v4 = hashRound(v4, read64(bytes + 24));
+			bytes += 32;
+		} while (bytes <= lastStripe);
+
+		hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		hash = mergeRound(hash, v1);
+		hash = mergeRound(hash, v2);
+		hash = mergeRound(hash, v3);
+		hash = mergeRound(hash, v4);
+	}
+	else {
+		hash = seed + Prime5;
+	}
+	hash += size;
+
+	while (bytes + 8 <= end) {
+		hash ^= hashRound(0, read64(bytes));
+		hash = rotateLeft(hash, 27) * Prime1 + Prime4;
+		bytes += 8;
+	}
+	if (bytes + 4 <= end) {
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		hash ^= value * Prime1;
+		hash = rotateLeft(hash, 23) * Prime2 + Prime3;
+		bytes += 4;
+	}
+	while (bytes < end) {
+		hash ^= *bytes * Prime5;
+		hash = rotateLeft(hash, 11) * Prime1;
+		bytes++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+bool ConversionCache::hashFile(const std::string &fileName, uint64_t &hash)
+{
+	MappedFile file;
+	if (!file.open(fileName)) return false;
+	hash = hashBytes(file.span().data(), file.span().size());
+	return true;
+}
+
+uint64_t ConversionCache::makeKey(uint64_t inputHash, const std::string &options)
+{
+	return hashBytes(options.data(), options.length(), inputHash ^ (ConverterVersion * Prime5));
+}
+
+std::string ConversionCache::getModelEntryName(const std::string &outputDir, const std::string &outputName)
+{
+	// The hash keeps files with the same name in different output directories apart.
+	std::string outputPath = outputDir + outputName;
+	return outputName + "-" + formatHex64(hashBytes(outputPath.data(), outputPath.length())) + ".model";
+}
+
+std::string ConversionCache::getTextureEntryName(uint64_t textureId)
+{
+	return formatHex64(textureId) + ".texture";
+}
+
+std::string ConversionCache::getTextureFileName(uint64_t textureId, const char *extension)
+{
+	return formatHex64(textureId) + extension;
+}
+
+bool ConversionCache::lookup(const std::string &entryName, uint64_t key, CacheEntry &entry) const
+{
+	std::ifstream entryFile(this->cacheDir + entryName);
+	if (!entryFile.is_open()) return false;
+
+	// One record per line: "key <hex>", "output <size> <path>", "texture <hex>" and "end".
+	// An entry without the end line was not written completely.
+	entry = CacheEntry();
+	bool complete = false;
+	std::string line;
+	while (std::getline(entryFile, line)) {
+		if (line.compare(0, 4, "key ") == 0) {
+			entry.key = strtoull(line.c_str() + 4, NULL, 16);
+		}
+		else if (line.compare(0, 7, "output ") == 0) {
+			char *path;
+			entry.outputSizes.push_back(strtoull(line.c_str() + 7, &path, 10));
+			entry.outputFiles.push_back(*path == ' ' ? path + 1 : path);
+		}
+		else if (line.compare(0, 8, "texture ") == 0) {
+			entry.textureIds.push_back(strtoull(line.c_str() + 8, NULL, 16));
+		}
+		else if (line == "end") {
+			complete = true;
+		}
+	}
+	if (!complete || entry.key != key) return false;
+
+	for (size_t i = 0; i < entry.outputFiles.size(); i++) {
+		if (MappedFile::getFileSize(entry.outputFiles[i]) != static_cast<int64_t>(entry.outputSizes[i])) return false;
+	}
+	return true;
+}
+
+bool ConversionCache::store(const std::string &entryName, CacheEntry &entry) const
+{
+	entry.outputSizes.clear();
+	for (size_t i = 0; i < entry.outputFiles.size(); i++) {
+		int64_t size = MappedFile::getFileSize(entry.outputFiles[i]);
+		if (size < 0) return false;
+		entry.outputSizes.push_back(static_cast<uint64_t>(size));
+	}
+
+	std::ofstream entryFile(this->cacheDir + entryName);
+	if (!entryFile.is_open()) return false;
+	entryFile << "key " << formatHex64(entry.key) << std::endl;
+	for (size_t i = 0; i < entry.outputFiles.size(); i++) {
+		entryFile << "output " << entry.outputSizes[i] << " " << entry.outputFiles[i] << std::endl;
+	}
+	for (size_t i = 0; i < entry.textureIds.size(); i++) {
+		entryFile << "texture " << formatHex64(entry.textureIds[i]) << std::endl;
+	}
+	entryFile << "end" << std::endl;
+	entryFile.close();
+	return !entryFile.fail();
+}
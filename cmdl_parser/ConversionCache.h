@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// What a cached conversion produced.
+struct CacheEntry
+{
+	uint64_t key;						// Hash of the input, the options and the converter version
+	std::vector<std::string> outputFiles;
+	std::vector<uint64_t> textureIds;	// Textures referenced by a model
+	std::vector<uint64_t> outputSizes;	// Filled in by store()
+
+	CacheEntry() : key(0) {}
+};
+
+// An on-disk record of finished conversions, so re-runs skip every file whose input, options and converter version
+// didn't change and whose outputs are still there. Every entry is a small text file in the cache directory.
+// Different entries can be used from different threads at the same time.
+class ConversionCache
+{
+public:
+	// Raise this with every change that makes the converter write different output. It invalidates all entries.
+	static const uint32_t ConverterVersion = 3;
+
+	// The directory is created if it doesn't exist.
+	ConversionCache(const std::string &cacheDir);
+
+	static uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+	// Hashes the contents of a file. Returns false if it can't be opened.
+	static bool hashFile(const std::string &fileName, uint64_t &hash);
+	// Combines the hash of an input file with a description of the options that apply to it.
+	static uint64_t makeKey(uint64_t inputHash, const std::string &options);
+
+	// Returns true if the entry exists, has the given key and all of its outputs still exist with the recorded size.
+	bool lookup(const std::string &entryName, uint64_t key, CacheEntry &entry) const;
+	// Records the entry with the current sizes of its outputs. Returns false if an output is missing.
+	bool store(const std::string &entryName, CacheEntry &entry) const;
+
+	// Entry names, unique per output
+	static std::string getModelEntryName(const std::string &outputDir, const std::string &outputName);
+	static std::string getTextureEntryName(uint64_t textureId);
+	// <16 hex digits of the id><extension>, the name of the TXTR and DDS files
+	static std::string getTextureFileName(uint64_t textureId, const char *extension);
+
+private:
+	std::string cacheDir;
+};
@@ -0,0 +1,269 @@
+#include "ConversionStats.h"
+
+#include <fstream>
+#include <stdio.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+
+// The file names come from the command line and FindFirstFileA, so they are in the ANSI code page. JSON is UTF-8.
+// Returns the text unchanged if it isn't valid in the code page.
+static std::string toUtf8(const std::string &text)
+{
+	if (text.empty()) return text;
+	int textLength = static_cast<int>(text.length());
+	int wideLength = MultiByteToWideChar(CP_ACP, MB_ERR_INVALID_CHARS, text.data(), textLength, NULL, 0);
+	if (wideLength <= 0) return text;
+	std::wstring wide(wideLength, L'\0');
+	MultiByteToWideChar(CP_ACP, MB_ERR_INVALID_CHARS, text.data(), textLength, &wide[0], wideLength);
+	int length = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, NULL, 0, NULL, NULL);
+	if (length <= 0) return text;
+	std::string utf8(length, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, &utf8[0], length, NULL, NULL);
+	return utf8;
+}
+
+// The length of the UTF-8 sequence that starts at text[start], 0 if it isn't a valid one.
+static size_t getUtf8Length(const std::string &text, size_t start)
+{
+	unsigned char lead = static_cast<unsigned char>(text[start]);
+	size_t length;
+	uint32_t codePoint;
+	if (lead >= 0xC2 && lead <= 0xDF) {
+		length = 2;
+		codePoint = lead & 0x1F;
+	}
+	else if (lead >= 0xE0 && lead <= 0xEF) {
+		length = 3;
+		codePoint = lead & 0x0F;
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4) {
+		length = 4;
+		codePoint = lead & 0x07;
+	}
+	else {
+		return 0;
+	}
+	if (start + length > text.length()) return 0;
+	for (size_t i = 1; i < length; i++) {
+		unsigned char next = static_cast<unsigned char>(text[start + i]);
+		if ((next & 0xC0) != 0x80) return 0;
+		codePoint = (codePoint << 6) | (next & 0x3F);
+	}
+	// Overlong encodings, surrogates and code points past the last plane aren't valid either
+	if ((length == 3 && codePoint < 0x800) || (length == 4 && codePoint < 0x10000) || (codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF) return 0;
+	return length;
+}
+
+// Bytes that still aren't UTF-8 after the conversion are written as the Latin-1 characters \u0080 .. \u00FF.
+static std::string escapeJson(const std::string &text)
+{
+	std::string utf8 = toUtf8(text);
+	std::string escaped;
+	escaped.reserve(utf8.length() + 2);
+	for (size_t i = 0; i < utf8.length(); i++) {
+		unsigned char c = static_cast<unsigned char>(utf8[i]);
+		size_t length = (c >= 0x80) ? getUtf8Length(utf8, i) : 1;
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+			escaped += static_cast<char>(c);
+		}
+		else if (c < 0x20 || length == 0) {
+			char code[8];
+			sprintf_s(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(c));
+			escaped += code;
+		}
+		else {
+			escaped.append(utf8, i, length);
+			i += length - 1;
+		}
+	}
+	return escaped;
+}
+
+static std::string formatSeconds(double seconds)
+{
+	char text[32];
+	sprintf_s(text, sizeof(text), "%.6f", seconds);
+	return text;
+}
+
+static const char *formatBool(bool value)
+{
+	return value ? "true" : "false";
+}
+
+static void writeFileSeconds(std::ostream &json, const FileStats &file)
+{
+	json << "\"seconds\": {\"total\": " << formatSeconds(file.totalSeconds)
+		<< ", \"header\": " << formatSeconds(file.headerSeconds)
+		<< ", \"materials\": " << formatSeconds(file.materialSeconds)
+		<< ", \"positions\": " << formatSeconds(file.positionSeconds)
+		<< ", \"normals\": " << formatSeconds(file.normalSeconds)
+		<< ", \"uvs\": " << formatSeconds(file.uvSeconds)
+		<< ", \"submeshes\": " << formatSeconds(file.submeshSeconds)
+		<< ", \"obj\": " << formatSeconds(file.objSeconds)
+		<< ", \"glb\": " << formatSeconds(file.glbSeconds)
+		<< ", \"cmesh\": " << formatSeconds(file.cmeshSeconds)
+		<< ", \"optimize\": " << formatSeconds(file.optimizeSeconds)
+		<< ", \"bvh\": " << formatSeconds(file.bvhSeconds) << "}";
+}
+
+static void writeFileCounts(std::ostream &json, const FileStats &file, size_t submeshCount)
+{
+	json << "\"bytesRead\": " << file.bytesRead << ", \"bytesWritten\": " << file.bytesWritten
+		<< ", \"counts\": {\"materials\": " << file.materialCount
+		<< ", \"positions\": " << file.positionCount
+		<< ", \"normals\": " << file.normalCount
+		<< ", \"uvs\": " << file.uvCount
+		<< ", \"submeshes\": " << submeshCount
+		<< ", \"triangles\": " << file.triangleCount
+		<< ", \"triangleLists\": " << file.triangleListCount
+		<< ", \"strips\": " << file.stripCount
+		<< ", \"fans\": " << file.fanCount
+		<< ", \"skippedSubmeshes\": " << file.skippedSubmeshCount
+		<< ", \"submeshesOutsideHeaderBox\": " << file.submeshesOutsideHeaderBox
+		<< ", \"bvhNodes\": " << file.bvhNodeCount << "}";
+
+	char acmr[64];
+	sprintf_s(acmr, sizeof(acmr), "\"acmrBefore\": %.4f, \"acmrAfter\": %.4f",
+		file.acmrTrianglesBefore > 0 ? static_cast<double>(file.cacheMissesBefore) / file.acmrTrianglesBefore : 0.0,
+		file.acmrTrianglesAfter > 0 ? static_cast<double>(file.cacheMissesAfter) / file.acmrTrianglesAfter : 0.0);
+	json << ", \"optimization\": {\"vertices\": " << file.optimizedVertexCount << ", \"degenerateTriangles\": " << file.degenerateTriangleCount
+		<< ", " << acmr << "}";
+}
+
+
+FileStats::FileStats()
+	: success(false), cached(false), errorSection(-1), errorOffset(0), totalSeconds(0.0), headerSeconds(0.0), materialSeconds(0.0), positionSeconds(0.0), normalSeconds(0.0),
+	uvSeconds(0.0), submeshSeconds(0.0), objSeconds(0.0), glbSeconds(0.0), cmeshSeconds(0.0), optimizeSeconds(0.0), bvhSeconds(0.0), bytesRead(0), bytesWritten(0), materialCount(0), positionCount(0),
+	normalCount(0), uvCount(0), triangleCount(0), triangleListCount(0), stripCount(0), fanCount(0), skippedSubmeshCount(0), submeshesOutsideHeaderBox(0), bvhNodeCount(0),
+	optimizedVertexCount(0), degenerateTriangleCount(0), acmrTrianglesBefore(0), cacheMissesBefore(0), acmrTrianglesAfter(0), cacheMissesAfter(0)
+{
+}
+
+void FileStats::add(const FileStats &other)
+{
+	this->totalSeconds += other.totalSeconds;
+	this->headerSeconds += other.headerSeconds;
+	this->materialSeconds += other.materialSeconds;
+	this->positionSeconds += other.positionSeconds;
+	this->normalSeconds += other.normalSeconds;
+	this->uvSeconds += other.uvSeconds;
+	this->submeshSeconds += other.submeshSeconds;
+	this->objSeconds += other.objSeconds;
+	this->glbSeconds += other.glbSeconds;
+	this->cmeshSeconds += other.cmeshSeconds;
+	this->optimizeSeconds += other.optimizeSeconds;
+	this->bvhSeconds += other.bvhSeconds;
+	this->bytesRead += other.bytesRead;
+	this->bytesWritten += other.bytesWritten;
+	this->materialCount += other.materialCount;
+	this->positionCount += other.positionCount;
+	this->normalCount += other.normalCount;
+	this->uvCount += other.uvCount;
+	this->triangleCount += other.triangleCount;
+	this->triangleListCount += other.triangleListCount;
+	this->stripCount += other.stripCount;
+	this->fanCount += other.fanCount;
+	this->skippedSubmeshCount += other.skippedSubmeshCount;
+	this->submeshesOutsideHeaderBox += other.submeshesOutsideHeaderBox;
+	this->bvhNodeCount += other.bvhNodeCount;
+	this->optimizedVertexCount += other.optimizedVertexCount;
+	this->degenerateTriangleCount += other.degenerateTriangleCount;
+	this->acmrTrianglesBefore += other.acmrTrianglesBefore;
+	this->cacheMissesBefore += other.cacheMissesBefore;
+	this->acmrTrianglesAfter += other.acmrTrianglesAfter;
+	this->cacheMissesAfter += other.cacheMissesAfter;
+}
+
+void ConversionStats::addFile(const FileStats &file)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->files.push_back(file);
+}
+
+void ConversionStats::addTexture(const TextureStats &texture)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->textures.push_back(texture);
+}
+
+bool ConversionStats::writeJson(const std::string &fileName, double wallSeconds) const
+{
+	std::ofstream json(fileName);
+	if (!json.is_open()) return false;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	FileStats fileTotals;
+	size_t failedFiles = 0, cachedFiles = 0, submeshCount = 0;
+
+	json << "{" << std::endl << "\t\"files\": [";
+	for (size_t i = 0; i < this->files.size(); i++) {
+		const FileStats &file = this->files[i];
+		fileTotals.add(file);
+		submeshCount += file.submeshes.size();
+		if (!file.success) failedFiles++;
+		if (file.cached) cachedFiles++;
+
+		json << (i > 0 ? "," : "") << std::endl << "\t\t{\"input\": \"" << escapeJson(file.inputFile) << "\", \"success\": " << formatBool(file.success)
+			<< ", \"cached\": " << formatBool(file.cached) << ", ";
+		if (!file.error.empty()) {
+			json << "\"error\": {\"message\": \"" << escapeJson(file.error) << "\", \"section\": ";
+			if (file.errorSection < 0) {
+				json << "null";
+			}
+			else {
+				json << file.errorSection;
+			}
+			json << ", \"offset\": " << file.errorOffset << "}, ";
+		}
+		writeFileSeconds(json, file);
+		json << ", ";
+		writeFileCounts(json, file, file.submeshes.size());
+		json << ", \"submeshes\": [";
+		for (size_t s = 0; s < file.submeshes.size(); s++) {
+			const SubmeshStats &submesh = file.submeshes[s];
+			json << (s > 0 ? ", " : "") << "{\"section\": " << submesh.sectionIndex << ", \"seconds\": " << formatSeconds(submesh.seconds)
+				<< ", \"bytes\": " << submesh.bytes << ", \"triangles\": " << submesh.triangles << "}";
+		}
+		json << "]}";
+	}
+	json << std::endl << "\t]," << std::endl;
+
+	TextureStats textureTotals;
+	size_t failedTextures = 0, cachedTextures = 0;
+	json << "\t\"textures\": [";
+	for (size_t i = 0; i < this->textures.size(); i++) {
+		const TextureStats &texture = this->textures[i];
+		textureTotals.seconds += texture.seconds;
+		textureTotals.bytesRead += texture.bytesRead;
+		textureTotals.bytesWritten += texture.bytesWritten;
+		if (!texture.success) failedTextures++;
+		if (texture.cached) cachedTextures++;
+
+		char id[17];
+		sprintf_s(id, sizeof(id), "%016llx", static_cast<unsigned long long>(texture.textureId));
+		json << (i > 0 ? "," : "") << std::endl << "\t\t{\"id\": \"" << id << "\", \"success\": " << formatBool(texture.success)
+			<< ", \"cached\": " << formatBool(texture.cached) << ", \"seconds\": " << formatSeconds(texture.seconds)
+			<< ", \"bytesRead\": " << texture.bytesRead << ", \"bytesWritten\": " << texture.bytesWritten << "}";
+	}
+	json << std::endl << "\t]," << std::endl;
+
+	// The times of the stages are summed over all threads, so they can add up to more than the wall time.
+	json << "\t\"total\": {\"wallSeconds\": " << formatSeconds(wallSeconds) << "," << std::endl;
+	json << "\t\t\"files\": {\"count\": " << this->files.size() << ", \"failed\": " << failedFiles << ", \"cached\": " << cachedFiles << ", ";
+	writeFileSeconds(json, fileTotals);
+	json << ", ";
+	writeFileCounts(json, fileTotals, submeshCount);
+	json << "}," << std::endl;
+	json << "\t\t\"textures\": {\"count\": " << this->textures.size() << ", \"failed\": " << failedTextures << ", \"cached\": " << cachedTextures
+		<< ", \"seconds\": " << formatSeconds(textureTotals.seconds) << ", \"bytesRead\": " << textureTotals.bytesRead
+		<< ", \"bytesWritten\": " << textureTotals.bytesWritten << "}" << std::endl;
+	json << "\t}" << std::endl << "}" << std::endl;
+
+	json.close();
+	return !json.fail();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+
+// Time and size of one decoded submesh section.
+struct SubmeshStats
+{
+	unsigned int sectionIndex;
+	double seconds;
+	uint64_t bytes;
+	uint64_t triangles;
+
+	SubmeshStats() : sectionIndex(0), seconds(0.0), bytes(0), triangles(0) {}
+};
+
+// What the conversion of one file did and where the time went. All times are wall time in seconds.
+struct FileStats
+{
+	std::string inputFile;
+	bool success;
+	bool cached;
+
+	// Why the file couldn't be parsed (CmdlParser::getError()). Empty if it could.
+	std::string error;
+	int errorSection;		// -1 for the header
+	uint64_t errorOffset;	// File offset
+
+	double totalSeconds;
+	double headerSeconds;
+	double materialSeconds;
+	double positionSeconds;
+	double normalSeconds;
+	double uvSeconds;
+	double submeshSeconds;	// All submesh sections
+	double objSeconds;		// OBJ and MTL, until the files are flushed and closed
+	double glbSeconds;
+	double cmeshSeconds;
+	double optimizeSeconds;
+	double bvhSeconds;		// Included in cmeshSeconds
+
+	uint64_t bytesRead;
+	uint64_t bytesWritten;
+
+	uint64_t materialCount;
+	uint64_t positionCount;
+	uint64_t normalCount;
+	uint64_t uvCount;
+	uint64_t triangleCount;
+	uint64_t triangleListCount;	// Primitives
+	uint64_t stripCount;
+	uint64_t fanCount;
+	uint64_t skippedSubmeshCount;	// Sections outside the selected visibility groups, not decoded
+	uint64_t submeshesOutsideHeaderBox;	// Submeshes whose positions aren't all inside the bounding box of the CMDL header
+	uint64_t bvhNodeCount;			// -bvh
+
+	// Mesh optimization (-optimize)
+	uint64_t optimizedVertexCount;		// Unique vertices after welding
+	uint64_t degenerateTriangleCount;	// Dropped
+	uint64_t acmrTrianglesBefore;		// Triangles and simulated cache misses, for the ACMR before and after
+	uint64_t cacheMissesBefore;
+	uint64_t acmrTrianglesAfter;
+	uint64_t cacheMissesAfter;
+
+	std::vector<SubmeshStats> submeshes;
+
+	FileStats();
+	// Adds the times and counters of another file (for the totals of a run).
+	void add(const FileStats &other);
+};
+
+// The conversion of one texture.
+struct TextureStats
+{
+	uint64_t textureId;
+	bool success;
+	bool cached;
+	double seconds;
+	uint64_t bytesRead;
+	uint64_t bytesWritten;
+
+	TextureStats() : textureId(0), success(false), cached(false), seconds(0.0), bytesRead(0), bytesWritten(0) {}
+};
+
+// Collects the statistics of all files and textures of a run and writes them as JSON (-stats).
+// Files and textures can be added from any thread.
+class ConversionStats
+{
+public:
+	void addFile(const FileStats &file);
+	void addTexture(const TextureStats &texture);
+
+	// Writes the statistics of every file and texture followed by the totals of the run.
+	bool writeJson(const std::string &fileName, double wallSeconds) const;
+
+private:
+	mutable std::mutex mutex;
+	std::vector<FileStats> files;
+	std::vector<TextureStats> textures;
+};
@@ -0,0 +1,384 @@
+#include "Decompressor.h"
+
+#include <string.h>
+
+
+// Deflate tables (RFC 1951, 3.2.5)
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// Order of the code length code lengths in a dynamic block
+static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static const int MaxCodeLength = 15;
+
+// Deflate bits, least significant bit first. Reading past the end returns zeros and sets overrun.
+struct BitReader
+{
+	const uint8_t *data;
+	size_t size;
+	size_t position;
+	uint32_t bitBuffer;
+	int bitCount;
+	bool overrun;
+
+	BitReader(const uint8_t *data, size_t size) : data(data), size(size), position(0), bitBuffer(0), bitCount(0), overrun(false) {}
+
+	uint32_t bits(int count)
+	{
+		while (this->bitCount < count) {
+			uint32_t byte = 0;
+			if (this->position < this->size) byte = this->data[this->position++];
+			else this->overrun = true;
+			this->bitBuffer |= byte << this->bitCount;
+			this->bitCount += 8;
+		}
+		uint32_t value = this->bitBuffer & ((1u << count) - 1);
+		this->bitBuffer >>= count;
+		this->bitCount -= count;
+		return value;
+	}
+
+	// Drops the bits left in the current byte
+	void alignToByte()
+	{
+		this->bitBuffer = 0;
+		this->bitCount = 0;
+	}
+};
+
+// Canonical Huffman code: the number of codes of every length and the symbols ordered by code
+struct HuffmanCode
+{
+	uint16_t counts[MaxCodeLength + 1];
+	uint16_t symbols[288];
+};
+
+static bool buildHuffmanCode(HuffmanCode &code, const uint8_t *lengths, int symbolCount)
+{
+	memset(code.counts, 0, sizeof(code.counts));
+	for (int i = 0; i < symbolCount; i++) code.counts[lengths[i]]++;
+	code.counts[0] = 0;
+
+	// Incomplete codes are allowed (a single distance code), oversubscribed ones aren't.
+	int left = 1;
+	for (int length = 1; length <= MaxCodeLength; length++) {
+		left = (left << 1) - code.counts[length];
+		if (left < 0) return false;
+	}
+
+	uint16_t offsets[MaxCodeLength + 1];
+	offsets[1] = 0;
+	for (int length = 1; length < MaxCodeLength; length++) {
+		offsets[length + 1] = offsets[length] + code.counts[length];
+	}
+	for (int i = 0; i < symbolCount; i++) {
+		if (lengths[i] != 0) code.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+	}
+	return true;
+}
+
+// Returns -1 for a code that isn't in the table.
+static int decodeSymbol(BitReader &input, const HuffmanCode &code)
+{
+	int value = 0, first = 0, index = 0;
+	for (int length = 1; length <= MaxCodeLength; length++) {
+		value |= input.bits(1);
+		int count = code.counts[length];
+		if (value - first < count) return code.symbols[index + value - first];
+		index += count;
+		first = (first + count) << 1;
+		value <<= 1;
+	}
+	return -1;
+}
+
+static bool inflateCodes(BitReader &input, const HuffmanCode &literals, const HuffmanCode &distances, uint8_t *out, size_t outSize, size_t &outPosition)
+{
+	for (;;) {
+		int symbol = decodeSymbol(input, literals);
+		if (symbol < 0 || input.overrun) return false;
+		if (symbol < 256) {
+			if (outPosition >= outSize) return false;
+			out[outPosition++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+		if (symbol == 256) return true;
+
+		symbol -= 257;
+		if (symbol >= 29) return false;
+		size_t length = lengthBase[symbol] + input.bits(lengthExtra[symbol]);
+		int distanceSymbol = decodeSymbol(input, distances);
+		if (distanceSymbol < 0 || distanceSymbol >= 30) return false;
+		size_t distance = distanceBase[distanceSymbol] + input.bits(distanceExtra[distanceSymbol]);
+		if (distance > outPosition || length > outSize - outPosition) return false;
+		// Byte by byte, the match can overlap the bytes it produces
+		for (size_t i = 0; i < length; i++, outPosition++) {
+			out[outPosition] = out[outPosition - distance];
+		}
+	}
+}
+
+static bool readDynamicCodes(BitReader &input, HuffmanCode &literals, HuffmanCode &distances)
+{
+	int literalCount = input.bits(5) + 257;
+	int distanceCount = input.bits(5) + 1;
+	int codeLengthCount = input.bits(4) + 4;
+	if (literalCount > 286 || distanceCount > 30) return false;
+
+	uint8_t lengths[288 + 32];
+	memset(lengths, 0, 19);
+	for (int i = 0; i < codeLengthCount; i++) lengths[codeLengthOrder[i]] = static_cast<uint8_t>(input.bits(3));
+	HuffmanCode codeLengths;
+	if (!buildHuffmanCode(codeLengths, lengths, 19)) return false;
+
+	int count = 0;
+	while (count < literalCount + distanceCount) {
+		int symbol = decodeSymbol(input, codeLengths);
+		if (symbol < 0 || input.overrun) return false;
+		if (symbol < 16) {
+			lengths[count++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+		uint8_t repeated = 0;
+		int repeat;
+		if (symbol == 16) {
+			if (count == 0) return false;
+			repeated = lengths[count - 1];
+			repeat = 3 + input.bits(2);
+		}
+		else if (symbol == 17) {
+			repeat = 3 + input.bits(3);
+		}
+		else {
+			repeat = 11 + input.bits(7);
+		}
+		if (count + repeat > literalCount + distanceCount) return false;
+		while (repeat-- > 0) lengths[count++] = repeated;
+	}
+	if (lengths[256] == 0) return false; // No end of block code
+
+	return buildHuffmanCode(literals, lengths, literalCount) && buildHuffmanCode(distances, lengths + literalCount, distanceCount);
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < size; i++) {
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
+
+
+bool Decompressor::isZlibStream(const uint8_t *source, size_t sourceSize)
+{
+	if (sourceSize < 2) return false;
+	return (source[0] & 0x0F) == 8 && (source[0] >> 4) <= 7 && (source[1] & 0x20) == 0 && ((source[0] << 8) | source[1]) % 31 == 0;
+}
+
+bool Decompressor::inflateZlib(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize)
+{
+	if (!isZlibStream(source, sourceSize)) return false;
+
+	BitReader input(source + 2, sourceSize - 2);
+	size_t outPosition = 0;
+	bool finalBlock = false;
+	while (!finalBlock) {
+		finalBlock = input.bits(1) != 0;
+		uint32_t blockType = input.bits(2);
+		if (blockType == 0) { // Stored
+			input.alignToByte();
+			if (input.size - input.position < 4) return false;
+			const uint8_t *header = input.data + input.position;
+			size_t length = header[0] | (header[1] << 8);
+			if (length != static_cast<size_t>(~(header[2] | (header[3] << 8)) & 0xFFFF)) return false;
+			input.position += 4;
+			if (length > input.size - input.position || length > outSize - outPosition) return false;
+			memcpy(out + outPosition, input.data + input.position, length);
+			input.position += length;
+			outPosition += length;
+		}
+		else if (blockType == 1) { // Fixed codes
+			uint8_t lengths[288 + 30];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+			HuffmanCode literals, distances;
+			buildHuffmanCode(literals, lengths, 288);
+			buildHuffmanCode(distances, lengths + 288, 30);
+			if (!inflateCodes(input, literals, distances, out, outSize, outPosition)) return false;
+		}
+		else if (blockType == 2) { // Dynamic codes
+			HuffmanCode literals, distances;
+			if (!readDynamicCodes(input, literals, distances)) return false;
+			if (!inflateCodes(input, literals, distances, out, outSize, outPosition)) return false;
+		}
+		else {
+			return false;
+		}
+		if (input.overrun) return false;
+	}
+	if (outPosition != outSize) return false;
+
+	input.alignToByte();
+	if (input.size - input.position >= 4) {
+		const uint8_t *checksum = input.data + input.position;
+		uint32_t expected = (static_cast<uint32_t>(checksum[0]) << 24) | (checksum[1] << 16) | (checksum[2] << 8) | checksum[3];
+		if (expected != adler32(out, outSize)) return false;
+	}
+	return true;
+}
+
+bool Decompressor::decompressLzo(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize)
+{
+	size_t written;
+	return decompressLzoStream(source, sourceSize, out, outSize, written) && written == outSize;
+}
+
+bool Decompressor::decompressLzoSegments(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize)
+{
+	size_t inPosition = 0, outPosition = 0;
+	while (inPosition < sourceSize) {
+		if (sourceSize - inPosition < 2) return false;
+		int16_t segmentSize = static_cast<int16_t>((source[inPosition] << 8) | source[inPosition + 1]);
+		inPosition += 2;
+		if (segmentSize < 0) { // Stored
+			size_t storedSize = -static_cast<int32_t>(segmentSize);
+			if (storedSize > sourceSize - inPosition || storedSize > outSize - outPosition) return false;
+			memcpy(out + outPosition, source + inPosition, storedSize);
+			inPosition += storedSize;
+			outPosition += storedSize;
+			continue;
+		}
+		if (static_cast<size_t>(segmentSize) > sourceSize - inPosition) return false;
+		size_t written;
+		if (!decompressLzoStream(source + inPosition, segmentSize, out + outPosition, outSize - outPosition, written)) return false;
+		inPosition += segmentSize;
+		outPosition += written;
+	}
+	return outPosition == outSize;
+}
+
+// The instructions of LZO1X, as in lzo1x_decompress_safe(). What a byte below 16 means depends on what came before it:
+// a literal run, a match after a literal run of 4 or more bytes, or a match after 1 to 3 trailing literals.
+bool Decompressor::decompressLzoStream(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize, size_t &written)
+{
+	enum State
+	{
+		Instruction,		// A literal run or a match
+		AfterLiteralRun,	// A literal run of 4 or more bytes was copied
+		AfterTrailingLiterals
+	};
+
+	size_t in = 0, op = 0;
+	written = 0;
+	State state = Instruction;
+	if (sourceSize > 0 && source[0] > 17) {
+		size_t count = source[in++] - 17;
+		if (count > sourceSize - in || count > outSize) return false;
+		memcpy(out, source + in, count);
+		in += count;
+		op += count;
+		state = (count < 4) ? AfterTrailingLiterals : AfterLiteralRun;
+	}
+
+	for (;;) {
+		if (in >= sourceSize) return false;
+		size_t instruction = source[in++];
+		size_t length, distance;
+
+		if (instruction < 16 && state == Instruction) { // Literal run
+			length = instruction;
+			if (length == 0) {
+				while (in < sourceSize && source[in] == 0) {
+					length += 255;
+					in++;
+				}
+				if (in >= sourceSize) return false;
+				length += 15 + source[in++];
+			}
+			length += 3;
+			if (length > sourceSize - in || length > outSize - op) return false;
+			memcpy(out + op, source + in, length);
+			in += length;
+			op += length;
+			state = AfterLiteralRun;
+			continue;
+		}
+
+		if (instruction >= 64) {
+			if (in >= sourceSize) return false;
+			distance = 1 + ((instruction >> 2) & 7) + (static_cast<size_t>(source[in++]) << 3);
+			length = (instruction >> 5) + 1;
+		}
+		else if (instruction >= 32) {
+			length = instruction & 31;
+			if (length == 0) {
+				while (in < sourceSize && source[in] == 0) {
+					length += 255;
+					in++;
+				}
+				if (in >= sourceSize) return false;
+				length += 31 + source[in++];
+			}
+			length += 2;
+			if (sourceSize - in < 2) return false;
+			distance = 1 + (source[in] >> 2) + (static_cast<size_t>(source[in + 1]) << 6);
+			in += 2;
+		}
+		else if (instruction >= 16) {
+			distance = (instruction & 8) << 11;
+			length = instruction & 7;
+			if (length == 0) {
+				while (in < sourceSize && source[in] == 0) {
+					length += 255;
+					in++;
+				}
+				if (in >= sourceSize) return false;
+				length += 7 + source[in++];
+			}
+			length += 2;
+			if (sourceSize - in < 2) return false;
+			distance += (source[in] >> 2) + (static_cast<size_t>(source[in + 1]) << 6);
+			in += 2;
+			if (distance == 0) { // End of stream
+				written = op;
+				return in == sourceSize;
+			}
+			distance += 0x4000;
+		}
+		else { // Below 16 after literals: a short match
+			if (in >= sourceSize) return false;
+			if (state == AfterLiteralRun) {
+				distance = 1 + 0x800 + (instruction >> 2) + (static_cast<size_t>(source[in++]) << 2);
+				length = 3;
+			}
+			else {
+				distance = 1 + (instruction >> 2) + (static_cast<size_t>(source[in++]) << 2);
+				length = 2;
+			}
+		}
+
+		if (distance > op || length > outSize - op) return false;
+		for (size_t i = 0; i < length; i++, op++) {
+			out[op] = out[op - distance];
+		}
+
+		// The low two bits of the first distance byte (or of the instruction) are the number of literals that follow
+		size_t trailing = source[in - 2] & 3;
+		if (trailing == 0) {
+			state = Instruction;
+			continue;
+		}
+		if (trailing > sourceSize - in || trailing > outSize - op) return false;
+		memcpy(out + op, source + in, trailing);
+		in += trailing;
+		op += trailing;
+		state = AfterTrailingLiterals;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The compression schemes of PAK archives, without any external library.
+// The output size is always known up front (from the archive), so every function fills exactly outSize bytes and
+// returns false if the data is corrupt, ends early or doesn't decompress to exactly that size.
+class Decompressor
+{
+public:
+	// Checks the two byte zlib header (deflate, no preset dictionary).
+	static bool isZlibStream(const uint8_t *source, size_t sourceSize);
+	// zlib stream (RFC 1950) around deflate data (RFC 1951). The Adler-32 checksum is checked if it is present.
+	static bool inflateZlib(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize);
+	// Plain LZO1X data
+	static bool decompressLzo(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize);
+	// LZO1X in segments, each with a big-endian 16-bit size in front. A negative size is a stored segment of -size bytes.
+	static bool decompressLzoSegments(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize);
+
+private:
+	// Decompresses one LZO1X stream to at most outSize bytes. written receives the size of the output.
+	static bool decompressLzoStream(const uint8_t *source, size_t sourceSize, uint8_t *out, size_t outSize, size_t &written);
+};
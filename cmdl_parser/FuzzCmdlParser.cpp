@@ -0,0 +1,34 @@
+// libFuzzer entry point for the CMDL parser. It replaces main(), so it is excluded from the regular build (see the README).
+#include "CmdlParser.h"
+#include "MeshOptimizer.h"
+
+#include <ostream>
+#include <stdlib.h>
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	// Writes to a stream without a buffer are dropped.
+	std::ostream nullLog(nullptr);
+
+	// Both strip modes, they are decoded by different code.
+	for (int mode = 0; mode < 2; mode++) {
+		CmdlParser parser(nullLog);
+		parser.setStripMode(mode == 0 ? PrimitiveDecoder::TriangulateStrips : PrimitiveDecoder::KeepStrips);
+		if (!parser.open(ByteSpan(data, size))) {
+			if (parser.getError().message.empty()) abort(); // Every failure has to explain itself
+			return 0;
+		}
+
+		Mesh mesh;
+		if (!parser.parse(mesh)) {
+			if (parser.getError().message.empty()) abort();
+			continue;
+		}
+
+		// The optimizer takes whatever indices the file has.
+		MeshOptimizer optimizer;
+		optimizer.optimize(mesh);
+	}
+	return 0;
+}
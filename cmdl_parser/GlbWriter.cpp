@@ -0,0 +1,604 @@
+#include "GlbWriter.h"
+#include "NumberFormat.h"
+#include "MappedFile.h"
+#include "VertexDecoder.h"
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+
+// glTF constants
+static const uint32_t GlbMagic = 0x46546C67;	// "glTF"
+static const uint32_t GlbVersion = 2;
+static const uint32_t ChunkTypeJson = 0x4E4F534A;	// "JSON"
+static const uint32_t ChunkTypeBin = 0x004E4942;	// "BIN\0"
+static const unsigned int ComponentShort = 5122;
+static const unsigned int ComponentUnsignedShort = 5123;
+static const unsigned int ComponentUnsignedInt = 5125;
+static const unsigned int ComponentFloat = 5126;
+static const unsigned int TargetArrayBuffer = 34962;
+static const unsigned int TargetElementArrayBuffer = 34963;
+
+static void appendUInt(ArenaString &json, uint32_t value)
+{
+	char text[NumberFormat::MaxLength];
+	json.append(text, NumberFormat::formatUInt(value, text));
+}
+
+static void appendFloat(ArenaString &json, float value)
+{
+	if (!(value >= -FLT_MAX && value <= FLT_MAX)) value = 0.0f; // JSON has no nan or inf
+	char text[NumberFormat::MaxLength];
+	json.append(text, NumberFormat::formatFloatShortest(value, text));
+}
+
+// The dequantization scales are powers of two. All their digits are written, so readers that parse doubles get them
+// exactly as well.
+static void appendScale(ArenaString &json, double value)
+{
+	char text[32];
+	sprintf_s(text, sizeof(text), "%.17g", value);
+	json += text;
+}
+
+static void appendString(ArenaString &json, const char *value, size_t length)
+{
+	json += '"';
+	for (size_t i = 0; i < length; i++) {
+		if (value[i] == '"' || value[i] == '\\') json += '\\';
+		if (static_cast<unsigned char>(value[i]) >= 0x20) json += value[i];
+	}
+	json += '"';
+}
+
+static void appendFourCC(ArenaString &json, uint32_t fourCC)
+{
+	std::string text = Material::fourCCToString(fourCC); // Short enough to stay off the heap
+	appendString(json, text.data(), text.length());
+}
+
+static void appendTextureId(ArenaString &text, uint64_t textureId)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+	for (int shift = 60; shift >= 0; shift -= 4) {
+		text += hexDigits[(textureId >> shift) & 0xF];
+	}
+}
+
+static void appendTextureFileName(ArenaString &text, uint64_t textureId)
+{
+	appendTextureId(text, textureId);
+	text += ".dds";
+}
+
+// The PASS, CLR and INT sections of the material, so nothing of the CMDL material is lost. Texture ids are hex strings
+// because JSON numbers can't hold 64-bit integers.
+static void appendMaterialExtras(ArenaString &json, const Material &material)
+{
+	const ArenaVector<MaterialPass> &passes = material.getPasses();
+	json += ",\"extras\":{\"passes\":[";
+	for (size_t p = 0; p < passes.size(); p++) {
+		json += (p == 0) ? "{\"type\":" : ",{\"type\":";
+		appendFourCC(json, passes[p].type);
+		json += ",\"flags\":";
+		appendUInt(json, passes[p].flags);
+		json += ",\"texture\":\"";
+		appendTextureId(json, passes[p].textureId);
+		json += "\",\"uvSource\":";
+		appendUInt(json, passes[p].uvSource);
+		json += ",\"uvAnimationSize\":";
+		appendUInt(json, passes[p].uvAnimationSize);
+		json += '}';
+	}
+	const ArenaVector<MaterialColor> &colors = material.getColors();
+	json += "],\"colors\":[";
+	for (size_t c = 0; c < colors.size(); c++) {
+		json += (c == 0) ? "{\"type\":" : ",{\"type\":";
+		appendFourCC(json, colors[c].type);
+		json += ",\"rgba\":";
+		appendUInt(json, colors[c].rgba);
+		json += '}';
+	}
+	const ArenaVector<MaterialInt> &ints = material.getInts();
+	json += "],\"ints\":[";
+	for (size_t i = 0; i < ints.size(); i++) {
+		json += (i == 0) ? "{\"type\":" : ",{\"type\":";
+		appendFourCC(json, ints[i].type);
+		json += ",\"value\":";
+		appendUInt(json, ints[i].value);
+		json += '}';
+	}
+	json += "]}";
+}
+
+static void appendBytes(ArenaVector<uint8_t> &buffer, const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+// Buffer views have to start on a multiple of 4 bytes.
+static void alignBuffer(ArenaVector<uint8_t> &buffer)
+{
+	while (buffer.size() % 4 != 0) buffer.push_back(0);
+}
+
+static void appendBufferView(ArenaString &json, size_t offset, size_t length, unsigned int stride, unsigned int target)
+{
+	json += json.back() == '[' ? "{\"buffer\":0,\"byteOffset\":" : ",{\"buffer\":0,\"byteOffset\":";
+	appendUInt(json, static_cast<uint32_t>(offset));
+	json += ",\"byteLength\":";
+	appendUInt(json, static_cast<uint32_t>(length));
+	if (stride != 0) {
+		json += ",\"byteStride\":";
+		appendUInt(json, stride);
+	}
+	if (target != 0) {
+		json += ",\"target\":";
+		appendUInt(json, target);
+	}
+	json += '}';
+}
+
+static void appendAccessor(ArenaString &json, unsigned int bufferView, unsigned int byteOffset, unsigned int componentType, uint32_t count, const char *type)
+{
+	json += json.back() == '[' ? "{\"bufferView\":" : ",{\"bufferView\":";
+	appendUInt(json, bufferView);
+	if (byteOffset != 0) {
+		json += ",\"byteOffset\":";
+		appendUInt(json, byteOffset);
+	}
+	json += ",\"componentType\":";
+	appendUInt(json, componentType);
+	json += ",\"count\":";
+	appendUInt(json, count);
+	json += ",\"type\":\"";
+	json += type;
+	json += '"';
+}
+
+
+typedef std::map<uint64_t, unsigned int, std::less<uint64_t>, ArenaAllocator<std::pair<const uint64_t, unsigned int> > > TextureIndexMap;
+
+// Appends name to a JSON array that is either empty or ends with ']'.
+static void appendExtension(ArenaString &list, const char *name)
+{
+	if (list.empty()) {
+		list = "[\"";
+	}
+	else {
+		list.back() = ',';
+		list += '"';
+	}
+	list += name;
+	list += "\"]";
+}
+
+
+GlbWriter::GlbWriter(std::ostream &log)
+	: log(log), quantizePositions(false), quantizeUvs(false)
+{
+}
+
+uint32_t GlbWriter::addVertex(VertexStream &stream, const Mesh &mesh, const IndexTriplet &corner)
+{
+	uint64_t key = corner.pos | (static_cast<uint64_t>(stream.hasNormals ? corner.norm : 0) << 16) | (static_cast<uint64_t>(stream.hasUvs ? corner.tex : 0) << 32);
+	std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> entry = stream.vertexIndices.insert(std::make_pair(key, stream.vertexCount));
+	if (!entry.second) {
+		return entry.first->second;
+	}
+
+	size_t offset = stream.vertices.size();
+	stream.vertices.resize(offset + stream.stride, 0);
+	uint8_t *vertex = stream.vertices.data() + offset;
+
+	// Indices past the end of an attribute array get zeros instead of reading out of bounds.
+	float position[3] = { 0.0f, 0.0f, 0.0f };
+	if (corner.pos < mesh.positions.size()) {
+		position[0] = mesh.positions.x[corner.pos];
+		position[1] = mesh.positions.y[corner.pos];
+		position[2] = mesh.positions.z[corner.pos];
+	}
+	if (this->quantizePositions) {
+		int16_t quantized[3];
+		for (int i = 0; i < 3; i++) {
+			quantized[i] = VertexDecoder::quantizePosition(position[i]);
+			position[i] = quantized[i];
+		}
+		memcpy(vertex, quantized, sizeof(quantized));
+	}
+	else {
+		memcpy(vertex, position, sizeof(position));
+	}
+	for (int i = 0; i < 3; i++) {
+		if (stream.vertexCount == 0 || position[i] < stream.minPosition[i]) stream.minPosition[i] = position[i];
+		if (stream.vertexCount == 0 || position[i] > stream.maxPosition[i]) stream.maxPosition[i] = position[i];
+	}
+
+	if (stream.hasNormals) {
+		bool valid = corner.norm < mesh.normals.size();
+		float normal[3] = { valid ? mesh.normals.x[corner.norm] : 0.0f, valid ? mesh.normals.y[corner.norm] : 0.0f, valid ? mesh.normals.z[corner.norm] : 1.0f };
+		memcpy(vertex + stream.normalOffset, normal, sizeof(normal));
+	}
+	if (stream.hasUvs) {
+		bool valid = corner.tex < mesh.uvs.size();
+		float u = valid ? mesh.uvs.u[corner.tex] : 0.0f;
+		float v = valid ? mesh.uvs.v[corner.tex] : 0.0f;
+		if (this->quantizeUvs) {
+			uint16_t quantized[2] = { VertexDecoder::quantizeU(u), VertexDecoder::quantizeV(v) };
+			memcpy(vertex + stream.uvOffset, quantized, sizeof(quantized));
+		}
+		else {
+			// The decoder flips v for OBJ (origin at the bottom). glTF has the origin at the top like the source data.
+			float uv[2] = { u, -v };
+			memcpy(vertex + stream.uvOffset, uv, sizeof(uv));
+		}
+	}
+	return stream.vertexCount++;
+}
+
+void GlbWriter::buildPrimitives(const Mesh &mesh)
+{
+	for (int i = 0; i < 4; i++) {
+		this->streams[i] = VertexStream(mesh.getArena());
+		VertexStream &stream = this->streams[i];
+		stream.hasNormals = (i & 1) != 0;
+		stream.hasUvs = (i & 2) != 0;
+		// Quantized positions are padded from 6 to 8 bytes.
+		stream.normalOffset = this->quantizePositions ? 8 : 12;
+		stream.uvOffset = stream.normalOffset + (stream.hasNormals ? 12 : 0);
+		stream.stride = stream.uvOffset + (stream.hasUvs ? (this->quantizeUvs ? 4 : 8) : 0);
+	}
+	this->primitives = ArenaVector<Primitive>(ArenaAllocator<Primitive>(mesh.getArena()));
+	this->primitives.reserve(2 * mesh.submeshes.size()); // A strip and a triangle list per submesh at most
+
+	// Reserve for the worst case of no shared corners at all, so the maps never rehash.
+	size_t streamCorners[4] = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < mesh.submeshes.size(); i++) {
+		streamCorners[(mesh.submeshes[i].hasNormals ? 1 : 0) | (mesh.submeshes[i].hasUvs ? 2 : 0)] += mesh.submeshes[i].indices.size() + mesh.submeshes[i].stripCorners.size();
+	}
+	for (int i = 0; i < 4; i++) {
+		this->streams[i].vertexIndices.reserve(streamCorners[i]);
+	}
+
+	for (size_t i = 0; i < mesh.submeshes.size(); i++) {
+		const Submesh &submesh = mesh.submeshes[i];
+		if (!submesh.stripLengths.empty()) this->addStripPrimitive(mesh, submesh);
+		if (submesh.indices.size() < 3) continue; // glTF doesn't allow empty accessors
+
+		this->primitives.emplace_back(mesh.getArena());
+		Primitive &primitive = this->primitives.back();
+		primitive.stream = (submesh.hasNormals ? 1 : 0) | (submesh.hasUvs ? 2 : 0);
+		primitive.materialIndex = submesh.materialIndex;
+		primitive.strip = false;
+		primitive.indices.resize(submesh.indices.size());
+
+		VertexStream &stream = this->streams[primitive.stream];
+		for (size_t c = 0; c < primitive.indices.size(); c++) {
+			primitive.indices[c] = this->addVertex(stream, mesh, submesh.indices[c]);
+		}
+	}
+}
+
+void GlbWriter::addStripPrimitive(const Mesh &mesh, const Submesh &submesh)
+{
+	this->primitives.emplace_back(mesh.getArena());
+	Primitive &primitive = this->primitives.back();
+	primitive.stream = (submesh.hasNormals ? 1 : 0) | (submesh.hasUvs ? 2 : 0);
+	primitive.materialIndex = submesh.materialIndex;
+	primitive.strip = true;
+	primitive.indices.reserve(submesh.stripCorners.size() + 3 * submesh.stripLengths.size());
+
+	VertexStream &stream = this->streams[primitive.stream];
+	const IndexTriplet *corner = submesh.stripCorners.data();
+	for (size_t s = 0; s < submesh.stripLengths.size(); s++) {
+		uint32_t first = this->addVertex(stream, mesh, *corner);
+		if (s > 0) {
+			// Repeating the last and the first corner gives degenerate triangles only. Every strip has to start at an
+			// even position, otherwise its winding order would be flipped.
+			uint32_t last = primitive.indices.back();
+			primitive.indices.push_back(last);
+			if (primitive.indices.size() % 2 == 0) primitive.indices.push_back(last);
+			primitive.indices.push_back(first);
+		}
+		primitive.indices.push_back(first);
+		corner++;
+		for (uint32_t c = 1; c < submesh.stripLengths[s]; c++, corner++) {
+			primitive.indices.push_back(this->addVertex(stream, mesh, *corner));
+		}
+	}
+}
+
+size_t GlbWriter::getBinarySize(const Mesh &mesh, TextureMode textureMode, const std::string &textureDir) const
+{
+	size_t size = 0;
+	for (int i = 0; i < 4; i++) {
+		size += (this->streams[i].vertices.size() + 3) & ~static_cast<size_t>(3);
+	}
+	for (size_t i = 0; i < this->primitives.size(); i++) {
+		size_t indexSize = (this->streams[this->primitives[i].stream].vertexCount <= 0xFFFF) ? sizeof(uint16_t) : sizeof(uint32_t);
+		size += (this->primitives[i].indices.size() * indexSize + 3) & ~static_cast<size_t>(3);
+	}
+	if (textureMode != EmbedTextures) return size;
+
+	// Every texture once, like the images of write()
+	ArenaVector<uint64_t> textureIds((ArenaAllocator<uint64_t>(mesh.getArena())));
+	textureIds.reserve(mesh.materials.size());
+	for (size_t i = 0; i < mesh.materials.size(); i++) {
+		uint64_t textureId = mesh.materials[i]->getTextureId();
+		if (textureId == 0 || TextureAtlas::isAtlasTexture(textureId) || std::find(textureIds.begin(), textureIds.end(), textureId) != textureIds.end()) continue;
+		textureIds.push_back(textureId);
+
+		ArenaString uri(textureDir.data(), textureDir.length(), ArenaAllocator<char>(mesh.getArena()));
+		appendTextureFileName(uri, textureId);
+		int64_t fileSize = MappedFile::getFileSize(std::string(uri.data(), uri.length()));
+		if (fileSize > 0) size += (static_cast<size_t>(fileSize) + 3) & ~static_cast<size_t>(3);
+	}
+	return size;
+}
+
+bool GlbWriter::write(const std::string &fileName, const Mesh &mesh, TextureMode textureMode, const std::string &textureDir, bool quantize /*= false*/)
+{
+	this->quantizePositions = quantize && (mesh.flags & 0x20) == 0x20;
+	this->quantizeUvs = quantize;
+	this->buildPrimitives(mesh);
+
+	// The JSON and the binary chunk are built in the arena of the mesh, like the vertex streams.
+	Arena *arena = mesh.getArena();
+	ArenaVector<uint8_t> binary((ArenaAllocator<uint8_t>(arena)));
+	binary.reserve(this->getBinarySize(mesh, textureMode, textureDir));
+	ArenaString bufferViews("[", ArenaAllocator<char>(arena));
+	ArenaString accessors("[", ArenaAllocator<char>(arena));
+	unsigned int bufferViewCount = 0, accessorCount = 0;
+
+	// Vertex buffers and their attribute accessors
+	unsigned int streamAccessors[4];
+	for (int i = 0; i < 4; i++) {
+		const VertexStream &stream = this->streams[i];
+		if (stream.vertexCount == 0) continue;
+
+		alignBuffer(binary);
+		appendBufferView(bufferViews, binary.size(), stream.vertices.size(), stream.stride, TargetArrayBuffer);
+		appendBytes(binary, stream.vertices.data(), stream.vertices.size());
+
+		streamAccessors[i] = accessorCount;
+		appendAccessor(accessors, bufferViewCount, 0, this->quantizePositions ? ComponentShort : ComponentFloat, stream.vertexCount, "VEC3");
+		accessors += ",\"min\":[";
+		for (int c = 0; c < 3; c++) {
+			if (c > 0) accessors += ',';
+			appendFloat(accessors, stream.minPosition[c]);
+		}
+		accessors += "],\"max\":[";
+		for (int c = 0; c < 3; c++) {
+			if (c > 0) accessors += ',';
+			appendFloat(accessors, stream.maxPosition[c]);
+		}
+		accessors += "]}";
+		accessorCount++;
+
+		if (stream.hasNormals) {
+			appendAccessor(accessors, bufferViewCount, stream.normalOffset, ComponentFloat, stream.vertexCount, "VEC3");
+			accessors += '}';
+			accessorCount++;
+		}
+		if (stream.hasUvs) {
+			appendAccessor(accessors, bufferViewCount, stream.uvOffset, this->quantizeUvs ? ComponentUnsignedShort : ComponentFloat, stream.vertexCount, "VEC2");
+			accessors += '}';
+			accessorCount++;
+		}
+		bufferViewCount++;
+	}
+
+	// Index buffers, 16-bit wherever the vertex buffer is small enough
+	ArenaString primitiveList("[", ArenaAllocator<char>(arena));
+	ArenaVector<uint16_t> shortIndices((ArenaAllocator<uint16_t>(arena)));
+	size_t maxShortIndices = 0;
+	for (size_t i = 0; i < this->primitives.size(); i++) {
+		if (this->streams[this->primitives[i].stream].vertexCount <= 0xFFFF) maxShortIndices = std::max(maxShortIndices, this->primitives[i].indices.size());
+	}
+	shortIndices.reserve(maxShortIndices);
+	for (size_t i = 0; i < this->primitives.size(); i++) {
+		const Primitive &primitive = this->primitives[i];
+		const VertexStream &stream = this->streams[primitive.stream];
+		bool shortIndex = stream.vertexCount <= 0xFFFF;
+
+		alignBuffer(binary);
+		size_t offset = binary.size();
+		if (shortIndex) {
+			shortIndices.assign(primitive.indices.begin(), primitive.indices.end());
+			appendBytes(binary, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+		}
+		else {
+			appendBytes(binary, primitive.indices.data(), primitive.indices.size() * sizeof(uint32_t));
+		}
+		appendBufferView(bufferViews, offset, binary.size() - offset, 0, TargetElementArrayBuffer);
+		appendAccessor(accessors, bufferViewCount++, 0, shortIndex ? ComponentUnsignedShort : ComponentUnsignedInt, static_cast<uint32_t>(primitive.indices.size()), "SCALAR");
+		accessors += '}';
+
+		unsigned int attribute = streamAccessors[primitive.stream];
+		primitiveList += (i == 0) ? "{\"attributes\":{\"POSITION\":" : ",{\"attributes\":{\"POSITION\":";
+		appendUInt(primitiveList, attribute++);
+		if (stream.hasNormals) {
+			primitiveList += ",\"NORMAL\":";
+			appendUInt(primitiveList, attribute++);
+		}
+		if (stream.hasUvs) {
+			primitiveList += ",\"TEXCOORD_0\":";
+			appendUInt(primitiveList, attribute++);
+		}
+		primitiveList += "},\"indices\":";
+		appendUInt(primitiveList, accessorCount++);
+		if (primitive.strip) {
+			primitiveList += ",\"mode\":5"; // TRIANGLE_STRIP
+		}
+		if (primitive.materialIndex < mesh.materials.size()) {
+			primitiveList += ",\"material\":";
+			appendUInt(primitiveList, primitive.materialIndex);
+		}
+		primitiveList += '}';
+	}
+	primitiveList += ']';
+
+	// Materials and their textures. Every texture id becomes one image, no matter how many materials use it.
+	ArenaString materials("[", ArenaAllocator<char>(arena)), textures("[", ArenaAllocator<char>(arena)), images("[", ArenaAllocator<char>(arena));
+	TextureIndexMap textureIndices((ArenaAllocator<std::pair<const uint64_t, unsigned int> >(arena)));
+	for (size_t i = 0; i < mesh.materials.size(); i++) {
+		const Material &material = *mesh.materials[i];
+		materials += (i == 0) ? "{\"name\":" : ",{\"name\":";
+		appendString(materials, material.getMaterialName().data(), material.getMaterialName().length());
+		materials += ",\"pbrMetallicRoughness\":{";
+
+		uint32_t rgba;
+		if (material.findColor(Material::DiffuseColor, rgba)) {
+			materials += "\"baseColorFactor\":[";
+			for (int shift = 24; shift >= 0; shift -= 8) {
+				appendFloat(materials, ((rgba >> shift) & 0xFF) / 255.0f);
+				materials += (shift > 0) ? ',' : ']';
+			}
+			materials += ',';
+		}
+
+		uint64_t textureId = material.getTextureId();
+		if (textureId != 0) { // Materials without a PASS section have no texture
+			TextureIndexMap::iterator texture = textureIndices.find(textureId);
+			if (texture == textureIndices.end()) {
+				unsigned int textureIndex = static_cast<unsigned int>(textureIndices.size());
+				texture = textureIndices.insert(std::make_pair(textureId, textureIndex)).first;
+
+				ArenaString uri(textureDir.data(), textureDir.length(), ArenaAllocator<char>(arena));
+				appendTextureFileName(uri, textureId);
+
+				// Atlases are written after the models, so they can't be embedded
+				MappedFile ddsFile;
+				if (textureMode == EmbedTextures && !TextureAtlas::isAtlasTexture(textureId) && !ddsFile.open(std::string(uri.data(), uri.length()))) {
+					this->log << "Failed to embed " << uri << ", it is referenced instead" << std::endl;
+				}
+
+				images += (textureIndex == 0) ? "{" : ",{";
+				if (ddsFile.isOpen()) {
+					alignBuffer(binary);
+					appendBufferView(bufferViews, binary.size(), ddsFile.span().size(), 0, 0);
+					appendBytes(binary, ddsFile.span().data(), ddsFile.span().size());
+					images += "\"bufferView\":";
+					appendUInt(images, bufferViewCount++);
+					images += ",\"mimeType\":\"image/vnd-ms.dds\"}";
+				}
+				else {
+					images += "\"uri\":";
+					appendString(images, uri.data(), uri.length());
+					images += '}';
+				}
+
+				textures += (textureIndex == 0) ? "{" : ",{";
+				textures += "\"extensions\":{\"MSFT_texture_dds\":{\"source\":";
+				appendUInt(textures, textureIndex);
+				textures += "}}}";
+			}
+			materials += "\"baseColorTexture\":{\"index\":";
+			appendUInt(materials, texture->second);
+			if (this->quantizeUvs) {
+				materials += ",\"extensions\":{\"KHR_texture_transform\":{\"scale\":[";
+				appendScale(materials, 1.0 / VertexDecoder::UvDivisor);
+				materials += ',';
+				appendScale(materials, 1.0 / VertexDecoder::UvDivisor);
+				materials += "]}}";
+			}
+			materials += "},";
+		}
+		materials += "\"metallicFactor\":0}";
+		appendMaterialExtras(materials, material);
+		materials += '}';
+	}
+	materials += ']';
+	textures += ']';
+	images += ']';
+	bufferViews += ']';
+	accessors += ']';
+	alignBuffer(binary);
+
+	// There is no fallback image in another format, so viewers have to support DDS. The quantized attributes don't
+	// have a fallback either.
+	ArenaString extensions((ArenaAllocator<char>(arena)));
+	if (!textureIndices.empty()) appendExtension(extensions, "MSFT_texture_dds");
+	bool quantizedUvs = this->quantizeUvs && (this->streams[2].vertexCount > 0 || this->streams[3].vertexCount > 0);
+	if (this->quantizePositions || quantizedUvs) appendExtension(extensions, "KHR_mesh_quantization");
+	if (quantizedUvs && !textureIndices.empty()) appendExtension(extensions, "KHR_texture_transform");
+
+	// Appended piece by piece, operator+ would make its temporaries on the heap
+	ArenaString json("{\"asset\":{\"version\":\"2.0\",\"generator\":\"cmdl_parser\"}", ArenaAllocator<char>(arena));
+	if (!extensions.empty()) {
+		json += ",\"extensionsUsed\":";
+		json += extensions;
+		json += ",\"extensionsRequired\":";
+		json += extensions;
+	}
+	if (this->primitives.empty()) {
+		json += ",\"scene\":0,\"scenes\":[{}]";
+	}
+	else {
+		json += ",\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0";
+		if (this->quantizePositions) {
+			json += ",\"scale\":[";
+			for (int c = 0; c < 3; c++) {
+				if (c > 0) json += ',';
+				appendScale(json, 1.0 / VertexDecoder::PositionDivisor);
+			}
+			json += ']';
+		}
+		json += "}],\"meshes\":[{\"primitives\":";
+		json += primitiveList;
+		json += "}]";
+	}
+	if (!mesh.materials.empty()) {
+		json += ",\"materials\":";
+		json += materials;
+	}
+	if (!textureIndices.empty()) {
+		json += ",\"textures\":";
+		json += textures;
+		json += ",\"images\":";
+		json += images;
+	}
+	if (!binary.empty()) {
+		json += ",\"buffers\":[{\"byteLength\":";
+		appendUInt(json, static_cast<uint32_t>(binary.size()));
+		json += "}],\"bufferViews\":";
+		json += bufferViews;
+		if (accessorCount > 0) {
+			json += ",\"accessors\":";
+			json += accessors;
+		}
+	}
+	json += '}';
+	while (json.length() % 4 != 0) json += ' ';
+
+	std::ofstream glbFile(fileName, std::ofstream::binary);
+	if (!glbFile.is_open()) {
+		this->log << "Failed to create " << fileName << std::endl;
+		return false;
+	}
+
+	// Header, JSON chunk and binary chunk. glTF is little-endian like the machines we run on.
+	uint32_t header[3] = { GlbMagic, GlbVersion, static_cast<uint32_t>(12 + 8 + json.length() + (binary.empty() ? 0 : 8 + binary.size())) };
+	glbFile.write(reinterpret_cast<const char *>(header), sizeof(header));
+	uint32_t jsonChunk[2] = { static_cast<uint32_t>(json.length()), ChunkTypeJson };
+	glbFile.write(reinterpret_cast<const char *>(jsonChunk), sizeof(jsonChunk));
+	glbFile.write(json.data(), json.length());
+	if (!binary.empty()) {
+		uint32_t binaryChunk[2] = { static_cast<uint32_t>(binary.size()), ChunkTypeBin };
+		glbFile.write(reinterpret_cast<const char *>(binaryChunk), sizeof(binaryChunk));
+		glbFile.write(reinterpret_cast<const char *>(binary.data()), binary.size());
+	}
+	glbFile.close();
+
+	if (glbFile.fail()) {
+		this->log << "Failed to write " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
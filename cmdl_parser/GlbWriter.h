@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "Mesh.h"
+
+// Writes a Mesh as binary glTF 2.0 (.glb).
+// The separate position/normal/uv indices are welded into unique interleaved vertices, so the file can be uploaded
+// to a GPU as it is. Textures are DDS files (MSFT_texture_dds), either referenced by path or embedded into the file.
+// Quantized files keep the 16-bit integers of the CMDL file for the positions (if the file has 16-bit positions) and
+// the uvs (KHR_mesh_quantization). The node scale and a KHR_texture_transform on every texture dequantize them.
+// Normals stay floats: glTF only has normalized integer normals, which can't hold value / 0x4000 exactly.
+class GlbWriter
+{
+public:
+	enum TextureMode
+	{
+		ReferenceTextures,	// The images point to the DDS files
+		EmbedTextures		// The DDS files are copied into the binary chunk
+	};
+
+	GlbWriter(std::ostream &log);
+
+	// textureDir is the directory of the DDS files (with trailing slash). Referenced textures use it as their URI.
+	bool write(const std::string &fileName, const Mesh &mesh, TextureMode textureMode, const std::string &textureDir, bool quantize = false);
+
+private:
+	// All vertices with the same set of attributes share one interleaved vertex buffer.
+	struct VertexStream
+	{
+		bool hasNormals;
+		bool hasUvs;
+		// Byte offsets of the attributes in a vertex and the size of a vertex. Every attribute starts on 4 bytes.
+		unsigned int normalOffset;
+		unsigned int uvOffset;
+		unsigned int stride;
+		uint32_t vertexCount;
+		ArenaVector<uint8_t> vertices;
+		// (pos, norm, tex) -> vertex
+		std::unordered_map<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<std::pair<const uint64_t, uint32_t> > > vertexIndices;
+		float minPosition[3];	// As stored, the integers if quantized
+		float maxPosition[3];
+
+		// The buffers are only needed while the file is written, so they come from the arena of the mesh.
+		explicit VertexStream(Arena *arena = nullptr) : hasNormals(false), hasUvs(false), normalOffset(0), uvOffset(0), stride(0), vertexCount(0),
+			vertices(ArenaAllocator<uint8_t>(arena)), vertexIndices(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), ArenaAllocator<std::pair<const uint64_t, uint32_t> >(arena)) {}
+	};
+
+	struct Primitive
+	{
+		unsigned int stream;
+		uint16_t materialIndex;
+		bool strip;	// One triangle strip instead of a triangle list
+		ArenaVector<uint32_t> indices;
+
+		explicit Primitive(Arena *arena = nullptr) : stream(0), materialIndex(0), strip(false), indices(ArenaAllocator<uint32_t>(arena)) {}
+	};
+
+	void buildPrimitives(const Mesh &mesh);
+	// Joins the kept strips of the submesh into one strip, with degenerate triangles in between.
+	void addStripPrimitive(const Mesh &mesh, const Submesh &submesh);
+	uint32_t addVertex(VertexStream &stream, const Mesh &mesh, const IndexTriplet &corner);
+	// The size of the binary chunk: the vertex and index buffers and the embedded DDS files, each padded to 4 bytes.
+	size_t getBinarySize(const Mesh &mesh, TextureMode textureMode, const std::string &textureDir) const;
+
+private:
+	GlbWriter(const GlbWriter &) = delete;
+	GlbWriter &operator=(const GlbWriter &) = delete;
+
+	std::ostream &log;
+	bool quantizePositions;
+	bool quantizeUvs;
+	VertexStream streams[4]; // Indexed by (hasNormals ? 1 : 0) | (hasUvs ? 2 : 0)
+	ArenaVector<Primitive> primitives;
+};
@@ -0,0 +1,30 @@
+#include "LogBuffer.h"
+
+
+LogBuffer::LogBuffer(Arena *arena /*= nullptr*/)
+	: text(ArenaAllocator<char>(arena))
+{
+}
+
+void LogBuffer::clear()
+{
+	this->text.clear();
+}
+
+const ArenaString &LogBuffer::getText() const
+{
+	return this->text;
+}
+
+// There is no put area, so every character ends up here or in xsputn()
+LogBuffer::int_type LogBuffer::overflow(int_type c)
+{
+	if (!traits_type::eq_int_type(c, traits_type::eof())) this->text += traits_type::to_char_type(c);
+	return traits_type::not_eof(c);
+}
+
+std::streamsize LogBuffer::xsputn(const char *text, std::streamsize count)
+{
+	this->text.append(text, static_cast<size_t>(count));
+	return count;
+}
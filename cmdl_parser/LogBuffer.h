@@ -0,0 +1,25 @@
+#pragma once
+
+#include <streambuf>
+#include <string>
+
+#include "Arena.h"
+
+// Collects the log of one file in memory. The text keeps its capacity when it is cleared, so a worker that reuses
+// the buffer for every file it converts stops allocating once it has seen the longest log. With an arena the text is
+// allocated from it, e.g. the logs of the submesh sections that are decoded in parallel.
+class LogBuffer : public std::streambuf
+{
+public:
+	explicit LogBuffer(Arena *arena = nullptr);
+
+	void clear();
+	const ArenaString &getText() const;
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char *text, std::streamsize count) override;
+
+private:
+	ArenaString text;
+};
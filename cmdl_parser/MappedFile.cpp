@@ -0,0 +1,215 @@
+#include "MappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+
+ByteSpan::ByteSpan()
+	: spanData(nullptr), spanSize(0)
+{
+}
+
+ByteSpan::ByteSpan(const uint8_t *data, size_t size)
+	: spanData(data), spanSize(size)
+{
+}
+
+ByteSpan ByteSpan::subSpan(size_t offset, size_t size) const
+{
+	if (offset > this->spanSize) offset = this->spanSize;
+	if (size > this->spanSize - offset) size = this->spanSize - offset;
+	return ByteSpan(this->spanData + offset, size);
+}
+
+
+SpanReader::SpanReader(const ByteSpan &span)
+	: span(span), position(0), failed(false)
+{
+}
+
+ByteSpan SpanReader::readBytes(size_t count)
+{
+	if (!this->require(count)) return ByteSpan();
+	ByteSpan bytes = this->span.subSpan(this->position, count);
+	this->position += count;
+	return bytes;
+}
+
+void SpanReader::readRaw(void *dest, size_t count)
+{
+	if (!this->require(count)) {
+		memset(dest, 0, count);
+		return;
+	}
+	memcpy(dest, this->span.data() + this->position, count);
+	this->position += count;
+}
+
+void SpanReader::seek(size_t offset)
+{
+	if (offset > this->span.size()) {
+		this->position = this->span.size();
+		this->failed = true;
+		return;
+	}
+	this->position = offset;
+}
+
+
+MappedFile::MappedFile()
+	: fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL), view(nullptr), fileSize(0), opened(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+bool MappedFile::open(const std::string &fileName)
+{
+	this->close();
+
+	this->fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (this->fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->fileHandle, &size)) {
+		this->close();
+		return false;
+	}
+	this->fileSize = static_cast<size_t>(size.QuadPart);
+
+	// Empty files can't be mapped, but they are still valid (empty) files.
+	if (this->fileSize > 0) {
+		this->mappingHandle = CreateFileMappingA(this->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (this->mappingHandle == NULL) {
+			this->close();
+			return false;
+		}
+
+		this->view = static_cast<const uint8_t *>(MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (this->view == nullptr) {
+			this->close();
+			return false;
+		}
+	}
+
+	this->opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (this->view != nullptr) {
+		UnmapViewOfFile(this->view);
+		this->view = nullptr;
+	}
+	if (this->mappingHandle != NULL) {
+		CloseHandle(this->mappingHandle);
+		this->mappingHandle = NULL;
+	}
+	if (this->fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(this->fileHandle);
+		this->fileHandle = INVALID_HANDLE_VALUE;
+	}
+	this->fileSize = 0;
+	this->opened = false;
+}
+
+bool MappedFile::isOpen() const
+{
+	return this->opened;
+}
+
+ByteSpan MappedFile::span() const
+{
+	return ByteSpan(this->view, this->fileSize);
+}
+
+FileReader::FileReader()
+	: fileHandle(INVALID_HANDLE_VALUE), fileSize(0)
+{
+}
+
+FileReader::~FileReader()
+{
+	this->close();
+}
+
+bool FileReader::open(const std::string &fileName)
+{
+	this->close();
+
+	this->fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (this->fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->fileHandle, &size)) {
+		this->close();
+		return false;
+	}
+	this->fileSize = static_cast<uint64_t>(size.QuadPart);
+	return true;
+}
+
+void FileReader::close()
+{
+	if (this->fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(this->fileHandle);
+		this->fileHandle = INVALID_HANDLE_VALUE;
+	}
+	this->fileSize = 0;
+}
+
+bool FileReader::isOpen() const
+{
+	return this->fileHandle != INVALID_HANDLE_VALUE;
+}
+
+uint64_t FileReader::size() const
+{
+	return this->fileSize;
+}
+
+bool FileReader::read(uint64_t offset, size_t size, std::vector<uint8_t> &buffer)
+{
+	buffer.clear();
+	if (!this->isOpen()) return false;
+	if (offset >= this->fileSize) return true;
+	if (size > this->fileSize - offset) size = static_cast<size_t>(this->fileSize - offset);
+
+	LARGE_INTEGER position;
+	position.QuadPart = static_cast<LONGLONG>(offset);
+	if (!SetFilePointerEx(this->fileHandle, position, NULL, FILE_BEGIN)) return false;
+
+	// Keeps the capacity, so a buffer that is reused doesn't allocate once it has reached the biggest size.
+	buffer.resize(size);
+	size_t done = 0;
+	while (done < size) {
+		DWORD chunk = static_cast<DWORD>(size - done > 0x40000000 ? 0x40000000 : size - done);
+		DWORD bytesRead = 0;
+		if (!ReadFile(this->fileHandle, buffer.data() + done, chunk, &bytesRead, NULL) || bytesRead == 0) {
+			buffer.resize(done);
+			return false;
+		}
+		done += bytesRead;
+	}
+	return true;
+}
+
+int64_t MappedFile::getFileSize(const std::string &fileName)
+{
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+	if (file == INVALID_HANDLE_VALUE) return -1;
+
+	LARGE_INTEGER size;
+	BOOL success = GetFileSizeEx(file, &size);
+	CloseHandle(file);
+	return success ? static_cast<int64_t>(size.QuadPart) : -1;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <intrin.h>
+
+// A non-owning view of a range of bytes (usually a part of a MappedFile).
+class ByteSpan
+{
+public:
+	ByteSpan();
+	ByteSpan(const uint8_t *data, size_t size);
+
+	const uint8_t *data() const { return this->spanData; }
+	size_t size() const { return this->spanSize; }
+	bool empty() const { return this->spanSize == 0; }
+
+	// Returns the part [offset, offset + size) of this span. The result is clamped to the bounds of this span.
+	ByteSpan subSpan(size_t offset, size_t size) const;
+
+private:
+	const uint8_t *spanData;
+	size_t spanSize;
+};
+
+// Reads big-endian values from a ByteSpan.
+// Reading past the end of the span does not crash: the read returns 0, the cursor stays at the end and fail() is set.
+// This mimics the behaviour of the std::ifstream calls it replaces.
+class SpanReader
+{
+public:
+	SpanReader(const ByteSpan &span);
+
+	uint8_t readU8();
+	uint16_t readU16();
+	int16_t readS16();
+	uint32_t readU32();
+	uint64_t readU64();
+	float readFloat();
+	ByteSpan readBytes(size_t count);
+	void readRaw(void *dest, size_t count);
+
+	uint8_t peekU8() const;
+	void skip(size_t count);
+	void seek(size_t offset);
+	size_t tell() const { return this->position; }
+	size_t remaining() const { return this->span.size() - this->position; }
+	bool fail() const { return this->failed; }
+	const ByteSpan &getSpan() const { return this->span; }
+
+private:
+	bool require(size_t count);
+
+private:
+	ByteSpan span;
+	size_t position;
+	bool failed;
+};
+
+// Maps a whole file read-only into memory.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string &fileName);
+	void close();
+	bool isOpen() const;
+	ByteSpan span() const;
+
+	// Size of a file without mapping it, -1 if it doesn't exist.
+	static int64_t getFileSize(const std::string &fileName);
+
+private:
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+private:
+	void *fileHandle;
+	void *mappingHandle;
+	const uint8_t *view;
+	size_t fileSize;
+	bool opened;
+};
+
+// Reads parts of a file on request, for when the file shouldn't be kept in memory as a whole.
+class FileReader
+{
+public:
+	FileReader();
+	~FileReader();
+
+	bool open(const std::string &fileName);
+	void close();
+	bool isOpen() const;
+	uint64_t size() const;
+
+	// Reads size bytes at offset into buffer, which is resized to the bytes read. Less than size bytes are read only
+	// at the end of the file. Returns false on a read error.
+	bool read(uint64_t offset, size_t size, std::vector<uint8_t> &buffer);
+
+private:
+	FileReader(const FileReader &) = delete;
+	FileReader &operator=(const FileReader &) = delete;
+
+private:
+	void *fileHandle;
+	uint64_t fileSize;
+};
+
+inline bool SpanReader::require(size_t count)
+{
+	if (this->failed || count > this->remaining()) {
+		this->position = this->span.size();
+		this->failed = true;
+		return false;
+	}
+	return true;
+}
+
+inline uint8_t SpanReader::readU8()
+{
+	if (!this->require(1)) return 0;
+	return this->span.data()[this->position++];
+}
+
+inline uint16_t SpanReader::readU16()
+{
+	if (!this->require(2)) return 0;
+	uint16_t value;
+	memcpy(&value, this->span.data() + this->position, sizeof(value));
+	this->position += sizeof(value);
+	return _byteswap_ushort(value);
+}
+
+inline int16_t SpanReader::readS16()
+{
+	return static_cast<int16_t>(this->readU16());
+}
+
+inline uint32_t SpanReader::readU32()
+{
+	if (!this->require(4)) return 0;
+	uint32_t value;
+	memcpy(&value, this->span.data() + this->position, sizeof(value));
+	this->position += sizeof(value);
+	return _byteswap_ulong(value);
+}
+
+inline uint64_t SpanReader::readU64()
+{
+	if (!this->require(8)) return 0;
+	uint64_t value;
+	memcpy(&value, this->span.data() + this->position, sizeof(value));
+	this->position += sizeof(value);
+	return _byteswap_uint64(value);
+}
+
+inline float SpanReader::readFloat()
+{
+	uint32_t bits = this->readU32();
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline uint8_t SpanReader::peekU8() const
+{
+	if (this->failed || this->remaining() < 1) return 0;
+	return this->span.data()[this->position];
+}
+
+inline void SpanReader::skip(size_t count)
+{
+	if (this->require(count)) this->position += count;
+}
@@ -1,10 +1,36 @@
 #include "Material.h"
-
-
-Material::Material(std::string materialName)
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+// GX stores the four 2-bit texel indices of a block row in the opposite order to DXT1.
+// Entry b is b with its 2-bit groups reversed: ((b & 0x3) << 6) | ((b & 0xC) << 2) | ((b & 0x30) >> 2) | ((b & 0xC0) >> 6)
+static const uint8_t swapBitsTable[256] = {
+	0x00, 0x40, 0x80, 0xC0, 0x10, 0x50, 0x90, 0xD0, 0x20, 0x60, 0xA0, 0xE0, 0x30, 0x70, 0xB0, 0xF0,
+	0x04, 0x44, 0x84, 0xC4, 0x14, 0x54, 0x94, 0xD4, 0x24, 0x64, 0xA4, 0xE4, 0x34, 0x74, 0xB4, 0xF4,
+	0x08, 0x48, 0x88, 0xC8, 0x18, 0x58, 0x98, 0xD8, 0x28, 0x68, 0xA8, 0xE8, 0x38, 0x78, 0xB8, 0xF8,
+	0x0C, 0x4C, 0x8C, 0xCC, 0x1C, 0x5C, 0x9C, 0xDC, 0x2C, 0x6C, 0xAC, 0xEC, 0x3C, 0x7C, 0xBC, 0xFC,
+	0x01, 0x41, 0x81, 0xC1, 0x11, 0x51, 0x91, 0xD1, 0x21, 0x61, 0xA1, 0xE1, 0x31, 0x71, 0xB1, 0xF1,
+	0x05, 0x45, 0x85, 0xC5, 0x15, 0x55, 0x95, 0xD5, 0x25, 0x65, 0xA5, 0xE5, 0x35, 0x75, 0xB5, 0xF5,
+	0x09, 0x49, 0x89, 0xC9, 0x19, 0x59, 0x99, 0xD9, 0x29, 0x69, 0xA9, 0xE9, 0x39, 0x79, 0xB9, 0xF9,
+	0x0D, 0x4D, 0x8D, 0xCD, 0x1D, 0x5D, 0x9D, 0xDD, 0x2D, 0x6D, 0xAD, 0xED, 0x3D, 0x7D, 0xBD, 0xFD,
+	0x02, 0x42, 0x82, 0xC2, 0x12, 0x52, 0x92, 0xD2, 0x22, 0x62, 0xA2, 0xE2, 0x32, 0x72, 0xB2, 0xF2,
+	0x06, 0x46, 0x86, 0xC6, 0x16, 0x56, 0x96, 0xD6, 0x26, 0x66, 0xA6, 0xE6, 0x36, 0x76, 0xB6, 0xF6,
+	0x0A, 0x4A, 0x8A, 0xCA, 0x1A, 0x5A, 0x9A, 0xDA, 0x2A, 0x6A, 0xAA, 0xEA, 0x3A, 0x7A, 0xBA, 0xFA,
+	0x0E, 0x4E, 0x8E, 0xCE, 0x1E, 0x5E, 0x9E, 0xDE, 0x2E, 0x6E, 0xAE, 0xEE, 0x3E, 0x7E, 0xBE, 0xFE,
+	0x03, 0x43, 0x83, 0xC3, 0x13, 0x53, 0x93, 0xD3, 0x23, 0x63, 0xA3, 0xE3, 0x33, 0x73, 0xB3, 0xF3,
+	0x07, 0x47, 0x87, 0xC7, 0x17, 0x57, 0x97, 0xD7, 0x27, 0x67, 0xA7, 0xE7, 0x37, 0x77, 0xB7, 0xF7,
+	0x0B, 0x4B, 0x8B, 0xCB, 0x1B, 0x5B, 0x9B, 0xDB, 0x2B, 0x6B, 0xAB, 0xEB, 0x3B, 0x7B, 0xBB, 0xFB,
+	0x0F, 0x4F, 0x8F, 0xCF, 0x1F, 0x5F, 0x9F, 0xDF, 0x2F, 0x6F, 0xAF, 0xEF, 0x3F, 0x7F, 0xBF, 0xFF
+};
+
+
+Material::Material(std::string materialName, Arena *arena /*= nullptr*/)
+	: vertexAttributeFlags(0), textureId(0), passes(ArenaAllocator<MaterialPass>(arena)), colors(ArenaAllocator<MaterialColor>(arena)), ints(ArenaAllocator<MaterialInt>(arena))
 {
 	this->materialName = materialName;
-	this->materialDefinition << "newmtl " << materialName << std::endl;
 }
 
 
@@ -12,6 +38,7 @@ Material::Material(uint32_t vertexAttributeFlags, uint64_t textureId)
 {
 	this->textureId = textureId;
 	this->vertexAttributeFlags = vertexAttributeFlags;
+	this->vertexFormat = VertexFormat::fromAttributeFlags(vertexAttributeFlags);
 }
 
 Material::~Material()
@@ -19,126 +46,127 @@ Material::~Material()
 }
 
 
-void Material::convertTXTRtoDDS(const std::string &textureDir /*= ""*/)
+bool Material::convertTXTRtoDDS(uint64_t textureId, const std::string &textureDir, std::ostream &log)
 {
-	std::stringstream ss;
-	ss << std::hex << this->textureId << std::dec;
-	std::string fileId = ss.str();
-	while (fileId.length() < 16) {
-		ss.str("");
-		ss << "0" << fileId;
-		fileId = ss.str();
+	char fileId[17];
+	sprintf_s(fileId, sizeof(fileId), "%016llx", static_cast<unsigned long long>(textureId));
+	MappedFile txtrFile;
+	if (!txtrFile.open(textureDir + fileId + ".TXTR")) {
+		log << "Opening TXTR File failed: " << textureDir << fileId << ".TXTR" << std::endl;
+		return false;
 	}
-	std::ifstream txtrFile(textureDir + fileId + ".TXTR", std::ifstream::binary);
-
-	if (!txtrFile.fail() && txtrFile.is_open()) {
-		uint32_t txFormat, numMipMaps;
-		uint16_t width, height;
-
-		// Texture Format
-		txtrFile.read(reinterpret_cast<char *>(&txFormat), sizeof(txFormat));
-		txFormat = _byteswap_ulong(txFormat);
-		if (txFormat != 0xA) {
-			std::cout << "Unsupported Texture Format: 0x" << std::hex << txFormat << std::dec << std::endl;
-			return;
-		}
+	return convertTXTRtoDDS(textureId, txtrFile.span(), textureDir, log);
+}
 
-		// Width and Height
-		txtrFile.read(reinterpret_cast<char *>(&width), sizeof(width));
-		width = _byteswap_ushort(width);
-		txtrFile.read(reinterpret_cast<char *>(&height), sizeof(height));
-		height = _byteswap_ushort(height);
-
-		// Number of MipMaps
-		txtrFile.read(reinterpret_cast<char *>(&numMipMaps), sizeof(numMipMaps));
-		numMipMaps = _byteswap_ulong(numMipMaps);
-
-		// Write the File
-		std::ofstream ddsFile(textureDir + "dds/" + fileId + ".dds", std::ofstream::binary);
-
-		// First the header [https://msdn.microsoft.com/en-us/library/windows/desktop/bb943982(v=vs.85).aspx]. 
-		// This is fugly.. maybe revise this later...
-		uint32_t number = 0x20534444;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = 0x7C;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = 0x021007;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = height;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = width;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = (height * width / 2);
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = 0;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = numMipMaps;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		for (int i = 0; i < 11; i++) {
-			number = 0;
-			ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		}
-		number = 0x20;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = 0x4;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		number = 0x31545844;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		for (int i = 0; i < 5; i++) {
-			number = 0;
-			ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		}
-		number = 0x401000;
-		ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		for (int i = 0; i < 4; i++) {
-			number = 0;
-			ddsFile.write(reinterpret_cast<const char *>(&number), sizeof(uint32_t));
-		}
+bool Material::convertTXTRtoDDS(uint64_t textureId, const ByteSpan &txtrData, const std::string &textureDir, std::ostream &log)
+{
+	char fileId[17];
+	sprintf_s(fileId, sizeof(fileId), "%016llx", static_cast<unsigned long long>(textureId));
+	SpanReader txtrHeader(txtrData);
+	bool truncated = false;
+
+	// Texture Format
+	uint32_t txFormat = txtrHeader.readU32();
+	if (txFormat != 0xA) {
+		log << "Unsupported Texture Format: 0x" << std::hex << txFormat << std::dec << std::endl;
+		return false;
+	}
 
-		// Make sure we are at the end of the header..
-		txtrFile.seekg(0xC, txtrFile.beg);
-		int buffersize = (width * height) / 2;
-		int mipMapSize = 1;
-		for (unsigned int i = 0; i < numMipMaps; i++) {
-			std::vector<uint8_t> TXTRByteArray;
-			for (int byteCount = 0; byteCount < (buffersize / std::pow(mipMapSize, 2)); byteCount++) {
-				uint8_t readByte;
-				txtrFile.read(reinterpret_cast<char *>(&readByte), sizeof(readByte));
-				TXTRByteArray.push_back(readByte);
-			}
-			int mipWidth = width / mipMapSize;
-			int mipHeight = height / mipMapSize;
-			this->uncompressBytesAndWrite(TXTRByteArray, mipWidth, mipHeight, ddsFile);
-			mipMapSize *= 2;
-		}
+	// Width and Height
+	uint16_t width = txtrHeader.readU16();
+	uint16_t height = txtrHeader.readU16();
+
+	// Number of MipMaps. There can't be more than the halvings down to 1x1.
+	uint32_t numMipMaps = txtrHeader.readU32();
+	uint32_t maxMipMaps = 1;
+	while (((width | height) >> maxMipMaps) != 0) maxMipMaps++;
+	if (numMipMaps > maxMipMaps) numMipMaps = maxMipMaps;
+
+	// Write the File
+	std::string ddsFileName = textureDir + "dds/" + fileId + ".dds";
+	std::ofstream ddsFile(ddsFileName, std::ofstream::binary);
+	if (!ddsFile.is_open()) {
+		log << "Opening DDS File failed: " << ddsFileName << std::endl;
+		return false;
+	}
 
-		ddsFile.close();
+	writeDdsHeader(ddsFile, width, height, numMipMaps);
+
+	// The mips follow the 0xC byte header. GX pads every mip to whole 8x8 texel tiles (2x2 blocks).
+	size_t sourceOffset = 0xC;
+	// Mip 0 is the biggest, the smaller ones reuse its buffer.
+	std::vector<uint8_t> ddsMip;
+	ddsMip.reserve(static_cast<size_t>((std::max(static_cast<int>(width), 1) + 3) / 4) * ((std::max(static_cast<int>(height), 1) + 3) / 4) * 8);
+	std::vector<uint8_t> paddedSource;
+	for (unsigned int i = 0; i < numMipMaps; i++) {
+		int blocksWide = (std::max((width >> i), 1) + 3) / 4;
+		int blocksHigh = (std::max((height >> i), 1) + 3) / 4;
+		size_t sourceSize = static_cast<size_t>((blocksWide + 1) / 2) * ((blocksHigh + 1) / 2) * 32;
+
+		const uint8_t *source;
+		if (sourceOffset + sourceSize <= txtrData.size()) {
+			source = txtrData.data() + sourceOffset;
+		}
+		else { // Truncated, the missing part is black
+			paddedSource.assign(sourceSize, 0);
+			if (sourceOffset < txtrData.size()) memcpy(paddedSource.data(), txtrData.data() + sourceOffset, txtrData.size() - sourceOffset);
+			source = paddedSource.data();
+			truncated = true;
+		}
 
+		ddsMip.resize(static_cast<size_t>(blocksWide) * blocksHigh * 8);
+		detileCmprMip(source, blocksWide, blocksHigh, ddsMip.data());
+		ddsFile.write(reinterpret_cast<const char *>(ddsMip.data()), ddsMip.size());
+		sourceOffset += sourceSize;
 	}
-	else {
-		char errBuff[256];
-		strerror_s(errBuff, 100, errno);
-		std::cout << "Opening TXTR File failed. Error: " << errBuff << std::endl;
-		return;
+
+	ddsFile.close();
+	if (ddsFile.fail()) {
+		log << "Writing DDS File failed: " << ddsFileName << std::endl;
+		return false;
 	}
+	if (truncated) log << "Warning: TXTR file is truncated" << std::endl;
+	log << "Texture Conversion successful!" << std::endl;
+	return true;
+}
 
-	std::cout << "Texture Conversion successful!" << std::endl;
-	txtrFile.close();
+void Material::writeDdsHeader(std::ostream &file, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+	// [https://msdn.microsoft.com/en-us/library/windows/desktop/bb943982(v=vs.85).aspx]
+	const uint32_t ddsHeader[32] = {
+		0x20534444, 0x7C, 0x021007, height, width, height * width / 2, 0, mipCount,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0x20, 0x4, 0x31545844, 0, 0, 0, 0, 0,
+		0x401000, 0, 0, 0, 0
+	};
+	file.write(reinterpret_cast<const char *>(ddsHeader), sizeof(ddsHeader));
 }
 
-void Material::setTextureId(uint64_t textureId)
+std::string Material::fourCCToString(uint32_t fourCC)
 {
-	this->textureId = textureId;
+	std::string text;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		char c = static_cast<char>((fourCC >> shift) & 0xFF);
+		text += (c >= 0x20 && c < 0x7F) ? c : '?';
+	}
+	return text;
 }
 
 uint64_t Material::getTextureId() const
 {
+	for (size_t i = 0; i < this->passes.size(); i++) {
+		if (this->passes[i].type == DiffusePass && this->passes[i].textureId != 0) return this->passes[i].textureId;
+	}
+	for (size_t i = 0; i < this->passes.size(); i++) {
+		if (this->passes[i].textureId != 0) return this->passes[i].textureId;
+	}
 	return this->textureId;
 }
 
 void Material::setVertexAttributeFlags(uint32_t flags)
 {
 	this->vertexAttributeFlags = flags;
+	this->vertexFormat = VertexFormat::fromAttributeFlags(flags);
 }
 
 uint32_t Material::getVertexAttributeFlags() const
@@ -146,137 +174,100 @@ uint32_t Material::getVertexAttributeFlags() const
 	return this->vertexAttributeFlags;
 }
 
-std::string Material::getMaterialName() const
+const VertexFormat &Material::getVertexFormat() const
 {
-	return this->materialName;
+	return this->vertexFormat;
 }
 
-std::string Material::getMaterialDefinition() const
+const std::string &Material::getMaterialName() const
 {
-	return this->materialDefinition.str();
+	return this->materialName;
 }
 
-// Thanks to Thakis and Parax
-void Material::uncompressBytesAndWrite(std::vector<uint8_t> &byteArray, int width, int height, std::ofstream &outFile)
+void Material::setMaterialName(const std::string &name)
 {
-	std::vector<uint8_t> outByteArray(byteArray.size());
-
-	int s = 0;
-	int y = 0;
-	int height_offset = height / 4;
-	int width_offset = width / 4;
-
-	while (y < height_offset) {
-		int x = 0;
-
-		while (x < width_offset) {
-			int dy = 0;
-
-			while (dy < 2) {
-				int dx = 0;
-				
-				while (dx < 2) {
-					for (int byteCount = 0; byteCount < 8; byteCount++) {
-						int arrayIndex = 8 * (((y + dy) * width_offset) + x + dx) + byteCount;
-						outByteArray[arrayIndex] = byteArray[s + byteCount];
-					}
-					s += 8;
-					dx += 1;
-				}
-				dy += 1;
-			}
-			x += 2;
-		}
-		y += 2;
-	}
+	this->materialName = name;
+}
 
-	for (unsigned int byteCount = 0; byteCount < (outByteArray.size() / 8); byteCount++) {
-
-		int chunknum = 8 * byteCount; // index at 0
-
-		uint8_t b1 = outByteArray[chunknum];
-		uint8_t b2 = outByteArray[chunknum + 1];
-		uint8_t b3 = outByteArray[chunknum + 2];
-		uint8_t b4 = outByteArray[chunknum + 3];
-		uint8_t b5 = outByteArray[chunknum + 4];
-		uint8_t b6 = outByteArray[chunknum + 5];
-		uint8_t b7 = outByteArray[chunknum + 6];
-		uint8_t b8 = outByteArray[chunknum + 7];
-
-		uint8_t number;
-		number = b2;
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		number = b1;
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		number = b4;
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		number = b3;
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		//number = this->reverseBits(b5);
-		number = this->swapBits(b5);
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		//number = this->reverseBits(b6);
-		number = this->swapBits(b6);
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		//number = this->reverseBits(b7);
-		number = this->swapBits(b7);
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-		//number = this->reverseBits(b8);
-		number = this->swapBits(b8);
-		outFile.write(reinterpret_cast<const char *>(&number), sizeof(uint8_t));
-	}
+void Material::addPass(const MaterialPass &pass)
+{
+	this->passes.push_back(pass);
 }
 
-unsigned char Material::reverseBits(unsigned char b)
+void Material::addColor(const MaterialColor &color)
 {
-	b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-	b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-	b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-	return b;
+	this->colors.push_back(color);
 }
 
-unsigned char Material::swapBits(unsigned char b)
+void Material::addInt(const MaterialInt &value)
 {
-	unsigned char b1 = b & 0x3;
-	unsigned char b2 = b & 0xC;
-	unsigned char b3 = b & 0x30;
-	unsigned char b4 = b & 0xC0;
-	b = (b1 << 6) + (b2 << 2) + (b3 >> 2) + (b4 >> 6);
-	return b;
+	this->ints.push_back(value);
 }
 
-std::string Pass::parseSection(Material &material, char* buffer, int size)
+void Material::setPassTexture(size_t passIndex, uint64_t textureId)
 {
-	uint64_t textureFileId;
-	memcpy(&textureFileId, buffer + 8, 8);
-	textureFileId = _byteswap_uint64(textureFileId);
-	std::cout << "Texture File ID: " << std::hex << textureFileId << std::dec << std::endl;
+	this->passes[passIndex].textureId = textureId;
+}
 
-	material.setTextureId(textureFileId);
-	// Convert the Texture to DDS
-	material.convertTXTRtoDDS("Textures/"); // With trailing slash /
+const ArenaVector<MaterialPass> &Material::getPasses() const
+{
+	return this->passes;
+}
 
-	std::stringstream passSection;
-	passSection << "Kd 1.000 1.000 1.000" << std::endl;
-	passSection << "map_Kd " << std::hex << textureFileId << ".dds" << std::endl;
+const ArenaVector<MaterialColor> &Material::getColors() const
+{
+	return this->colors;
+}
 
-	return passSection.str();
+const ArenaVector<MaterialInt> &Material::getInts() const
+{
+	return this->ints;
 }
 
-std::string SectionType::parseSection(Material &material, char* buffer, int size)
+bool Material::findColor(uint32_t type, uint32_t &rgba) const
 {
-	std::cout << "Default parse. SHOULD NEVER HAPPEN!" << std::endl;
-	exit(-1);
+	for (size_t i = 0; i < this->colors.size(); i++) {
+		if (this->colors[i].type == type) {
+			rgba = this->colors[i].rgba;
+			return true;
+		}
+	}
+	return false;
 }
 
-std::string Clr::parseSection(Material &material, char* buffer, int size)
+bool Material::findInt(uint32_t type, uint32_t &value) const
 {
-	std::cout << "CLR not implemented" << std::endl;
-	return "";
+	for (size_t i = 0; i < this->ints.size(); i++) {
+		if (this->ints[i].type == type) {
+			value = this->ints[i].value;
+			return true;
+		}
+	}
+	return false;
 }
 
-std::string Int::parseSection(Material &material, char* buffer, int size)
+// Thanks to Thakis and Parax
+void Material::detileCmprMip(const uint8_t *source, int blocksWide, int blocksHigh, uint8_t *out)
 {
-	std::cout << "INT not implemented" << std::endl;
-	return "";
+	for (int y = 0; y < blocksHigh; y += 2) {
+		for (int x = 0; x < blocksWide; x += 2) {
+			for (int dy = 0; dy < 2; dy++) {
+				for (int dx = 0; dx < 2; dx++, source += 8) {
+					if (y + dy >= blocksHigh || x + dx >= blocksWide) continue; // Padding of a mip smaller than a tile
+
+					// Both 16-bit color endpoints to little-endian, every index byte through the table.
+					// The host is little-endian, so the bytes of block are in memory order.
+					uint64_t block;
+					memcpy(&block, source, 8);
+					uint64_t colors = ((block & 0x00FF00FF) << 8) | ((block >> 8) & 0x00FF00FF);
+					uint64_t indices = static_cast<uint64_t>(swapBitsTable[(block >> 32) & 0xFF])
+						| (static_cast<uint64_t>(swapBitsTable[(block >> 40) & 0xFF]) << 8)
+						| (static_cast<uint64_t>(swapBitsTable[(block >> 48) & 0xFF]) << 16)
+						| (static_cast<uint64_t>(swapBitsTable[(block >> 56) & 0xFF]) << 24);
+					block = colors | (indices << 32);
+					memcpy(out + 8 * ((y + dy) * blocksWide + x + dx), &block, 8);
+				}
+			}
+		}
+	}
 }
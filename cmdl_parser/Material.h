@@ -9,65 +9,91 @@
 #include <vector>
 #include <memory>
 
+#include "VertexFormat.h"
+#include "MappedFile.h"
+#include "Arena.h"
+
+// A PASS section: one texture of the material and how it is applied.
+struct MaterialPass
+{
+	uint32_t type;				// FourCC: DIFF (diffuse), RIML, BLOL, CLR, TRAN, INCA, RFLV, ...
+	uint32_t flags;
+	uint64_t textureId;			// 0 if the pass has no texture
+	uint32_t uvSource;			// UV set the texture is mapped with
+	uint32_t uvAnimationSize;	// Bytes of UV animation behind the pass. The animation isn't decoded.
+};
+
+// A CLR section
+struct MaterialColor
+{
+	uint32_t type;	// FourCC, e.g. DIFB
+	uint32_t rgba;	// Red in the top byte
+};
+
+// An INT section
+struct MaterialInt
+{
+	uint32_t type;	// FourCC, e.g. OPAC
+	uint32_t value;
+};
+
+// A material of a CMDL file: the vertex attribute flags and the PASS, CLR and INT sections in file order.
 class Material
 {
 public:
-	Material(const std::string materialName);
+	// FourCCs of the material sections
+	static const uint32_t PassSection = 0x50415353;		// PASS
+	static const uint32_t ColorSection = 0x434C5220;	// CLR
+	static const uint32_t IntSection = 0x494E5420;		// INT
+	// FourCCs of the pass, color and int types the writers understand
+	static const uint32_t DiffusePass = 0x44494646;		// DIFF
+	static const uint32_t DiffuseColor = 0x44494642;	// DIFB
+	static const uint32_t Opacity = 0x4F504143;			// OPAC, 0 to 255
+
+	// With an arena the passes, colors and ints are allocated from it. Copies of the material are not.
+	Material(const std::string materialName, Arena *arena = nullptr);
 	Material(uint32_t vertexAttributeFlags, uint64_t textureId);
 	virtual ~Material();
 
-	void convertTXTRtoDDS(const std::string &textureDir = "");
-	void setTextureId(uint64_t textureId);
+	// Converts textureDir/<id>.TXTR to textureDir/dds/<id>.dds. textureDir needs a trailing slash.
+	static bool convertTXTRtoDDS(uint64_t textureId, const std::string &textureDir, std::ostream &log);
+	// Converts the TXTR file in txtrData, e.g. from an archive, to textureDir/dds/<id>.dds.
+	static bool convertTXTRtoDDS(uint64_t textureId, const ByteSpan &txtrData, const std::string &textureDir, std::ostream &log);
+	// Writes the header of a DXT1 DDS file.
+	static void writeDdsHeader(std::ostream &file, uint32_t width, uint32_t height, uint32_t mipCount);
+	// The four characters, e.g. "DIFF". Trailing spaces are kept.
+	static std::string fourCCToString(uint32_t fourCC);
+	// The texture of the diffuse pass or, without one, of the first pass with a texture. 0 if there is none.
 	uint64_t getTextureId() const;
 	void setVertexAttributeFlags(uint32_t flags);
 	uint32_t getVertexAttributeFlags() const;
-	std::string getMaterialName() const;
-	std::string getMaterialDefinition() const;
+	// The primitive vertex layout described by the flags
+	const VertexFormat &getVertexFormat() const;
+	const std::string &getMaterialName() const;
+	void setMaterialName(const std::string &name);
 
-	template <typename T>
-	void addMaterialSection(Material &material, char* buffer, int size);
+	void addPass(const MaterialPass &pass);
+	void addColor(const MaterialColor &color);
+	void addInt(const MaterialInt &value);
+	void setPassTexture(size_t passIndex, uint64_t textureId);
+	const ArenaVector<MaterialPass> &getPasses() const;
+	const ArenaVector<MaterialColor> &getColors() const;
+	const ArenaVector<MaterialInt> &getInts() const;
+	// The first color or int of the type. Returns false if the material has none.
+	bool findColor(uint32_t type, uint32_t &rgba) const;
+	bool findInt(uint32_t type, uint32_t &value) const;
 
 private:
-	void uncompressBytesAndWrite(std::vector<uint8_t> &byteArray, int width, int height, std::ofstream &outFile);
-	unsigned char reverseBits(unsigned char b);
-	unsigned char swapBits(unsigned char b);
+	// Converts one mip from GX CMPR (8x8 texel tiles of 2x2 big-endian DXT1 blocks) to the linear block order of DDS.
+	static void detileCmprMip(const uint8_t *source, int blocksWide, int blocksHigh, uint8_t *out);
 
 private:
 	uint32_t vertexAttributeFlags;
+	VertexFormat vertexFormat;
 	uint64_t textureId;
 	std::string materialName;
-	std::stringstream materialDefinition;
-
-};
-
-template <typename T>
-void Material::addMaterialSection(Material &material, char* buffer, int size)
-{
-	T sectionObj = T();
-	this->materialDefinition << sectionObj.parseSection(material, buffer, size);
-}
-
-class SectionType
-{
-public:
-	virtual std::string parseSection(Material &material, char* buffer, int size);
-};
-
-class Pass : public SectionType
-{
-public:
-	std::string parseSection(Material &material, char* buffer, int size);
-};
-
-class Clr : public SectionType
-{
-public:
-	std::string parseSection(Material &material, char* buffer, int size);
-};
-
-class Int : public SectionType
-{
-public:
-	std::string parseSection(Material &material, char* buffer, int size);
+	ArenaVector<MaterialPass> passes;
+	ArenaVector<MaterialColor> colors;
+	ArenaVector<MaterialInt> ints;
 };
 
@@ -0,0 +1,116 @@
+#include "MaterialLibrary.h"
+#include "ObjWriter.h"
+#include "ConversionCache.h"
+
+#include <fstream>
+
+
+static void appendBytes(std::string &key, const void *data, size_t size)
+{
+	key.append(static_cast<const char *>(data), size);
+}
+
+
+MaterialLibrary::MaterialLibrary(const std::string &fileName)
+	: fileName(fileName), addedCount(0)
+{
+}
+
+std::string MaterialLibrary::add(const Material &material)
+{
+	std::string key = getContentKey(material);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->addedCount++;
+	std::unordered_map<std::string, std::string>::const_iterator known = this->names.find(key);
+	if (known != this->names.end()) return known->second;
+
+	char text[24];
+	sprintf_s(text, sizeof(text), "m%016llx", static_cast<unsigned long long>(ConversionCache::hashBytes(key.data(), key.length())));
+	std::string name = text;
+	// Two different materials with the same hash get numbered
+	for (unsigned int suffix = 1; this->materials.count(name) != 0; suffix++) {
+		name = std::string(text) + "_" + std::to_string(suffix);
+	}
+
+	Material &shared = this->materials.insert(std::make_pair(name, material)).first->second;
+	shared.setMaterialName(name);
+	this->names.insert(std::make_pair(key, name));
+	return name;
+}
+
+const std::string &MaterialLibrary::getFileName() const
+{
+	return this->fileName;
+}
+
+uint64_t MaterialLibrary::getAddedCount() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->addedCount;
+}
+
+size_t MaterialLibrary::getMaterialCount() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->materials.size();
+}
+
+bool MaterialLibrary::write(const std::string &outputDir, std::ostream &log) const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::ofstream materialFile(outputDir + this->fileName);
+	if (!materialFile.is_open()) {
+		log << "Failed to create " << outputDir << this->fileName << std::endl;
+		return false;
+	}
+	for (std::map<std::string, Material>::const_iterator material = this->materials.begin(); material != this->materials.end(); ++material) {
+		ObjWriter::writeMaterial(materialFile, material->second);
+	}
+	materialFile.close();
+	if (materialFile.fail()) {
+		log << "Failed to write " << outputDir << this->fileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Everything but the name, field by field
+std::string MaterialLibrary::getContentKey(const Material &material)
+{
+	std::string key;
+	uint32_t flags = material.getVertexAttributeFlags();
+	appendBytes(key, &flags, sizeof(flags));
+
+	const ArenaVector<MaterialPass> &passes = material.getPasses();
+	uint32_t count = static_cast<uint32_t>(passes.size());
+	appendBytes(key, &count, sizeof(count));
+	for (size_t i = 0; i < passes.size(); i++) {
+		appendBytes(key, &passes[i].type, sizeof(passes[i].type));
+		appendBytes(key, &passes[i].flags, sizeof(passes[i].flags));
+		appendBytes(key, &passes[i].textureId, sizeof(passes[i].textureId));
+		appendBytes(key, &passes[i].uvSource, sizeof(passes[i].uvSource));
+		appendBytes(key, &passes[i].uvAnimationSize, sizeof(passes[i].uvAnimationSize));
+	}
+
+	const ArenaVector<MaterialColor> &colors = material.getColors();
+	count = static_cast<uint32_t>(colors.size());
+	appendBytes(key, &count, sizeof(count));
+	for (size_t i = 0; i < colors.size(); i++) {
+		appendBytes(key, &colors[i].type, sizeof(colors[i].type));
+		appendBytes(key, &colors[i].rgba, sizeof(colors[i].rgba));
+	}
+
+	const ArenaVector<MaterialInt> &ints = material.getInts();
+	count = static_cast<uint32_t>(ints.size());
+	appendBytes(key, &count, sizeof(count));
+	for (size_t i = 0; i < ints.size(); i++) {
+		appendBytes(key, &ints[i].type, sizeof(ints[i].type));
+		appendBytes(key, &ints[i].value, sizeof(ints[i].value));
+	}
+
+	// A material without passes falls back to the texture it was made with
+	uint64_t textureId = material.getTextureId();
+	appendBytes(key, &textureId, sizeof(textureId));
+	return key;
+}
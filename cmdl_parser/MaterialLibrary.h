@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <mutex>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "Material.h"
+
+// One MTL file for a whole batch (-sharedmtl). Materials with the same vertex attribute flags, passes, colors and
+// ints are the same material, whichever file they come from. Every distinct material gets a name made from a hash of
+// its content, so the names don't depend on the order in which the files were converted.
+// add() can be called from any number of threads.
+class MaterialLibrary
+{
+public:
+	// fileName is the name of the MTL file in the output directory.
+	explicit MaterialLibrary(const std::string &fileName);
+
+	// Returns the shared name of the material.
+	std::string add(const Material &material);
+	const std::string &getFileName() const;
+	// Materials added and distinct ones among them
+	uint64_t getAddedCount() const;
+	size_t getMaterialCount() const;
+
+	// Writes the distinct materials, sorted by name.
+	bool write(const std::string &outputDir, std::ostream &log) const;
+
+private:
+	MaterialLibrary(const MaterialLibrary &) = delete;
+	MaterialLibrary &operator=(const MaterialLibrary &) = delete;
+
+	static std::string getContentKey(const Material &material);
+
+private:
+	std::string fileName;
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, std::string> names;	// Content key -> name
+	std::map<std::string, Material> materials;	// Name -> material
+	uint64_t addedCount;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "Material.h"
+#include "Arena.h"
+
+struct float3 {
+	float x;
+	float y;
+	float z;
+};
+
+struct float2 {
+	float u;
+	float v;
+};
+
+struct IndexTriplet {
+	unsigned short pos;
+	unsigned short norm;
+	unsigned short tex;
+};
+
+struct Vertex {
+	float3 position;
+	float3 normal;
+	float2 uv;
+};
+
+// Decoded vertex attributes with one array per component (structure of arrays).
+struct AttributeArray3
+{
+	ArenaVector<float> x;
+	ArenaVector<float> y;
+	ArenaVector<float> z;
+
+	explicit AttributeArray3(Arena *arena = nullptr) : x(ArenaAllocator<float>(arena)), y(ArenaAllocator<float>(arena)), z(ArenaAllocator<float>(arena)) {}
+
+	size_t size() const { return this->x.size(); }
+	void resize(size_t count) { this->x.resize(count); this->y.resize(count); this->z.resize(count); }
+	void release() { releaseArenaMemory(this->x); releaseArenaMemory(this->y); releaseArenaMemory(this->z); }
+};
+
+struct AttributeArray2
+{
+	ArenaVector<float> u;
+	ArenaVector<float> v;
+
+	explicit AttributeArray2(Arena *arena = nullptr) : u(ArenaAllocator<float>(arena)), v(ArenaAllocator<float>(arena)) {}
+
+	size_t size() const { return this->u.size(); }
+	void resize(size_t count) { this->u.resize(count); this->v.resize(count); }
+	void release() { releaseArenaMemory(this->u); releaseArenaMemory(this->v); }
+};
+
+// One submesh section decoded to a plain triangle list. Strips and fans are already triangulated, unless the strips
+// were kept (PrimitiveDecoder::KeepStrips).
+struct Submesh
+{
+	static const uint16_t NoVisibilityGroup = 0xFFFF;
+
+	uint32_t sectionIndex;	// CMDL section the submesh was read from
+	uint16_t materialIndex;	// Index into Mesh::materials
+	uint16_t visibilityGroup;	// Index into Mesh::visibilityGroups, NoVisibilityGroup if the submesh isn't in one
+	float3 boundingBox[2];	// Min and max of the positions the submesh uses (VertexDecoder::computeBounds())
+	bool hasNormals;
+	bool hasUvs;
+	ArenaVector<IndexTriplet> indices; // 3 corners per triangle, indices are 0-based
+	// Kept strips: the corners of all strips back to back and the number of corners of each strip
+	ArenaVector<IndexTriplet> stripCorners;
+	ArenaVector<uint32_t> stripLengths;
+
+	// Number of primitives the triangles were built from
+	uint32_t triangleListCount;
+	uint32_t stripCount;
+	uint32_t fanCount;
+
+	explicit Submesh(Arena *arena = nullptr) : sectionIndex(0), materialIndex(0), visibilityGroup(NoVisibilityGroup), hasNormals(false), hasUvs(false), indices(ArenaAllocator<IndexTriplet>(arena)),
+		stripCorners(ArenaAllocator<IndexTriplet>(arena)), stripLengths(ArenaAllocator<uint32_t>(arena)), triangleListCount(0), stripCount(0), fanCount(0)
+	{
+		this->boundingBox[0].x = this->boundingBox[0].y = this->boundingBox[0].z = 0.0f;
+		this->boundingBox[1] = this->boundingBox[0];
+	}
+
+	size_t triangleCount() const { return this->indices.size() / 3 + this->stripCorners.size() - 2 * this->stripLengths.size(); }
+};
+
+// A completely decoded CMDL model. It is filled by CmdlParser and only read by the writers,
+// so one parse can be written to any number of output formats.
+// With an arena the arrays, the materials and the submeshes the parser makes are allocated from it. clear() has to
+// be called before the arena is reset.
+struct Mesh
+{
+	uint32_t flags; // CMDL header flags
+	float3 boundingBox[2]; // Min and max from the CMDL header
+	AttributeArray3 positions;
+	AttributeArray3 normals;
+	AttributeArray2 uvs;
+	ArenaVector<ArenaPtr<Material> > materials;
+	ArenaVector<Submesh> submeshes;
+	ArenaVector<ArenaString> visibilityGroups; // Names, if the CMDL header has them (flags & 0x10)
+
+	explicit Mesh(Arena *arena = nullptr) : flags(0), positions(arena), normals(arena), uvs(arena),
+		materials(ArenaAllocator<ArenaPtr<Material> >(arena)), submeshes(ArenaAllocator<Submesh>(arena)), visibilityGroups(ArenaAllocator<ArenaString>(arena)), arena(arena)
+	{
+		this->boundingBox[0].x = this->boundingBox[0].y = this->boundingBox[0].z = 0.0f;
+		this->boundingBox[1] = this->boundingBox[0];
+	}
+
+	Arena *getArena() const { return this->arena; }
+	// Appends empty submeshes that allocate from the arena of the mesh, or removes submeshes from the end.
+	void resizeSubmeshes(size_t count)
+	{
+		if (count <= this->submeshes.size()) {
+			this->submeshes.resize(count);
+			return;
+		}
+		this->submeshes.reserve(count);
+		while (this->submeshes.size() < count) this->submeshes.emplace_back(this->arena);
+	}
+	// Destroys everything and lets go of the memory
+	void clear()
+	{
+		this->positions.release();
+		this->normals.release();
+		this->uvs.release();
+		releaseArenaMemory(this->materials);
+		releaseArenaMemory(this->submeshes);
+		releaseArenaMemory(this->visibilityGroups);
+	}
+
+private:
+	Mesh(const Mesh &) = delete;
+	Mesh &operator=(const Mesh &) = delete;
+
+	Arena *arena;
+};
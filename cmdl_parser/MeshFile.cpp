@@ -0,0 +1,519 @@
+#include "MeshFile.h"
+#include "VertexDecoder.h"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+
+static const char MeshFileMagic[4] = { 'C', 'M', 'S', 'H' };
+
+// Appends the bytes at the next aligned offset and returns that offset.
+static uint64_t appendArray(ArenaVector<uint8_t> &file, const void *data, size_t size)
+{
+	file.resize((file.size() + MeshFile::Alignment - 1) / MeshFile::Alignment * MeshFile::Alignment, 0);
+	uint64_t offset = file.size();
+	if (size > 0) {
+		file.resize(file.size() + size);
+		memcpy(file.data() + offset, data, size);
+	}
+	return offset;
+}
+
+static void copyBoundingBox(float destination[6], const float3 boundingBox[2])
+{
+	destination[0] = boundingBox[0].x;
+	destination[1] = boundingBox[0].y;
+	destination[2] = boundingBox[0].z;
+	destination[3] = boundingBox[1].x;
+	destination[4] = boundingBox[1].y;
+	destination[5] = boundingBox[1].z;
+}
+
+// slack is how far the point may lie outside of the box
+static bool isInside(const float boundingBox[6], const float point[3], float slack)
+{
+	for (int k = 0; k < 3; k++) {
+		if (point[k] < boundingBox[k] - slack || point[k] > boundingBox[k + 3] + slack) return false;
+	}
+	return true;
+}
+
+// A scale per component and no bias
+static void setDequantization(MeshFileDequantization &dequantization, float scaleX, float scaleY, float scaleZ)
+{
+	dequantization.scale[0] = scaleX;
+	dequantization.scale[1] = scaleY;
+	dequantization.scale[2] = scaleZ;
+	dequantization.bias[0] = dequantization.bias[1] = dequantization.bias[2] = 0.0f;
+}
+
+
+bool MeshFile::write(const std::string &fileName, const Mesh &mesh, bool quantize, const Bvh *bvh, std::ostream &log)
+{
+	// Float positions stay floats, quantizing them would lose precision.
+	bool quantizePositions = quantize && (mesh.flags & 0x20) == 0x20;
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MeshFileMagic, sizeof(header.magic));
+	header.version = Version;
+	header.flags = mesh.flags;
+	copyBoundingBox(header.boundingBox, mesh.boundingBox);
+	header.positionCount = static_cast<uint32_t>(mesh.positions.size());
+	header.normalCount = static_cast<uint32_t>(mesh.normals.size());
+	header.uvCount = static_cast<uint32_t>(mesh.uvs.size());
+	header.submeshCount = static_cast<uint32_t>(mesh.submeshes.size());
+	header.materialCount = static_cast<uint32_t>(mesh.materials.size());
+	header.quantized = (quantizePositions ? QuantizedPositions : 0) | (quantize ? QuantizedNormals | QuantizedUvs : 0);
+	float positionScale = quantizePositions ? 1.0f / VertexDecoder::PositionDivisor : 1.0f;
+	float normalScale = quantize ? 1.0f / VertexDecoder::NormalDivisor : 1.0f;
+	float uvScale = quantize ? 1.0f / VertexDecoder::UvDivisor : 1.0f;
+	setDequantization(header.positionDequantization, positionScale, positionScale, positionScale);
+	setDequantization(header.normalDequantization, normalScale, normalScale, normalScale);
+	setDequantization(header.uvDequantization, uvScale, quantize ? -uvScale : 1.0f, 1.0f); // v is flipped
+
+	// Everything is built in the arena of the mesh, sized once from the counts.
+	Arena *arena = mesh.getArena();
+	size_t cornerCount = 0, passCount = 0, valueCount = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		cornerCount += mesh.submeshes[s].indices.size();
+	}
+	for (size_t i = 0; i < mesh.materials.size(); i++) {
+		passCount += mesh.materials[i]->getPasses().size();
+		valueCount += mesh.materials[i]->getColors().size() + mesh.materials[i]->getInts().size();
+	}
+	size_t bvhNodeCount = (bvh != nullptr) ? bvh->getNodes().size() : 0;
+	size_t bvhTriangleCount = (bvh != nullptr) ? bvh->getTriangles().size() : 0;
+	size_t attributeSize = std::max(3 * std::max(mesh.positions.size(), mesh.normals.size()), 2 * mesh.uvs.size());
+	ArenaVector<uint8_t> file((ArenaAllocator<uint8_t>(arena)));
+	file.reserve(sizeof(header) + 14 * Alignment + (3 * mesh.positions.size() + 3 * mesh.normals.size() + 2 * mesh.uvs.size()) * sizeof(float)
+		+ 3 * cornerCount * sizeof(uint16_t) + mesh.submeshes.size() * sizeof(MeshFileSubmesh) + mesh.materials.size() * sizeof(MeshFileMaterial)
+		+ passCount * sizeof(MeshFileMaterialPass) + valueCount * sizeof(MeshFileMaterialValue) + bvhNodeCount * sizeof(MeshFileBvhNode) + bvhTriangleCount * sizeof(uint32_t));
+	file.resize(sizeof(header));
+
+	// The attributes are interleaved per element, the way a loader hands them to the GPU.
+	ArenaVector<float> attributes((ArenaAllocator<float>(arena)));
+	ArenaVector<int16_t> quantizedAttributes((ArenaAllocator<int16_t>(arena)));
+	if (quantize) quantizedAttributes.reserve(attributeSize);
+	if (!quantizePositions) attributes.reserve(attributeSize);
+	if (quantizePositions) {
+		quantizedAttributes.resize(3 * mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			quantizedAttributes[3 * i] = VertexDecoder::quantizePosition(mesh.positions.x[i]);
+			quantizedAttributes[3 * i + 1] = VertexDecoder::quantizePosition(mesh.positions.y[i]);
+			quantizedAttributes[3 * i + 2] = VertexDecoder::quantizePosition(mesh.positions.z[i]);
+		}
+		header.positionOffset = appendArray(file, quantizedAttributes.data(), quantizedAttributes.size() * sizeof(int16_t));
+	}
+	else {
+		attributes.resize(3 * mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			attributes[3 * i] = mesh.positions.x[i];
+			attributes[3 * i + 1] = mesh.positions.y[i];
+			attributes[3 * i + 2] = mesh.positions.z[i];
+		}
+		header.positionOffset = appendArray(file, attributes.data(), attributes.size() * sizeof(float));
+	}
+
+	if (quantize) {
+		quantizedAttributes.resize(3 * mesh.normals.size());
+		for (size_t i = 0; i < mesh.normals.size(); i++) {
+			quantizedAttributes[3 * i] = VertexDecoder::quantizeNormal(mesh.normals.x[i]);
+			quantizedAttributes[3 * i + 1] = VertexDecoder::quantizeNormal(mesh.normals.y[i]);
+			quantizedAttributes[3 * i + 2] = VertexDecoder::quantizeNormal(mesh.normals.z[i]);
+		}
+		header.normalOffset = appendArray(file, quantizedAttributes.data(), quantizedAttributes.size() * sizeof(int16_t));
+
+		ArenaVector<uint16_t> quantizedUvs(2 * mesh.uvs.size(), 0, ArenaAllocator<uint16_t>(arena));
+		for (size_t i = 0; i < mesh.uvs.size(); i++) {
+			quantizedUvs[2 * i] = VertexDecoder::quantizeU(mesh.uvs.u[i]);
+			quantizedUvs[2 * i + 1] = VertexDecoder::quantizeV(mesh.uvs.v[i]);
+		}
+		header.uvOffset = appendArray(file, quantizedUvs.data(), quantizedUvs.size() * sizeof(uint16_t));
+	}
+	else {
+		attributes.resize(3 * mesh.normals.size());
+		for (size_t i = 0; i < mesh.normals.size(); i++) {
+			attributes[3 * i] = mesh.normals.x[i];
+			attributes[3 * i + 1] = mesh.normals.y[i];
+			attributes[3 * i + 2] = mesh.normals.z[i];
+		}
+		header.normalOffset = appendArray(file, attributes.data(), attributes.size() * sizeof(float));
+		attributes.resize(2 * mesh.uvs.size());
+		for (size_t i = 0; i < mesh.uvs.size(); i++) {
+			attributes[2 * i] = mesh.uvs.u[i];
+			attributes[2 * i + 1] = mesh.uvs.v[i];
+		}
+		header.uvOffset = appendArray(file, attributes.data(), attributes.size() * sizeof(float));
+	}
+
+	ArenaVector<MeshFileSubmesh> submeshes(mesh.submeshes.size(), MeshFileSubmesh(), ArenaAllocator<MeshFileSubmesh>(arena));
+	ArenaVector<uint16_t> corners((ArenaAllocator<uint16_t>(arena)));
+	corners.reserve(3 * cornerCount);
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const Submesh &submesh = mesh.submeshes[s];
+		submeshes[s].firstCorner = static_cast<uint32_t>(corners.size() / 3);
+		submeshes[s].cornerCount = static_cast<uint32_t>(submesh.indices.size());
+		submeshes[s].materialIndex = submesh.materialIndex;
+		submeshes[s].attributes = static_cast<uint16_t>((submesh.hasNormals ? HasNormals : 0) | (submesh.hasUvs ? HasUvs : 0));
+		submeshes[s].sectionIndex = submesh.sectionIndex;
+		copyBoundingBox(submeshes[s].boundingBox, submesh.boundingBox);
+		for (size_t c = 0; c < submesh.indices.size(); c++) {
+			corners.push_back(submesh.indices[c].pos);
+			corners.push_back(submesh.hasNormals ? submesh.indices[c].norm : 0);
+			corners.push_back(submesh.hasUvs ? submesh.indices[c].tex : 0);
+		}
+	}
+	header.cornerCount = static_cast<uint32_t>(corners.size() / 3);
+	header.cornerOffset = appendArray(file, corners.data(), corners.size() * sizeof(uint16_t));
+	header.submeshOffset = appendArray(file, submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+
+	ArenaVector<MeshFileMaterial> materials(mesh.materials.size(), MeshFileMaterial(), ArenaAllocator<MeshFileMaterial>(arena));
+	ArenaVector<MeshFileMaterialPass> passes((ArenaAllocator<MeshFileMaterialPass>(arena)));
+	ArenaVector<MeshFileMaterialValue> values((ArenaAllocator<MeshFileMaterialValue>(arena)));
+	passes.reserve(passCount);
+	values.reserve(valueCount);
+	for (size_t i = 0; i < mesh.materials.size(); i++) {
+		const Material &material = *mesh.materials[i];
+		materials[i].textureId = material.getTextureId();
+		materials[i].vertexAttributeFlags = material.getVertexAttributeFlags();
+		materials[i].firstPass = static_cast<uint32_t>(passes.size());
+		materials[i].passCount = static_cast<uint32_t>(material.getPasses().size());
+		materials[i].firstValue = static_cast<uint32_t>(values.size());
+		materials[i].valueCount = static_cast<uint32_t>(material.getColors().size() + material.getInts().size());
+		materials[i].reserved = 0;
+
+		for (size_t p = 0; p < material.getPasses().size(); p++) {
+			const MaterialPass &source = material.getPasses()[p];
+			MeshFileMaterialPass pass;
+			pass.textureId = source.textureId;
+			pass.type = source.type;
+			pass.flags = source.flags;
+			pass.uvSource = source.uvSource;
+			pass.uvAnimationSize = source.uvAnimationSize;
+			passes.push_back(pass);
+		}
+		for (size_t c = 0; c < material.getColors().size(); c++) {
+			MeshFileMaterialValue value = { Material::ColorSection, material.getColors()[c].type, material.getColors()[c].rgba };
+			values.push_back(value);
+		}
+		for (size_t n = 0; n < material.getInts().size(); n++) {
+			MeshFileMaterialValue value = { Material::IntSection, material.getInts()[n].type, material.getInts()[n].value };
+			values.push_back(value);
+		}
+	}
+	header.materialOffset = appendArray(file, materials.data(), materials.size() * sizeof(MeshFileMaterial));
+	header.passCount = static_cast<uint32_t>(passes.size());
+	header.passOffset = appendArray(file, passes.data(), passes.size() * sizeof(MeshFileMaterialPass));
+	header.valueCount = static_cast<uint32_t>(values.size());
+	header.valueOffset = appendArray(file, values.data(), values.size() * sizeof(MeshFileMaterialValue));
+
+	ArenaVector<MeshFileBvhNode> bvhNodes(bvhNodeCount, MeshFileBvhNode(), ArenaAllocator<MeshFileBvhNode>(arena));
+	for (size_t i = 0; i < bvhNodes.size(); i++) {
+		const BvhNode &node = bvh->getNodes()[i];
+		copyBoundingBox(bvhNodes[i].boundingBox, node.boundingBox);
+		bvhNodes[i].first = node.first;
+		bvhNodes[i].triangleCount = node.triangleCount;
+	}
+	header.bvhNodeCount = static_cast<uint32_t>(bvhNodes.size());
+	header.bvhNodeOffset = appendArray(file, bvhNodes.data(), bvhNodes.size() * sizeof(MeshFileBvhNode));
+	header.bvhTriangleCount = static_cast<uint32_t>(bvhTriangleCount);
+	header.bvhTriangleOffset = appendArray(file, bvh != nullptr ? bvh->getTriangles().data() : nullptr, header.bvhTriangleCount * sizeof(uint32_t));
+
+	header.fileSize = file.size();
+	memcpy(file.data(), &header, sizeof(header));
+
+	std::ofstream output(fileName, std::ofstream::binary);
+	if (!output.is_open()) {
+		log << "Failed to create " << fileName << std::endl;
+		return false;
+	}
+	output.write(reinterpret_cast<const char *>(file.data()), file.size());
+	output.close();
+	if (output.fail()) {
+		log << "Failed to write " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+MeshFileReader::MeshFileReader()
+	: header(nullptr)
+{
+}
+
+bool MeshFileReader::open(const std::string &fileName)
+{
+	this->close();
+	if (!this->file.open(fileName)) {
+		return this->fail("Failed to open " + fileName);
+	}
+	ByteSpan data = this->file.span();
+	if (data.size() < sizeof(MeshFileHeader) || memcmp(data.data(), MeshFileMagic, sizeof(MeshFileMagic)) != 0) {
+		return this->fail("Not a mesh file");
+	}
+	this->header = reinterpret_cast<const MeshFileHeader *>(data.data());
+	if (this->header->version != MeshFile::Version) {
+		return this->fail("Unsupported version " + std::to_string(this->header->version));
+	}
+	if (this->header->fileSize != data.size()) {
+		return this->fail("The file is truncated");
+	}
+
+	uint32_t quantized = this->header->quantized;
+	return this->checkArray("positions", this->header->positionOffset, this->header->positionCount, 3 * ((quantized & MeshFile::QuantizedPositions) != 0 ? sizeof(int16_t) : sizeof(float)))
+		&& this->checkArray("normals", this->header->normalOffset, this->header->normalCount, 3 * ((quantized & MeshFile::QuantizedNormals) != 0 ? sizeof(int16_t) : sizeof(float)))
+		&& this->checkArray("uvs", this->header->uvOffset, this->header->uvCount, 2 * ((quantized & MeshFile::QuantizedUvs) != 0 ? sizeof(uint16_t) : sizeof(float)))
+		&& this->checkArray("corners", this->header->cornerOffset, this->header->cornerCount, 3 * sizeof(uint16_t))
+		&& this->checkArray("submeshes", this->header->submeshOffset, this->header->submeshCount, sizeof(MeshFileSubmesh))
+		&& this->checkArray("materials", this->header->materialOffset, this->header->materialCount, sizeof(MeshFileMaterial))
+		&& this->checkArray("passes", this->header->passOffset, this->header->passCount, sizeof(MeshFileMaterialPass))
+		&& this->checkArray("values", this->header->valueOffset, this->header->valueCount, sizeof(MeshFileMaterialValue))
+		&& this->checkArray("BVH nodes", this->header->bvhNodeOffset, this->header->bvhNodeCount, sizeof(MeshFileBvhNode))
+		&& this->checkArray("BVH triangles", this->header->bvhTriangleOffset, this->header->bvhTriangleCount, sizeof(uint32_t));
+}
+
+void MeshFileReader::close()
+{
+	this->file.close();
+	this->header = nullptr;
+	this->error.clear();
+}
+
+bool MeshFileReader::validate()
+{
+	if (this->header == nullptr) {
+		return this->fail("No file is open");
+	}
+
+	const MeshFileMaterial *materials = this->getMaterials();
+	for (uint32_t m = 0; m < this->header->materialCount; m++) {
+		const MeshFileMaterial &material = materials[m];
+		std::string name = "Material " + std::to_string(m);
+		if (material.firstPass > this->header->passCount || material.passCount > this->header->passCount - material.firstPass) {
+			return this->fail(name + ": the passes lie outside of the pass array");
+		}
+		if (material.firstValue > this->header->valueCount || material.valueCount > this->header->valueCount - material.firstValue) {
+			return this->fail(name + ": the values lie outside of the value array");
+		}
+	}
+
+	// The boxes are computed on the decoded floats. integer * scale can be one rounding off of integer / divisor.
+	float slack = this->getPositionSlack();
+	const MeshFileSubmesh *submeshes = this->getSubmeshes();
+	const uint16_t *corners = this->getCorners();
+	for (uint32_t s = 0; s < this->header->submeshCount; s++) {
+		const MeshFileSubmesh &submesh = submeshes[s];
+		std::string name = "Submesh " + std::to_string(s);
+		if (submesh.cornerCount % 3 != 0) {
+			return this->fail(name + ": the corner count is not a multiple of 3");
+		}
+		if (submesh.firstCorner > this->header->cornerCount || submesh.cornerCount > this->header->cornerCount - submesh.firstCorner) {
+			return this->fail(name + ": the corners lie outside of the corner array");
+		}
+		if (submesh.materialIndex >= this->header->materialCount) {
+			return this->fail(name + ": material " + std::to_string(submesh.materialIndex) + " doesn't exist");
+		}
+
+		const uint16_t *corner = corners + 3 * static_cast<size_t>(submesh.firstCorner);
+		for (uint32_t c = 0; c < submesh.cornerCount; c++, corner += 3) {
+			if (corner[0] >= this->header->positionCount
+				|| ((submesh.attributes & MeshFile::HasNormals) != 0 && corner[1] >= this->header->normalCount)
+				|| ((submesh.attributes & MeshFile::HasUvs) != 0 && corner[2] >= this->header->uvCount)) {
+				return this->fail(name + ": corner " + std::to_string(c) + " has an index past the end of an attribute array");
+			}
+			float position[3];
+			this->getPosition(corner[0], position);
+			if (!isInside(submesh.boundingBox, position, slack)) {
+				return this->fail(name + ": corner " + std::to_string(c) + " lies outside of the bounding box");
+			}
+		}
+	}
+	return this->validateBvh();
+}
+
+bool MeshFileReader::validateBvh()
+{
+	if (this->header->bvhNodeCount == 0) {
+		if (this->header->bvhTriangleCount != 0) return this->fail("The BVH has triangles but no nodes");
+		return true;
+	}
+	if (this->header->bvhTriangleCount != this->header->cornerCount / 3) {
+		return this->fail("The BVH has " + std::to_string(this->header->bvhTriangleCount) + " triangles, the file " + std::to_string(this->header->cornerCount / 3));
+	}
+
+	// Every node is the child of one node before it, so the hierarchy is a tree, and every triangle is in one leaf.
+	const MeshFileBvhNode *nodes = this->getBvhNodes();
+	const uint32_t *triangles = this->getBvhTriangles();
+	const uint16_t *corners = this->getCorners();
+	float slack = this->getPositionSlack();
+	std::vector<char> reached(this->header->bvhNodeCount, 0);
+	std::vector<char> covered(this->header->bvhTriangleCount, 0);
+	uint64_t coveredCount = 0;
+	reached[0] = 1;
+	for (uint32_t n = 0; n < this->header->bvhNodeCount; n++) {
+		const MeshFileBvhNode &node = nodes[n];
+		std::string name = "BVH node " + std::to_string(n);
+		if (!reached[n]) {
+			return this->fail(name + " isn't the child of any node");
+		}
+
+		if (node.triangleCount == 0) {
+			if (node.first <= n || node.first >= this->header->bvhNodeCount - 1 || reached[node.first] || reached[node.first + 1]) {
+				return this->fail(name + ": the children " + std::to_string(node.first) + " and " + std::to_string(node.first + 1) + " aren't valid");
+			}
+			reached[node.first] = reached[node.first + 1] = 1;
+			for (uint32_t child = node.first; child <= node.first + 1; child++) {
+				if (!isInside(node.boundingBox, nodes[child].boundingBox, 0.0f) || !isInside(node.boundingBox, nodes[child].boundingBox + 3, 0.0f)) {
+					return this->fail(name + ": child " + std::to_string(child) + " lies outside of the bounding box");
+				}
+			}
+			continue;
+		}
+
+		if (node.first > this->header->bvhTriangleCount || node.triangleCount > this->header->bvhTriangleCount - node.first) {
+			return this->fail(name + ": the triangles lie outside of the triangle array");
+		}
+		for (uint32_t i = node.first; i < node.first + node.triangleCount; i++) {
+			uint32_t triangle = triangles[i];
+			if (triangle >= this->header->bvhTriangleCount || covered[triangle]) {
+				return this->fail(name + ": triangle " + std::to_string(triangle) + " doesn't exist or is in several leaves");
+			}
+			covered[triangle] = 1;
+			for (int c = 0; c < 3; c++) {
+				uint16_t index = corners[3 * (3 * static_cast<size_t>(triangle) + c)];
+				if (index >= this->header->positionCount) continue; // validate() reports these
+				float position[3];
+				this->getPosition(index, position);
+				if (!isInside(node.boundingBox, position, slack)) {
+					return this->fail(name + ": triangle " + std::to_string(triangle) + " lies outside of the bounding box");
+				}
+			}
+		}
+		coveredCount += node.triangleCount;
+	}
+	if (coveredCount != this->header->bvhTriangleCount) {
+		return this->fail("The BVH leaves hold " + std::to_string(coveredCount) + " of " + std::to_string(this->header->bvhTriangleCount) + " triangles");
+	}
+	return true;
+}
+
+float MeshFileReader::getPositionSlack() const
+{
+	if ((this->header->quantized & MeshFile::QuantizedPositions) == 0) return 0.0f;
+	const float *scale = this->header->positionDequantization.scale;
+	return std::max(scale[0], std::max(scale[1], scale[2]));
+}
+
+void MeshFileReader::getPosition(uint16_t index, float position[3]) const
+{
+	const MeshFileDequantization &dequantization = this->header->positionDequantization;
+	for (int k = 0; k < 3; k++) {
+		if ((this->header->quantized & MeshFile::QuantizedPositions) != 0) {
+			position[k] = this->getQuantizedPositions()[3 * static_cast<size_t>(index) + k] * dequantization.scale[k] + dequantization.bias[k];
+		}
+		else {
+			position[k] = this->getPositions()[3 * static_cast<size_t>(index) + k];
+		}
+	}
+}
+
+const std::string &MeshFileReader::getError() const
+{
+	return this->error;
+}
+
+bool MeshFileReader::fail(const std::string &reason)
+{
+	this->error = reason;
+	return false;
+}
+
+bool MeshFileReader::checkArray(const char *name, uint64_t offset, uint64_t count, uint64_t elementSize)
+{
+	if (offset % MeshFile::Alignment != 0) {
+		return this->fail(std::string("The ") + name + " are not aligned");
+	}
+	if (offset < sizeof(MeshFileHeader) || offset > this->header->fileSize || count * elementSize > this->header->fileSize - offset) {
+		return this->fail(std::string("The ") + name + " lie outside of the file");
+	}
+	return true;
+}
+
+const uint8_t *MeshFileReader::at(uint64_t offset) const
+{
+	return this->file.span().data() + offset;
+}
+
+const MeshFileHeader &MeshFileReader::getHeader() const
+{
+	return *this->header;
+}
+
+const float *MeshFileReader::getPositions() const
+{
+	return reinterpret_cast<const float *>(this->at(this->header->positionOffset));
+}
+
+const float *MeshFileReader::getNormals() const
+{
+	return reinterpret_cast<const float *>(this->at(this->header->normalOffset));
+}
+
+const float *MeshFileReader::getUvs() const
+{
+	return reinterpret_cast<const float *>(this->at(this->header->uvOffset));
+}
+
+const int16_t *MeshFileReader::getQuantizedPositions() const
+{
+	return reinterpret_cast<const int16_t *>(this->at(this->header->positionOffset));
+}
+
+const int16_t *MeshFileReader::getQuantizedNormals() const
+{
+	return reinterpret_cast<const int16_t *>(this->at(this->header->normalOffset));
+}
+
+const uint16_t *MeshFileReader::getQuantizedUvs() const
+{
+	return reinterpret_cast<const uint16_t *>(this->at(this->header->uvOffset));
+}
+
+const uint16_t *MeshFileReader::getCorners() const
+{
+	return reinterpret_cast<const uint16_t *>(this->at(this->header->cornerOffset));
+}
+
+const MeshFileSubmesh *MeshFileReader::getSubmeshes() const
+{
+	return reinterpret_cast<const MeshFileSubmesh *>(this->at(this->header->submeshOffset));
+}
+
+const MeshFileMaterial *MeshFileReader::getMaterials() const
+{
+	return reinterpret_cast<const MeshFileMaterial *>(this->at(this->header->materialOffset));
+}
+
+const MeshFileMaterialPass *MeshFileReader::getMaterialPasses() const
+{
+	return reinterpret_cast<const MeshFileMaterialPass *>(this->at(this->header->passOffset));
+}
+
+const MeshFileMaterialValue *MeshFileReader::getMaterialValues() const
+{
+	return reinterpret_cast<const MeshFileMaterialValue *>(this->at(this->header->valueOffset));
+}
+
+const MeshFileBvhNode *MeshFileReader::getBvhNodes() const
+{
+	return reinterpret_cast<const MeshFileBvhNode *>(this->at(this->header->bvhNodeOffset));
+}
+
+const uint32_t *MeshFileReader::getBvhTriangles() const
+{
+	return reinterpret_cast<const uint32_t *>(this->at(this->header->bvhTriangleOffset));
+}
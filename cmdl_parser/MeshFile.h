@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Bvh.h"
+
+// Binary mesh file (.cmesh): the decoded Mesh laid out so a loader can map the file and use the arrays in place.
+// Everything is little-endian. The header is followed by these arrays, each at the offset named in the header and
+// aligned to MeshFile::Alignment bytes:
+//   positions	float[3] per position, int16_t[3] if quantized
+//   normals	float[3] per normal, int16_t[3] if quantized
+//   uvs		float[2] per uv, uint16_t[2] if quantized
+//   corners	uint16_t[3] per corner (position, normal and uv index), 3 corners per triangle
+//   submeshes	MeshFileSubmesh, a range of corners each
+//   materials	MeshFileMaterial
+//   passes		MeshFileMaterialPass, the PASS sections of all materials
+//   values		MeshFileMaterialValue, the CLR and INT sections of all materials
+//   bvhNodes	MeshFileBvhNode, only with -bvh
+//   bvhTriangles	uint32_t triangle numbers (corner / 3), every BVH leaf holds a range of them
+// Quantized attributes are the 16-bit integers of the CMDL file. The value of a component is integer * scale + bias,
+// with the scale and bias of the attribute in the header. Float attributes have a scale of 1 and a bias of 0.
+struct MeshFileDequantization
+{
+	float scale[3];
+	float bias[3];
+};
+
+struct MeshFileHeader
+{
+	char magic[4];			// "CMSH"
+	uint32_t version;		// MeshFile::Version
+	uint64_t fileSize;
+	uint32_t flags;			// CMDL header flags
+	float boundingBox[6];	// Min x, y, z and max x, y, z from the CMDL header
+	uint32_t positionCount;
+	uint32_t normalCount;
+	uint32_t uvCount;
+	uint32_t cornerCount;
+	uint32_t submeshCount;
+	uint32_t materialCount;
+	uint32_t quantized;		// MeshFile::QuantizedPositions | MeshFile::QuantizedNormals | MeshFile::QuantizedUvs
+	uint64_t positionOffset;
+	uint64_t normalOffset;
+	uint64_t uvOffset;
+	uint64_t cornerOffset;
+	uint64_t submeshOffset;
+	uint64_t materialOffset;
+	MeshFileDequantization positionDequantization;
+	MeshFileDequantization normalDequantization;
+	MeshFileDequantization uvDequantization;	// The last component is unused
+	uint32_t passCount;
+	uint32_t valueCount;
+	uint64_t passOffset;
+	uint64_t valueOffset;
+	uint32_t bvhNodeCount;	// 0 without a BVH
+	uint32_t bvhTriangleCount;
+	uint64_t bvhNodeOffset;
+	uint64_t bvhTriangleOffset;
+};
+
+struct MeshFileSubmesh
+{
+	uint32_t firstCorner;
+	uint32_t cornerCount;
+	uint16_t materialIndex;
+	uint16_t attributes;	// MeshFile::HasNormals | MeshFile::HasUvs. Absent attributes have index 0 in the corners.
+	uint32_t sectionIndex;	// CMDL section the submesh was read from
+	float boundingBox[6];	// Min x, y, z and max x, y, z of the positions the submesh uses
+};
+
+struct MeshFileMaterial
+{
+	uint64_t textureId;		// Diffuse texture, 0 if the material has no texture
+	uint32_t vertexAttributeFlags;
+	uint32_t firstPass;		// Range of the passes array
+	uint32_t passCount;
+	uint32_t firstValue;	// Range of the values array
+	uint32_t valueCount;
+	uint32_t reserved;
+};
+
+struct MeshFileMaterialPass
+{
+	uint64_t textureId;		// 0 if the pass has no texture
+	uint32_t type;			// FourCC, e.g. DIFF
+	uint32_t flags;
+	uint32_t uvSource;
+	uint32_t uvAnimationSize;
+};
+
+struct MeshFileMaterialValue
+{
+	uint32_t section;		// Material::ColorSection or Material::IntSection
+	uint32_t type;			// FourCC, e.g. DIFB or OPAC
+	uint32_t value;			// RGBA with red in the top byte for colors
+};
+
+// Node 0 is the root. The children of an interior node are at first and first + 1.
+struct MeshFileBvhNode
+{
+	float boundingBox[6];	// Min x, y, z and max x, y, z
+	uint32_t first;			// Left child, or the first entry of bvhTriangles for a leaf
+	uint32_t triangleCount;	// 0 for interior nodes
+};
+
+static_assert(sizeof(MeshFileDequantization) == 24, "The layout of MeshFileDequantization is part of the file format");
+static_assert(sizeof(MeshFileHeader) == 240, "The layout of MeshFileHeader is part of the file format");
+static_assert(sizeof(MeshFileSubmesh) == 40, "The layout of MeshFileSubmesh is part of the file format");
+static_assert(sizeof(MeshFileMaterial) == 32, "The layout of MeshFileMaterial is part of the file format");
+static_assert(sizeof(MeshFileMaterialPass) == 24, "The layout of MeshFileMaterialPass is part of the file format");
+static_assert(sizeof(MeshFileMaterialValue) == 12, "The layout of MeshFileMaterialValue is part of the file format");
+static_assert(sizeof(MeshFileBvhNode) == 32, "The layout of MeshFileBvhNode is part of the file format");
+
+class MeshFile
+{
+public:
+	// Raise this with every change of the layout.
+	static const uint32_t Version = 4;
+	static const uint32_t Alignment = 16;
+
+	enum SubmeshAttributes
+	{
+		HasNormals = 1,
+		HasUvs = 2
+	};
+
+	enum QuantizedAttributes
+	{
+		QuantizedPositions = 1,
+		QuantizedNormals = 2,
+		QuantizedUvs = 4
+	};
+
+	// Kept strips are not written, the file only holds triangles.
+	// With quantize the normals, the uvs and the positions (if the CMDL file has 16-bit positions) are written as
+	// their 16-bit integers. bvh is optional and has to be built from mesh.
+	static bool write(const std::string &fileName, const Mesh &mesh, bool quantize, const Bvh *bvh, std::ostream &log);
+};
+
+// Maps a .cmesh file and hands out pointers into it. open() only checks the header and that every array lies inside
+// the file, which is all a loader that trusts the file needs. validate() checks every submesh and every corner, that
+// the bounding boxes hold what they bound, and the BVH.
+class MeshFileReader
+{
+public:
+	MeshFileReader();
+
+	bool open(const std::string &fileName);
+	void close();
+	bool validate();
+	// The reason open() or validate() failed
+	const std::string &getError() const;
+
+	const MeshFileHeader &getHeader() const;
+	// The float arrays are only there if the attribute isn't quantized (getHeader().quantized).
+	const float *getPositions() const;
+	const float *getNormals() const;
+	const float *getUvs() const;
+	const int16_t *getQuantizedPositions() const;
+	const int16_t *getQuantizedNormals() const;
+	const uint16_t *getQuantizedUvs() const;
+	const uint16_t *getCorners() const;
+	const MeshFileSubmesh *getSubmeshes() const;
+	const MeshFileMaterial *getMaterials() const;
+	const MeshFileMaterialPass *getMaterialPasses() const;
+	const MeshFileMaterialValue *getMaterialValues() const;
+	const MeshFileBvhNode *getBvhNodes() const;
+	const uint32_t *getBvhTriangles() const;
+
+private:
+	MeshFileReader(const MeshFileReader &) = delete;
+	MeshFileReader &operator=(const MeshFileReader &) = delete;
+
+	bool fail(const std::string &reason);
+	// Checks that the array with count elements of elementSize bytes at offset lies inside the file and is aligned.
+	bool checkArray(const char *name, uint64_t offset, uint64_t count, uint64_t elementSize);
+	const uint8_t *at(uint64_t offset) const;
+	// Dequantized if the positions are quantized
+	void getPosition(uint16_t index, float position[3]) const;
+	// How far a dequantized position can lie outside of a box computed on the decoded floats
+	float getPositionSlack() const;
+	bool validateBvh();
+
+private:
+	MappedFile file;
+	const MeshFileHeader *header;
+	std::string error;
+};
@@ -0,0 +1,272 @@
+#include "MeshOptimizer.h"
+#include "VertexDecoder.h"
+
+
+static const uint32_t NoVertex = 0xFFFFFFFF;
+// Marks a vertex that isn't in the simulated cache
+static const int64_t NotCached = -static_cast<int64_t>(MeshOptimizer::CacheSize);
+
+
+MeshOptimizer::Result MeshOptimizer::optimize(Mesh &mesh)
+{
+	Result result;
+	this->weldCorners(mesh, result);
+
+	this->localIds.assign(this->vertices.size(), NoVertex);
+	this->cachedAt.assign(this->vertices.size(), NotCached);
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		this->reorderTriangles(this->submeshIndices[s]);
+		result.trianglesAfter += this->submeshIndices[s].size() / 3;
+		result.cacheMissesAfter += this->countCacheMisses(this->submeshIndices[s]);
+	}
+
+	this->writeBack(mesh, result);
+
+	this->vertices.clear();
+	this->vertexIds.clear();
+	this->submeshIndices.clear();
+	this->stripIndices.clear();
+	return result;
+}
+
+uint32_t MeshOptimizer::addVertex(const Submesh &submesh, const IndexTriplet &corner)
+{
+	// Attributes the submesh doesn't have must not split vertices
+	IndexTriplet vertex = corner;
+	if (!submesh.hasNormals) vertex.norm = 0;
+	if (!submesh.hasUvs) vertex.tex = 0;
+	uint64_t key = vertex.pos | (static_cast<uint64_t>(vertex.norm) << 16) | (static_cast<uint64_t>(vertex.tex) << 32);
+
+	std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> entry = this->vertexIds.insert(std::make_pair(key, static_cast<uint32_t>(this->vertices.size())));
+	if (entry.second) {
+		this->vertices.push_back(vertex);
+	}
+	return entry.first->second;
+}
+
+void MeshOptimizer::weldCorners(const Mesh &mesh, Result &result)
+{
+	size_t cornerCount = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		cornerCount += mesh.submeshes[s].indices.size() + mesh.submeshes[s].stripCorners.size();
+	}
+	this->vertexIds.reserve(cornerCount);
+	this->submeshIndices.resize(mesh.submeshes.size());
+	this->stripIndices.resize(mesh.submeshes.size());
+
+	std::vector<uint32_t> decodedOrder;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const Submesh &submesh = mesh.submeshes[s];
+		std::vector<uint32_t> &indices = this->submeshIndices[s];
+		indices.reserve(submesh.indices.size());
+		decodedOrder.resize(submesh.indices.size());
+		for (size_t c = 0; c + 2 < submesh.indices.size(); c += 3) {
+			const IndexTriplet *triangle = &submesh.indices[c];
+			for (int k = 0; k < 3; k++) {
+				decodedOrder[c + k] = this->addVertex(submesh, triangle[k]);
+			}
+			if (triangle[0].pos == triangle[1].pos || triangle[1].pos == triangle[2].pos || triangle[0].pos == triangle[2].pos) {
+				result.degenerateTriangles++;
+				continue;
+			}
+			indices.insert(indices.end(), &decodedOrder[c], &decodedOrder[c] + 3);
+		}
+
+		std::vector<uint32_t> &strip = this->stripIndices[s];
+		strip.resize(submesh.stripCorners.size());
+		for (size_t c = 0; c < submesh.stripCorners.size(); c++) {
+			strip[c] = this->addVertex(submesh, submesh.stripCorners[c]);
+		}
+
+		// The misses before are counted on the triangles as they were decoded, degenerate ones included.
+		if (this->cachedAt.size() < this->vertices.size()) {
+			this->cachedAt.resize(this->vertices.size(), NotCached);
+		}
+		result.trianglesBefore += submesh.indices.size() / 3;
+		result.cacheMissesBefore += this->countCacheMisses(decodedOrder);
+	}
+}
+
+uint64_t MeshOptimizer::countCacheMisses(const std::vector<uint32_t> &indices)
+{
+	// A vertex stays in the FIFO cache until CacheSize other vertices were added after it.
+	int64_t misses = 0;
+	for (size_t c = 0; c < indices.size(); c++) {
+		int64_t &cached = this->cachedAt[indices[c]];
+		if (misses - cached >= CacheSize) {
+			cached = misses++;
+		}
+	}
+	for (size_t c = 0; c < indices.size(); c++) {
+		this->cachedAt[indices[c]] = NotCached;
+	}
+	return static_cast<uint64_t>(misses);
+}
+
+// Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007):
+// all remaining triangles around one vertex are emitted in one go, then the next vertex is picked among the vertices
+// of these triangles, preferring the ones that will still be in the cache when their remaining triangles are emitted.
+void MeshOptimizer::reorderTriangles(std::vector<uint32_t> &indices)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+
+	// Local ids 0 .. vertexCount - 1 for the vertices of this submesh
+	std::vector<uint32_t> globalIds;
+	std::vector<uint32_t> corners(indices.size());
+	for (size_t c = 0; c < indices.size(); c++) {
+		uint32_t &local = this->localIds[indices[c]];
+		if (local == NoVertex) {
+			local = static_cast<uint32_t>(globalIds.size());
+			globalIds.push_back(indices[c]);
+		}
+		corners[c] = local;
+	}
+	size_t vertexCount = globalIds.size();
+	for (size_t v = 0; v < vertexCount; v++) {
+		this->localIds[globalIds[v]] = NoVertex;
+	}
+
+	// The triangles around every vertex
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t c = 0; c < corners.size(); c++) {
+		adjacencyStart[corners[c] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	std::vector<uint32_t> adjacency(corners.size());
+	std::vector<uint32_t> live(vertexCount);	// Triangles around the vertex that weren't emitted yet
+	for (size_t v = 0; v < vertexCount; v++) {
+		live[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+	}
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t c = 0; c < corners.size(); c++) {
+		adjacency[fill[corners[c]]++] = static_cast<uint32_t>(c / 3);
+	}
+
+	std::vector<int64_t> cacheTime(vertexCount, 0);
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd, candidates, output;
+	deadEnd.reserve(corners.size());
+	output.reserve(corners.size());
+	int64_t time = CacheSize + 1;
+	size_t cursor = 0;
+	int64_t fanning = corners[0];
+
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle]) continue;
+			emitted[triangle] = 1;
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = corners[3 * triangle + k];
+				output.push_back(globalIds[v]);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > CacheSize) {
+					cacheTime[v] = time++;
+				}
+			}
+		}
+
+		// The candidate that was added to the cache earliest and still is in the cache after its remaining triangles
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); i++) {
+			uint32_t v = candidates[i];
+			if (live[v] == 0) continue;
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * static_cast<int64_t>(live[v]) <= CacheSize) {
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		// Otherwise the most recently used vertex with triangles left, then any vertex with triangles left
+		while (fanning < 0 && !deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) fanning = v;
+		}
+		while (fanning < 0 && cursor < vertexCount) {
+			if (live[cursor] > 0) fanning = static_cast<int64_t>(cursor);
+			cursor++;
+		}
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::writeBack(Mesh &mesh, Result &result)
+{
+	// Vertices are numbered in the order of their first use. Vertices of dropped triangles only are left out.
+	std::vector<uint32_t> &newIds = this->localIds;
+	newIds.assign(this->vertices.size(), NoVertex);
+	uint32_t vertexCount = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		for (int list = 0; list < 2; list++) {
+			const std::vector<uint32_t> &indices = (list == 0) ? this->submeshIndices[s] : this->stripIndices[s];
+			for (size_t c = 0; c < indices.size(); c++) {
+				if (newIds[indices[c]] == NoVertex) newIds[indices[c]] = vertexCount++;
+			}
+		}
+	}
+	result.vertexCount = vertexCount;
+	result.welded = vertexCount <= 0x10000;
+
+	if (result.welded) {
+		// One attribute entry per vertex. Indices past the end of an attribute array get zeros, like in the GLB writer.
+		AttributeArray3 positions(mesh.getArena()), normals(mesh.getArena());
+		AttributeArray2 uvs(mesh.getArena());
+		positions.resize(vertexCount);
+		if (mesh.normals.size() > 0) normals.resize(vertexCount);
+		if (mesh.uvs.size() > 0) uvs.resize(vertexCount);
+		for (size_t v = 0; v < this->vertices.size(); v++) {
+			uint32_t id = newIds[v];
+			if (id == NoVertex) continue;
+			const IndexTriplet &corner = this->vertices[v];
+			bool valid = corner.pos < mesh.positions.size();
+			positions.x[id] = valid ? mesh.positions.x[corner.pos] : 0.0f;
+			positions.y[id] = valid ? mesh.positions.y[corner.pos] : 0.0f;
+			positions.z[id] = valid ? mesh.positions.z[corner.pos] : 0.0f;
+			if (normals.size() > 0) {
+				valid = corner.norm < mesh.normals.size();
+				normals.x[id] = valid ? mesh.normals.x[corner.norm] : 0.0f;
+				normals.y[id] = valid ? mesh.normals.y[corner.norm] : 0.0f;
+				normals.z[id] = valid ? mesh.normals.z[corner.norm] : 1.0f;
+			}
+			if (uvs.size() > 0) {
+				valid = corner.tex < mesh.uvs.size();
+				uvs.u[id] = valid ? mesh.uvs.u[corner.tex] : 0.0f;
+				uvs.v[id] = valid ? mesh.uvs.v[corner.tex] : 0.0f;
+			}
+		}
+		mesh.positions = std::move(positions);
+		mesh.normals = std::move(normals);
+		mesh.uvs = std::move(uvs);
+	}
+
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		Submesh &submesh = mesh.submeshes[s];
+		for (int list = 0; list < 2; list++) {
+			const std::vector<uint32_t> &indices = (list == 0) ? this->submeshIndices[s] : this->stripIndices[s];
+			ArenaVector<IndexTriplet> &corners = (list == 0) ? submesh.indices : submesh.stripCorners;
+			corners.resize(indices.size());
+			for (size_t c = 0; c < indices.size(); c++) {
+				if (result.welded) {
+					unsigned short id = static_cast<unsigned short>(newIds[indices[c]]);
+					corners[c].pos = corners[c].norm = corners[c].tex = id;
+				}
+				else {
+					corners[c] = this->vertices[indices[c]];
+				}
+			}
+		}
+		// Dropping the degenerate triangles can leave positions out
+		VertexDecoder::computeBounds(mesh.positions, submesh);
+	}
+}
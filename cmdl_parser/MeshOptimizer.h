@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "Mesh.h"
+
+// Optional pass over a decoded Mesh (-optimize) for models that are rendered in real time:
+// - identical (position, normal, uv) corners are welded into one vertex
+// - degenerate triangles (two corners on the same position, common in strips) are dropped
+// - the triangles of every submesh are reordered for the post-transform vertex cache (Tipsify)
+// - the vertices are renumbered in the order of their first use, so they are fetched front to back
+// Afterwards the attribute arrays hold one entry per vertex and the three indices of every corner are the same.
+class MeshOptimizer
+{
+public:
+	// Size of the simulated FIFO post-transform cache, for the reordering and for the ACMR.
+	static const unsigned int CacheSize = 16;
+
+	struct Result
+	{
+		uint64_t vertexCount;			// Unique vertices after welding
+		uint64_t degenerateTriangles;	// Dropped
+		uint64_t trianglesBefore;		// Triangles of the triangle lists; kept strips are left alone
+		uint64_t trianglesAfter;
+		uint64_t cacheMissesBefore;		// Transformed vertices in the decoded order
+		uint64_t cacheMissesAfter;
+		bool welded;					// false if the vertices don't fit into 16-bit indices. The triangles are reordered anyway.
+
+		Result() : vertexCount(0), degenerateTriangles(0), trianglesBefore(0), trianglesAfter(0), cacheMissesBefore(0), cacheMissesAfter(0), welded(false) {}
+		// Average cache miss ratio: transformed vertices per triangle
+		double getAcmrBefore() const { return this->trianglesBefore > 0 ? static_cast<double>(this->cacheMissesBefore) / this->trianglesBefore : 0.0; }
+		double getAcmrAfter() const { return this->trianglesAfter > 0 ? static_cast<double>(this->cacheMissesAfter) / this->trianglesAfter : 0.0; }
+	};
+
+	Result optimize(Mesh &mesh);
+
+private:
+	// Gives every corner the id of its unique vertex and drops the degenerate triangles.
+	void weldCorners(const Mesh &mesh, Result &result);
+	uint32_t addVertex(const Submesh &submesh, const IndexTriplet &corner);
+	// Counts the vertices transformed for the triangle list (vertex ids) with an empty FIFO cache of CacheSize vertices.
+	uint64_t countCacheMisses(const std::vector<uint32_t> &indices);
+	// Reorders the triangles of one submesh (vertex ids) with Tipsify.
+	void reorderTriangles(std::vector<uint32_t> &indices);
+	// Writes the triangles and strips back to the mesh, with welded vertices if they fit into 16-bit indices.
+	void writeBack(Mesh &mesh, Result &result);
+
+private:
+	std::vector<IndexTriplet> vertices;	// Corner of every unique vertex
+	std::unordered_map<uint64_t, uint32_t> vertexIds;	// (pos, norm, tex) -> vertex
+	std::vector<std::vector<uint32_t> > submeshIndices;	// Vertex ids of the triangles, per submesh
+	std::vector<std::vector<uint32_t> > stripIndices;	// Vertex ids of the kept strips, per submesh
+	// Scratch with one entry per vertex
+	std::vector<uint32_t> localIds;
+	std::vector<int64_t> cachedAt;
+};
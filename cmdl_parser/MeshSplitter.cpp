@@ -0,0 +1,108 @@
+#include "MeshSplitter.h"
+
+
+static const uint32_t NoIndex = 0xFFFFFFFF;
+
+
+// The index of an attribute entry in the group mesh. Indices past the end of the attribute array stay past the end,
+// the writers give them default values.
+static unsigned short remapIndex(unsigned short index, size_t arraySize, std::vector<uint32_t> &groupIds, std::vector<uint32_t> &used)
+{
+	if (index >= arraySize) return 0xFFFF;
+	uint32_t &id = groupIds[index];
+	if (id == NoIndex) {
+		id = static_cast<uint32_t>(used.size());
+		used.push_back(index);
+	}
+	return static_cast<unsigned short>(id);
+}
+
+static void copyEntries(const AttributeArray3 &attribute, const std::vector<uint32_t> &used, AttributeArray3 &groupAttribute)
+{
+	groupAttribute.resize(used.size());
+	for (size_t i = 0; i < used.size(); i++) {
+		groupAttribute.x[i] = attribute.x[used[i]];
+		groupAttribute.y[i] = attribute.y[used[i]];
+		groupAttribute.z[i] = attribute.z[used[i]];
+	}
+}
+
+static void copyEntries(const AttributeArray2 &attribute, const std::vector<uint32_t> &used, AttributeArray2 &groupAttribute)
+{
+	groupAttribute.resize(used.size());
+	for (size_t i = 0; i < used.size(); i++) {
+		groupAttribute.u[i] = attribute.u[used[i]];
+		groupAttribute.v[i] = attribute.v[used[i]];
+	}
+}
+
+
+size_t MeshSplitter::extractGroup(const Mesh &mesh, uint16_t group, Mesh &groupMesh)
+{
+	this->positionIds.assign(mesh.positions.size(), NoIndex);
+	this->normalIds.assign(mesh.normals.size(), NoIndex);
+	this->uvIds.assign(mesh.uvs.size(), NoIndex);
+	this->usedPositions.clear();
+	this->usedNormals.clear();
+	this->usedUvs.clear();
+	this->materialIds.assign(mesh.materials.size(), NoIndex);
+
+	// The bounding box of the header is the one of the whole model
+	groupMesh.flags = mesh.flags;
+	groupMesh.boundingBox[0] = mesh.boundingBox[0];
+	groupMesh.boundingBox[1] = mesh.boundingBox[1];
+	if (group < mesh.visibilityGroups.size()) {
+		const ArenaString &name = mesh.visibilityGroups[group];
+		groupMesh.visibilityGroups.push_back(ArenaString(name.data(), name.size(), ArenaAllocator<char>(groupMesh.getArena())));
+	}
+
+	size_t submeshCount = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		if (mesh.submeshes[s].visibilityGroup == group) submeshCount++;
+	}
+	groupMesh.resizeSubmeshes(submeshCount);
+
+	size_t groupSubmesh = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const Submesh &submesh = mesh.submeshes[s];
+		if (submesh.visibilityGroup != group) continue;
+		Submesh &copy = groupMesh.submeshes[groupSubmesh++];
+
+		uint32_t &materialId = this->materialIds[submesh.materialIndex];
+		if (materialId == NoIndex) {
+			materialId = static_cast<uint32_t>(groupMesh.materials.size());
+			groupMesh.materials.push_back(makeArenaObject<Material>(groupMesh.getArena(), *mesh.materials[submesh.materialIndex]));
+		}
+		copy.sectionIndex = submesh.sectionIndex;
+		copy.materialIndex = static_cast<uint16_t>(materialId);
+		copy.visibilityGroup = groupMesh.visibilityGroups.empty() ? Submesh::NoVisibilityGroup : 0;
+		copy.boundingBox[0] = submesh.boundingBox[0];
+		copy.boundingBox[1] = submesh.boundingBox[1];
+		copy.hasNormals = submesh.hasNormals;
+		copy.hasUvs = submesh.hasUvs;
+		this->copyCorners(mesh, submesh, submesh.indices, copy.indices);
+		this->copyCorners(mesh, submesh, submesh.stripCorners, copy.stripCorners);
+		copy.stripLengths.assign(submesh.stripLengths.begin(), submesh.stripLengths.end());
+		copy.triangleListCount = submesh.triangleListCount;
+		copy.stripCount = submesh.stripCount;
+		copy.fanCount = submesh.fanCount;
+	}
+
+	copyEntries(mesh.positions, this->usedPositions, groupMesh.positions);
+	copyEntries(mesh.normals, this->usedNormals, groupMesh.normals);
+	copyEntries(mesh.uvs, this->usedUvs, groupMesh.uvs);
+	return submeshCount;
+}
+
+void MeshSplitter::copyCorners(const Mesh &mesh, const Submesh &submesh, const ArenaVector<IndexTriplet> &corners, ArenaVector<IndexTriplet> &groupCorners)
+{
+	// Attributes the submesh doesn't have are left out
+	groupCorners.resize(corners.size());
+	for (size_t c = 0; c < corners.size(); c++) {
+		const IndexTriplet &corner = corners[c];
+		IndexTriplet &groupCorner = groupCorners[c];
+		groupCorner.pos = remapIndex(corner.pos, mesh.positions.size(), this->positionIds, this->usedPositions);
+		groupCorner.norm = submesh.hasNormals ? remapIndex(corner.norm, mesh.normals.size(), this->normalIds, this->usedNormals) : 0;
+		groupCorner.tex = submesh.hasUvs ? remapIndex(corner.tex, mesh.uvs.size(), this->uvIds, this->usedUvs) : 0;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+
+// Copies the submeshes of one visibility group into a mesh of their own (-splitgroups), so a group can be written
+// to its own output. The group mesh only holds the vertex attributes and materials its submeshes use, renumbered in
+// the order of their first use.
+class MeshSplitter
+{
+public:
+	// group is an index into mesh.visibilityGroups, or Submesh::NoVisibilityGroup for the submeshes that aren't in any
+	// group. groupMesh has to be empty and allocates from its own arena. Returns the number of submeshes copied.
+	size_t extractGroup(const Mesh &mesh, uint16_t group, Mesh &groupMesh);
+
+private:
+	void copyCorners(const Mesh &mesh, const Submesh &submesh, const ArenaVector<IndexTriplet> &corners, ArenaVector<IndexTriplet> &groupCorners);
+
+private:
+	// Per attribute array: the index in the group mesh of every entry (or none), and the entries in the group mesh
+	std::vector<uint32_t> positionIds, normalIds, uvIds;
+	std::vector<uint32_t> usedPositions, usedNormals, usedUvs;
+	std::vector<uint32_t> materialIds;
+};
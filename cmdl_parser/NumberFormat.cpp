@@ -0,0 +1,248 @@
+#include "NumberFormat.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+
+static const char digitPairs[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// 10^0 .. 10^64. The literals are rounded correctly by the compiler.
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+	1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29,
+	1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+	1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47, 1e48, 1e49,
+	1e50, 1e51, 1e52, 1e53, 1e54, 1e55, 1e56, 1e57, 1e58, 1e59,
+	1e60, 1e61, 1e62, 1e63, 1e64
+};
+
+static const uint64_t integerPowersOfTen[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL
+};
+
+// value * 10^exponent for |exponent| <= 64
+static inline double scaleByPowerOfTen(double value, int exponent)
+{
+	return exponent >= 0 ? value * powersOfTen[exponent] : value / powersOfTen[-exponent];
+}
+
+static size_t formatUInt64(uint64_t value, char *out)
+{
+	char digits[20];
+	size_t position = sizeof(digits);
+	while (value >= 100) {
+		unsigned int pair = static_cast<unsigned int>(value % 100);
+		value /= 100;
+		position -= 2;
+		memcpy(digits + position, digitPairs + pair * 2, 2);
+	}
+	if (value >= 10) {
+		position -= 2;
+		memcpy(digits + position, digitPairs + value * 2, 2);
+	}
+	else {
+		digits[--position] = static_cast<char>('0' + value);
+	}
+	memcpy(out, digits + position, sizeof(digits) - position);
+	return sizeof(digits) - position;
+}
+
+// Handles the sign, nan and inf. Returns true if the value was written completely.
+static bool formatSpecialFloat(float value, char *out, size_t &length)
+{
+	length = 0;
+	if (value != value) {
+		memcpy(out, "nan", 3);
+		length = 3;
+		return true;
+	}
+	if (signbit(value)) {
+		out[length++] = '-';
+	}
+	if (value > FLT_MAX || value < -FLT_MAX) {
+		memcpy(out + length, "inf", 3);
+		length += 3;
+		return true;
+	}
+	if (value == 0.0f) {
+		out[length++] = '0';
+		return true;
+	}
+	return false;
+}
+
+size_t NumberFormat::formatUInt(uint32_t value, char *out)
+{
+	return formatUInt64(value, out);
+}
+
+size_t NumberFormat::formatInt(int32_t value, char *out)
+{
+	if (value < 0) {
+		out[0] = '-';
+		return 1 + formatUInt64(static_cast<uint64_t>(-static_cast<int64_t>(value)), out + 1);
+	}
+	return formatUInt64(static_cast<uint64_t>(value), out);
+}
+
+size_t NumberFormat::formatFloatShortest(float value, char *out)
+{
+	size_t length;
+	if (formatSpecialFloat(value, out, length)) return length;
+
+	// Every decimal strictly between the midpoints to the neighbouring floats reads back as this float.
+	// The midpoints need one bit more than a float, so they are exact in double precision.
+	float magnitude = fabsf(value);
+	uint32_t bits;
+	memcpy(&bits, &magnitude, sizeof(bits));
+	uint32_t lowerBits = bits - 1, upperBits = bits + 1;
+	float lowerNeighbour, upperNeighbour;
+	memcpy(&lowerNeighbour, &lowerBits, sizeof(lowerBits));
+	memcpy(&upperNeighbour, &upperBits, sizeof(upperBits));
+	double exact = magnitude;
+	double lowerBound = (exact + lowerNeighbour) / 2;
+	double upperBound = (upperNeighbour <= FLT_MAX) ? (exact + upperNeighbour) / 2 : exact + (exact - lowerNeighbour) / 2;
+	// A decimal right on a bound reads back as this float if its mantissa is even (round half to even).
+	bool boundsInclusive = (bits & 1) == 0;
+	// Inexact candidates this close to a bound can't be judged reliably with doubles. They are skipped, which at worst costs a digit.
+	double margin = exact * 1e-14;
+
+	// Decimal exponent of the first significant digit.
+	int exponent = static_cast<int>(floor(log10(exact)));
+	if (exact >= scaleByPowerOfTen(1.0, exponent + 1)) exponent++;
+	if (exact < scaleByPowerOfTen(1.0, exponent)) exponent--;
+
+	// Find the smallest number of significant digits that still round trips. 9 digits always do.
+	uint64_t significand = 0;
+	int digitCount;
+	for (digitCount = 1; digitCount <= 9; digitCount++) {
+		significand = static_cast<uint64_t>(scaleByPowerOfTen(exact, digitCount - 1 - exponent) + 0.5);
+		int candidateExponent = exponent;
+		if (significand >= integerPowersOfTen[digitCount]) { // Rounded up to the next power of ten
+			significand /= 10;
+			candidateExponent++;
+		}
+
+		int candidateScale = candidateExponent - (digitCount - 1);
+		double candidate = scaleByPowerOfTen(static_cast<double>(significand), candidateScale);
+		bool roundTrips;
+		if (candidateScale >= 0 && candidate < 9007199254740992.0) { // An integer below 2^53, so the comparison is exact
+			roundTrips = (candidate > lowerBound && candidate < upperBound) || (boundsInclusive && (candidate == lowerBound || candidate == upperBound));
+		}
+		else {
+			roundTrips = candidate > lowerBound + margin && candidate < upperBound - margin;
+		}
+		if (digitCount == 9 || roundTrips) {
+			exponent = candidateExponent;
+			break;
+		}
+	}
+
+	// Drop trailing zeros
+	while (digitCount > 1 && significand % 10 == 0) {
+		significand /= 10;
+		digitCount--;
+	}
+
+	char digits[20];
+	formatUInt64(significand, digits);
+
+	if (exponent >= -5 && exponent < 9) {
+		if (exponent < 0) { // 0.000ddd
+			out[length++] = '0';
+			out[length++] = '.';
+			for (int i = -1; i > exponent; i--) out[length++] = '0';
+			memcpy(out + length, digits, digitCount);
+			length += digitCount;
+		}
+		else if (exponent + 1 < digitCount) { // dd.ddd
+			memcpy(out + length, digits, exponent + 1);
+			length += exponent + 1;
+			out[length++] = '.';
+			memcpy(out + length, digits + exponent + 1, digitCount - exponent - 1);
+			length += digitCount - exponent - 1;
+		}
+		else { // ddd000
+			memcpy(out + length, digits, digitCount);
+			length += digitCount;
+			for (int i = digitCount - 1; i < exponent; i++) out[length++] = '0';
+		}
+	}
+	else { // d.ddde+XX
+		out[length++] = digits[0];
+		if (digitCount > 1) {
+			out[length++] = '.';
+			memcpy(out + length, digits + 1, digitCount - 1);
+			length += digitCount - 1;
+		}
+		out[length++] = 'e';
+		out[length++] = exponent < 0 ? '-' : '+';
+		int absExponent = exponent < 0 ? -exponent : exponent;
+		if (absExponent < 10) out[length++] = '0';
+		length += formatUInt64(absExponent, out + length);
+	}
+	return length;
+}
+
+size_t NumberFormat::formatFloatFixed(float value, int precision, char *out)
+{
+	if (precision < 0) precision = 0;
+	if (precision > MaxFixedPrecision) precision = MaxFixedPrecision;
+
+	size_t length;
+	if (value != value || value > FLT_MAX || value < -FLT_MAX) {
+		formatSpecialFloat(value, out, length);
+		return length;
+	}
+
+	double scaled = fabs(static_cast<double>(value)) * powersOfTen[precision];
+	if (scaled >= 9e15) { // Would not fit into the integer path anymore
+		return static_cast<size_t>(sprintf_s(out, MaxLength, "%.*f", precision, value));
+	}
+
+	length = 0;
+	if (signbit(value)) out[length++] = '-';
+
+	// The float is mantissa * 2^exponent, so value * 10^precision is exactly mantissa * 10^precision * 2^exponent.
+	// mantissa * 10^precision stays below 2^54, which lets the digits be rounded on the exact value with integers,
+	// half to even like printf.
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t exponentBits = (bits >> 23) & 0xFF;
+	uint64_t mantissa = (exponentBits == 0) ? (bits & 0x7FFFFF) : ((bits & 0x7FFFFF) | 0x800000);
+	int exponent = (exponentBits == 0) ? -149 : static_cast<int>(exponentBits) - 150;
+	uint64_t product = mantissa * integerPowersOfTen[precision];
+	uint64_t rounded;
+	if (exponent >= 0) {
+		rounded = product << exponent; // An integer, below 9e15 after the check above
+	}
+	else if (exponent > -64) {
+		int shift = -exponent;
+		rounded = product >> shift;
+		uint64_t remainder = product & ((1ULL << shift) - 1);
+		uint64_t half = 1ULL << (shift - 1);
+		if (remainder > half || (remainder == half && (rounded & 1) != 0)) rounded++;
+	}
+	else {
+		rounded = 0; // Less than half of the last digit, the product is below 2^54
+	}
+	length += formatUInt64(rounded / integerPowersOfTen[precision], out + length);
+	if (precision > 0) {
+		out[length++] = '.';
+		uint64_t fraction = rounded % integerPowersOfTen[precision];
+		for (int i = precision - 1; i >= 0; i--) {
+			out[length + i] = static_cast<char>('0' + fraction % 10);
+			fraction /= 10;
+		}
+		length += precision;
+	}
+	return length;
+}
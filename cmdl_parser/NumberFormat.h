@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fast number to text conversion without locales, streams or heap allocations.
+// Every function writes to out (no terminating zero) and returns the number of characters written.
+class NumberFormat
+{
+public:
+	// Enough room for every result of these functions.
+	static const size_t MaxLength = 64;
+	// Digits after the decimal point that formatFloatFixed() supports
+	static const int MaxFixedPrecision = 9;
+
+	static size_t formatUInt(uint32_t value, char *out);
+	static size_t formatInt(int32_t value, char *out);
+
+	// The shortest decimal representation that reads back as exactly the same float.
+	static size_t formatFloatShortest(float value, char *out);
+	// value with precision digits after the decimal point, like printf("%.*f"): rounded on the exact binary value,
+	// ties to even.
+	static size_t formatFloatFixed(float value, int precision, char *out);
+};
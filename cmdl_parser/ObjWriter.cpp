@@ -0,0 +1,196 @@
+#include "ObjWriter.h"
+
+#include <string.h>
+
+
+ObjWriter::ObjWriter(const std::string &fileName, FloatFormat floatFormat /*= Shortest*/, int precision /*= 6*/, Arena *arena /*= nullptr*/)
+	: file(fileName), buffer(BufferSize, 0, ArenaAllocator<char>(arena)), used(0), floatFormat(floatFormat), precision(precision)
+{
+}
+
+ObjWriter::~ObjWriter()
+{
+	this->close();
+}
+
+bool ObjWriter::isOpen() const
+{
+	return this->file.is_open();
+}
+
+bool ObjWriter::close()
+{
+	if (!this->file.is_open()) return false;
+	this->flush();
+	bool success = !this->file.fail();
+	this->file.close();
+	return success;
+}
+
+void ObjWriter::flush()
+{
+	if (this->used > 0) {
+		this->file.write(this->buffer.data(), this->used);
+		this->used = 0;
+	}
+}
+
+void ObjWriter::reserve(size_t count)
+{
+	if (this->used + count > this->buffer.size()) {
+		this->flush();
+		if (count > this->buffer.size()) this->buffer.resize(count);
+	}
+}
+
+void ObjWriter::append(const char *text, size_t length)
+{
+	memcpy(this->buffer.data() + this->used, text, length);
+	this->used += length;
+}
+
+void ObjWriter::appendFloat(float value)
+{
+	char *out = this->buffer.data() + this->used;
+	if (this->floatFormat == Fixed) {
+		this->used += NumberFormat::formatFloatFixed(value, this->precision, out);
+	}
+	else {
+		this->used += NumberFormat::formatFloatShortest(value, out);
+	}
+}
+
+void ObjWriter::appendFaceCorner(const IndexTriplet &corner, bool hasUv, bool hasNormal)
+{
+	this->used += NumberFormat::formatUInt(corner.pos + 1, this->buffer.data() + this->used);
+	this->buffer[this->used++] = '/';
+	if (hasUv) this->used += NumberFormat::formatUInt(corner.tex + 1, this->buffer.data() + this->used);
+	this->buffer[this->used++] = '/';
+	if (hasNormal) this->used += NumberFormat::formatUInt(corner.norm + 1, this->buffer.data() + this->used);
+	this->buffer[this->used++] = ' ';
+}
+
+void ObjWriter::writeLine(const std::string &text)
+{
+	this->reserve(text.length() + 1);
+	this->append(text.c_str(), text.length());
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writeLine(const char *keyword, const std::string &text)
+{
+	size_t keywordLength = strlen(keyword);
+	this->reserve(keywordLength + text.length() + 2);
+	this->append(keyword, keywordLength);
+	this->buffer[this->used++] = ' ';
+	this->append(text.c_str(), text.length());
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writePosition(float x, float y, float z)
+{
+	this->reserve(3 * NumberFormat::MaxLength + 8);
+	this->append("v ", 2);
+	this->appendFloat(x);
+	this->buffer[this->used++] = ' ';
+	this->appendFloat(y);
+	this->buffer[this->used++] = ' ';
+	this->appendFloat(z);
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writeNormal(float x, float y, float z)
+{
+	this->reserve(3 * NumberFormat::MaxLength + 8);
+	this->append("vn ", 3);
+	this->appendFloat(x);
+	this->buffer[this->used++] = ' ';
+	this->appendFloat(y);
+	this->buffer[this->used++] = ' ';
+	this->appendFloat(z);
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writeUv(float u, float v)
+{
+	this->reserve(2 * NumberFormat::MaxLength + 8);
+	this->append("vt ", 3);
+	this->appendFloat(u);
+	this->buffer[this->used++] = ' ';
+	this->appendFloat(v);
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writeFace(const IndexTriplet &a, const IndexTriplet &b, const IndexTriplet &c, bool hasUv, bool hasNormal)
+{
+	// 3 corners with 3 indices of at most 5 digits and 3 separators each
+	this->reserve(2 + 3 * 18 + 1);
+	this->append("f ", 2);
+	this->appendFaceCorner(a, hasUv, hasNormal);
+	this->appendFaceCorner(b, hasUv, hasNormal);
+	this->appendFaceCorner(c, hasUv, hasNormal);
+	this->buffer[this->used++] = '\n';
+}
+
+void ObjWriter::writeMesh(const Mesh &mesh, const std::string &materialLibrary)
+{
+	this->writeVertexAttributes(mesh, materialLibrary);
+	for (size_t i = 0; i < mesh.submeshes.size(); i++) {
+		this->writeSubmesh(mesh, mesh.submeshes[i]);
+	}
+}
+
+void ObjWriter::writeVertexAttributes(const Mesh &mesh, const std::string &materialLibrary)
+{
+	this->writeLine("#");
+	this->writeLine("#");
+	this->writeLine("mtllib", materialLibrary);
+
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		this->writePosition(mesh.positions.x[i], mesh.positions.y[i], mesh.positions.z[i]);
+	}
+	for (size_t i = 0; i < mesh.normals.size(); i++) {
+		this->writeNormal(mesh.normals.x[i], mesh.normals.y[i], mesh.normals.z[i]);
+	}
+	for (size_t i = 0; i < mesh.uvs.size(); i++) {
+		this->writeUv(mesh.uvs.u[i], mesh.uvs.v[i]);
+	}
+}
+
+void ObjWriter::writeSubmesh(const Mesh &mesh, const Submesh &submesh)
+{
+	this->writeLine("usemtl", mesh.materials[submesh.materialIndex]->getMaterialName());
+	this->writeLine("s off");
+	for (size_t c = 0; c + 2 < submesh.indices.size(); c += 3) {
+		this->writeFace(submesh.indices[c], submesh.indices[c + 1], submesh.indices[c + 2], submesh.hasUvs, submesh.hasNormals);
+	}
+}
+
+bool ObjWriter::writeMaterialLibrary(const std::string &fileName, const Mesh &mesh)
+{
+	std::ofstream materialFile(fileName);
+	if (!materialFile.is_open()) return false;
+	for (size_t i = 0; i < mesh.materials.size(); i++) {
+		writeMaterial(materialFile, *mesh.materials[i]);
+	}
+	materialFile.close();
+	return !materialFile.fail();
+}
+
+void ObjWriter::writeMaterial(std::ostream &materialFile, const Material &material)
+{
+	materialFile << "newmtl " << material.getMaterialName() << std::endl;
+
+	// The diffuse color, white if the material only has a texture
+	char line[64];
+	uint32_t rgba = 0xFFFFFFFF;
+	uint64_t textureId = material.getTextureId();
+	if (material.findColor(Material::DiffuseColor, rgba) || textureId != 0) {
+		sprintf_s(line, sizeof(line), "Kd %.3f %.3f %.3f", (rgba >> 24) / 255.0f, ((rgba >> 16) & 0xFF) / 255.0f, ((rgba >> 8) & 0xFF) / 255.0f);
+		materialFile << line << std::endl;
+	}
+	if (textureId != 0) {
+		sprintf_s(line, sizeof(line), "map_Kd %016llx.dds", static_cast<unsigned long long>(textureId));
+		materialFile << line << std::endl;
+	}
+}
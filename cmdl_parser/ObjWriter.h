@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "NumberFormat.h"
+
+// Writes OBJ records into a large buffer that is flushed to the file in big chunks.
+// Numbers are formatted by NumberFormat, so no record allocates memory. The buffer comes from the arena if one is
+// given, e.g. the arena of the mesh that is written.
+class ObjWriter
+{
+public:
+	enum FloatFormat
+	{
+		Shortest,	// Shortest text that reads back as the same float
+		Fixed		// A fixed number of digits after the decimal point
+	};
+
+	ObjWriter(const std::string &fileName, FloatFormat floatFormat = Shortest, int precision = 6, Arena *arena = nullptr);
+	~ObjWriter();
+
+	bool isOpen() const;
+	// Flushes and closes the file. Returns false if anything could not be written.
+	bool close();
+
+	// Writes the text followed by a line break.
+	void writeLine(const std::string &text);
+	// Writes "keyword text" followed by a line break.
+	void writeLine(const char *keyword, const std::string &text);
+	void writePosition(float x, float y, float z);
+	void writeNormal(float x, float y, float z);
+	void writeUv(float u, float v);
+	// Writes "f p/t/n p/t/n p/t/n " with 1-based indices. Texture and normal indices are left empty if not present.
+	void writeFace(const IndexTriplet &a, const IndexTriplet &b, const IndexTriplet &c, bool hasUv, bool hasNormal);
+
+	// Writes the whole mesh: all vertex attributes followed by the faces of every submesh.
+	void writeMesh(const Mesh &mesh, const std::string &materialLibrary);
+	// The two parts of writeMesh(), for writing one submesh at a time
+	void writeVertexAttributes(const Mesh &mesh, const std::string &materialLibrary);
+	void writeSubmesh(const Mesh &mesh, const Submesh &submesh);
+
+	// Writes the definitions of all materials of the mesh to a MTL file.
+	static bool writeMaterialLibrary(const std::string &fileName, const Mesh &mesh);
+	// Writes the MTL definition of one material.
+	static void writeMaterial(std::ostream &materialFile, const Material &material);
+
+private:
+	ObjWriter(const ObjWriter &) = delete;
+	ObjWriter &operator=(const ObjWriter &) = delete;
+
+	void flush();
+	// Makes sure that at least count more characters fit into the buffer.
+	void reserve(size_t count);
+	void append(const char *text, size_t length);
+	void appendFloat(float value);
+	void appendFaceCorner(const IndexTriplet &corner, bool hasUv, bool hasNormal);
+
+private:
+	static const size_t BufferSize = 1 << 20;
+
+	std::ofstream file;
+	ArenaVector<char> buffer;
+	size_t used;
+	FloatFormat floatFormat;
+	int precision;
+};
@@ -0,0 +1,235 @@
+#include "PakFile.h"
+#include "Decompressor.h"
+
+#include <sstream>
+#include <string.h>
+#include <stdint.h>
+
+
+static const uint32_t PakVersion = 2;
+static const uint32_t HeaderSize = 0x40;
+static const size_t SectionTableSize = 0x40;
+static const uint32_t StringSection = 0x53545247;	// STRG
+static const uint32_t ResourceSection = 0x52534844;	// RSHD
+static const uint32_t DataSection = 0x44415441;		// DATA
+static const uint32_t CompressedMagic = 0x434D5044;	// CMPD
+static const uint32_t BlockSizeMask = 0x00FFFFFF;
+// The sizes come from the archive. Bigger resources are rejected before anything is allocated for them.
+static const uint64_t MaxResourceSize = 0x10000000;
+
+static std::string formatId(uint64_t id)
+{
+	char text[17];
+	sprintf_s(text, sizeof(text), "%016llx", static_cast<unsigned long long>(id));
+	return text;
+}
+
+
+PakFile::PakFile()
+{
+}
+
+bool PakFile::open(const std::string &fileName)
+{
+	this->fileName = fileName;
+	if (!this->file.open(fileName)) {
+		return this->fail("Failed to open " + fileName);
+	}
+
+	ByteSpan data = this->file.span();
+	SpanReader header(data);
+	uint32_t version = header.readU32();
+	uint32_t headerSize = header.readU32();
+	if (header.fail() || version != PakVersion || headerSize != HeaderSize) {
+		return this->fail("Not a PAK archive of version 2");
+	}
+
+	header.seek(HeaderSize);
+	uint32_t sectionCount = header.readU32();
+	uint64_t sectionOffset = HeaderSize + SectionTableSize;
+	ByteSpan stringTable, resourceTable;
+	for (uint32_t i = 0; i < sectionCount && !header.fail(); i++) {
+		uint32_t type = header.readU32();
+		uint32_t size = header.readU32();
+		if (sectionOffset + size > data.size()) {
+			return this->fail("The section table points past the end of the file");
+		}
+		ByteSpan section = data.subSpan(static_cast<size_t>(sectionOffset), size);
+		if (type == StringSection) stringTable = section;
+		else if (type == ResourceSection) resourceTable = section;
+		else if (type == DataSection) this->dataSection = section;
+		sectionOffset += size;
+	}
+	if (header.fail()) {
+		return this->fail("The section table is truncated");
+	}
+	if (resourceTable.empty() || this->dataSection.empty()) {
+		return this->fail("The archive has no resource table or no data");
+	}
+	if (!this->readResourceTable(resourceTable)) return false;
+	this->readNames(stringTable);
+	return true;
+}
+
+bool PakFile::readResourceTable(const ByteSpan &section)
+{
+	SpanReader table(section);
+	uint32_t count = table.readU32();
+	// 24 bytes per resource
+	if (table.fail() || count > table.remaining() / 24) {
+		return this->fail("The resource table is truncated");
+	}
+	this->resources.resize(count);
+	this->index.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		PakResource &resource = this->resources[i];
+		resource.compressed = table.readU32() != 0;
+		resource.type = table.readU32();
+		resource.id = table.readU64();
+		resource.size = table.readU32();
+		resource.offset = table.readU32();
+		if (static_cast<uint64_t>(resource.offset) + resource.size > this->dataSection.size()) {
+			return this->fail("Resource " + formatId(resource.id) + " lies outside of the data section");
+		}
+		// Resources shared by several levels can be in an archive more than once, the first one is used.
+		this->index.insert(std::make_pair(resource.id, i));
+	}
+	return true;
+}
+
+// The names are only for the output files, a broken name table isn't an error.
+void PakFile::readNames(const ByteSpan &section)
+{
+	if (section.empty()) return;
+	SpanReader table(section);
+	uint32_t count = table.readU32();
+	for (uint32_t i = 0; i < count && !table.fail(); i++) {
+		std::string name;
+		for (uint8_t c = table.readU8(); c != 0 && !table.fail(); c = table.readU8()) {
+			name += static_cast<char>(c);
+		}
+		table.readU32(); // Type
+		uint64_t id = table.readU64();
+		if (table.fail()) return;
+
+		std::unordered_map<uint64_t, size_t>::const_iterator resource = this->index.find(id);
+		if (resource != this->index.end()) this->resources[resource->second].name = name;
+	}
+}
+
+const std::string &PakFile::getFileName() const
+{
+	return this->fileName;
+}
+
+const std::string &PakFile::getError() const
+{
+	return this->error;
+}
+
+const std::vector<PakResource> &PakFile::getResources() const
+{
+	return this->resources;
+}
+
+bool PakFile::contains(uint64_t id) const
+{
+	return this->index.count(id) != 0;
+}
+
+bool PakFile::load(uint64_t id, Asset &asset, std::string &error)
+{
+	std::unordered_map<uint64_t, size_t>::const_iterator found = this->index.find(id);
+	if (found == this->index.end()) {
+		error = this->fileName + " has no resource " + formatId(id);
+		return false;
+	}
+	const PakResource &resource = this->resources[found->second];
+	ByteSpan data = this->dataSection.subSpan(resource.offset, resource.size);
+	if (!resource.compressed) {
+		asset.setView(data);
+		return true;
+	}
+	if (!this->decompress(data, asset, error)) {
+		error = this->describe(id) + ": " + error;
+		return false;
+	}
+	return true;
+}
+
+std::string PakFile::describe(uint64_t id) const
+{
+	return this->fileName + ":" + formatId(id);
+}
+
+bool PakFile::fail(const std::string &reason)
+{
+	this->error = reason;
+	return false;
+}
+
+bool PakFile::decompress(const ByteSpan &data, Asset &asset, std::string &error)
+{
+	SpanReader header(data);
+	uint32_t magic = header.readU32();
+	uint32_t blockCount = header.readU32();
+	if (header.fail() || magic != CompressedMagic || blockCount > header.remaining() / 8) {
+		error = "Not a compressed resource";
+		return false;
+	}
+
+	std::vector<uint32_t> compressedSizes(blockCount), decompressedSizes(blockCount);
+	uint64_t compressedTotal = 0, decompressedTotal = 0;
+	for (uint32_t i = 0; i < blockCount; i++) {
+		compressedSizes[i] = header.readU32() & BlockSizeMask;
+		decompressedSizes[i] = header.readU32();
+		compressedTotal += compressedSizes[i];
+		decompressedTotal += decompressedSizes[i];
+	}
+	if (compressedTotal > header.remaining()) {
+		error = "The compressed blocks are truncated";
+		return false;
+	}
+	if (decompressedTotal > MaxResourceSize || decompressedTotal > SIZE_MAX) {
+		std::stringstream message;
+		message << "The decompressed size (" << decompressedTotal << " bytes) is too big";
+		error = message.str();
+		return false;
+	}
+
+	std::vector<uint8_t> buffer = this->buffers.acquire(static_cast<size_t>(decompressedTotal));
+	const uint8_t *source = data.data() + header.tell();
+	size_t outOffset = 0;
+	for (uint32_t i = 0; i < blockCount; i++) {
+		const uint8_t *block = source;
+		uint32_t size = compressedSizes[i];
+		uint8_t *out = buffer.data() + outOffset;
+		size_t outSize = decompressedSizes[i];
+		bool decompressed;
+		if (outSize > buffer.size() - outOffset) {
+			decompressed = false;
+		}
+		else if (size == outSize) {
+			memcpy(out, block, size);
+			decompressed = true;
+		}
+		else if (Decompressor::isZlibStream(block, size)) {
+			decompressed = Decompressor::inflateZlib(block, size, out, outSize);
+		}
+		else {
+			decompressed = Decompressor::decompressLzoSegments(block, size, out, outSize)
+				|| Decompressor::decompressLzo(block, size, out, outSize);
+		}
+		if (!decompressed) {
+			this->buffers.release(std::move(buffer));
+			std::stringstream message;
+			message << "Block " << i << " of " << blockCount << " doesn't decompress";
+			error = message.str();
+			return false;
+		}
+		source += size;
+		outOffset += outSize;
+	}
+	asset.setBuffer(std::move(buffer), &this->buffers);
+	return true;
+}
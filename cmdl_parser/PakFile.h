@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "AssetSource.h"
+
+// One resource of a PAK archive
+struct PakResource
+{
+	uint64_t id;
+	uint32_t type;			// FourCC, e.g. CMDL or TXTR
+	bool compressed;
+	uint32_t offset;		// From the start of the DATA section
+	uint32_t size;			// Bytes in the archive
+	std::string name;		// From the STRG section, empty for most resources
+};
+
+// A PAK archive of DKC Returns (the Metroid Prime 3 layout), mapped once and read in place. Big-endian throughout:
+//   0x00	version (2), header size (0x40), MD5 of the tables, padded to 0x40
+//   0x40	section count, then FourCC and size of every section (STRG, RSHD, DATA), padded to 0x80
+//   STRG	count, then per named resource: zero-terminated name, FourCC type, u64 id
+//   RSHD	count, then per resource: u32 compressed, FourCC type, u64 id, u32 size, u32 offset
+//   DATA	the resources. Compressed ones start with "CMPD", the block count and the compressed and
+//			decompressed size of every block, followed by the blocks. The top byte of the compressed size is a flag.
+// Blocks are stored if both sizes match, zlib if they start with a zlib header, and LZO1X otherwise.
+class PakFile : public AssetSource
+{
+public:
+	static const uint32_t CmdlType = 0x434D444C;	// CMDL
+	static const uint32_t TxtrType = 0x54585452;	// TXTR
+
+	PakFile();
+
+	// Maps the archive and reads the resource table. On failure getError() has the reason.
+	bool open(const std::string &fileName);
+	const std::string &getFileName() const;
+	const std::string &getError() const;
+	const std::vector<PakResource> &getResources() const;
+
+	bool contains(uint64_t id) const override;
+	// Stored resources are views into the mapping, compressed ones are decompressed into a pooled buffer.
+	bool load(uint64_t id, Asset &asset, std::string &error) override;
+	std::string describe(uint64_t id) const override;
+
+private:
+	PakFile(const PakFile &) = delete;
+	PakFile &operator=(const PakFile &) = delete;
+
+	bool fail(const std::string &reason);
+	bool readResourceTable(const ByteSpan &section);
+	void readNames(const ByteSpan &section);
+	bool decompress(const ByteSpan &data, Asset &asset, std::string &error);
+
+private:
+	MappedFile file;
+	std::string fileName;
+	std::string error;
+	ByteSpan dataSection;
+	std::vector<PakResource> resources;
+	std::unordered_map<uint64_t, size_t> index;	// Id -> first resource with the id
+	BufferPool buffers;
+};
@@ -0,0 +1,242 @@
+#include "PrimitiveDecoder.h"
+
+#include <string.h>
+
+
+static inline uint16_t loadBigEndian16(const uint8_t *src)
+{
+	return static_cast<uint16_t>((src[0] << 8) | src[1]);
+}
+
+// A vertex layout known at compile time. Absent attributes are 0.
+template <int BytesToSkip, bool HasNormal, int ColorCount, bool HasUv>
+struct FixedLayout
+{
+	static const size_t NormalOffset = BytesToSkip + 2;
+	static const size_t UvOffset = NormalOffset + (HasNormal ? 2 : 0) + 2 * ColorCount;
+	static const size_t Stride = UvOffset + (HasUv ? 2 : 0);
+
+	static size_t getStride(const VertexFormat &) { return Stride; }
+
+	static inline void read(const uint8_t *vertex, const VertexFormat &, IndexTriplet &corner)
+	{
+		corner.pos = loadBigEndian16(vertex + BytesToSkip);
+		corner.norm = HasNormal ? loadBigEndian16(vertex + NormalOffset) : 0;
+		corner.tex = HasUv ? loadBigEndian16(vertex + UvOffset) : 0;
+	}
+};
+
+// Any other layout, described at runtime by the VertexFormat
+struct GenericLayout
+{
+	static size_t getStride(const VertexFormat &format) { return format.stride; }
+
+	static inline void read(const uint8_t *vertex, const VertexFormat &format, IndexTriplet &corner)
+	{
+		corner.pos = loadBigEndian16(vertex + format.positionOffset);
+		corner.norm = format.hasNormal ? loadBigEndian16(vertex + format.normalOffset) : 0;
+		corner.tex = (format.uvCount >= 1) ? loadBigEndian16(vertex + format.uvOffset) : 0;
+	}
+};
+
+// Returns the bytes of count vertices. Bytes missing at the end of a truncated section read as zero from padding.
+static const uint8_t *readVertices(SpanReader &reader, size_t count, size_t stride, std::vector<uint8_t> &padding)
+{
+	size_t size = count * stride;
+	if (size <= reader.remaining()) {
+		return reader.readBytes(size).data();
+	}
+	padding.assign(size, 0);
+	size_t available = reader.remaining();
+	reader.readRaw(padding.data(), available);
+	reader.skip(size); // Marks the reader as failed, like reading the missing vertices would have
+	return padding.data();
+}
+
+// Counts the triangles (and the corners of the kept strips) of the primitive list, so the output can be sized once.
+// Mirrors the reads of decodePrimitives, but only hops over the vertices.
+static void countPrimitives(SpanReader reader, size_t stride, PrimitiveDecoder::StripMode stripMode, size_t &triangleCount, size_t &stripCornerCount, size_t &stripCount)
+{
+	triangleCount = stripCornerCount = stripCount = 0;
+	while (reader.remaining() > 0) {
+		uint8_t primitiveFlag = reader.readU8();
+		if (primitiveFlag == 0) {
+			break;
+		}
+
+		uint16_t primitiveObjectCount = reader.readU16();
+
+		switch (primitiveFlag & 0xF8) {
+		case 0x90: // Triangles
+			triangleCount += primitiveObjectCount / 3;
+			reader.skip((primitiveObjectCount / 3) * 3 * stride);
+			break;
+		case 0x98: // Triangle Strip
+			reader.skip(primitiveObjectCount * stride);
+			if (primitiveObjectCount < 3) break;
+			if (stripMode == PrimitiveDecoder::KeepStrips) {
+				stripCornerCount += primitiveObjectCount;
+				stripCount++;
+			}
+			else {
+				triangleCount += primitiveObjectCount - 2;
+			}
+			break;
+		case 0xA0: // Triangle Fan
+		{
+			size_t vertexCount = primitiveObjectCount > 0 ? primitiveObjectCount : 1;
+			reader.skip(vertexCount * stride);
+			if (vertexCount >= 3) triangleCount += vertexCount - 2;
+		}
+		break;
+		default:
+			return;
+		}
+	}
+}
+
+template <typename Layout>
+static PrimitiveDecoder::Result decodePrimitives(SpanReader &reader, const VertexFormat &format, PrimitiveDecoder::StripMode stripMode, Submesh &result, uint8_t &primitiveFlag)
+{
+	const size_t stride = Layout::getStride(format);
+	std::vector<uint8_t> padding;
+
+	// The output of the whole section is allocated up front and every triangle is written to it exactly once.
+	size_t triangleCount, stripCornerCount, stripCount;
+	countPrimitives(reader, stride, stripMode, triangleCount, stripCornerCount, stripCount);
+	size_t firstIndex = result.indices.size();
+	result.indices.resize(firstIndex + 3 * triangleCount);
+	IndexTriplet *out = result.indices.data() + firstIndex;
+	size_t firstStripCorner = result.stripCorners.size();
+	result.stripCorners.resize(firstStripCorner + stripCornerCount);
+	IndexTriplet *stripOut = result.stripCorners.data() + firstStripCorner;
+	result.stripLengths.reserve(result.stripLengths.size() + stripCount);
+
+	// The primitive list ends with a zero flag (the section is padded with zeros) or with the end of the section.
+	while (reader.remaining() > 0) {
+		primitiveFlag = reader.readU8();
+		if (primitiveFlag == 0) {
+			break;
+		}
+
+		uint16_t primitiveObjectCount = reader.readU16();
+
+		switch (primitiveFlag & 0xF8) {
+		case 0x90: // Triangles
+		{
+			result.triangleListCount++;
+			size_t cornerCount = (primitiveObjectCount / 3) * 3; // Left over vertices are not read
+			const uint8_t *vertex = readVertices(reader, cornerCount, stride, padding);
+			for (size_t x = 0; x < cornerCount; x++, vertex += stride) {
+				Layout::read(vertex, format, *out++);
+			}
+		}
+		break;
+		case 0x98: // Triangle Strip
+		{
+			result.stripCount++;
+			const uint8_t *vertex = readVertices(reader, primitiveObjectCount, stride, padding);
+			if (primitiveObjectCount < 3) break;
+
+			if (stripMode == PrimitiveDecoder::KeepStrips) {
+				for (size_t x = 0; x < primitiveObjectCount; x++, vertex += stride) {
+					Layout::read(vertex, format, *stripOut++);
+				}
+				result.stripLengths.push_back(primitiveObjectCount);
+				break;
+			}
+
+			IndexTriplet previous2, previous1, corner;
+			Layout::read(vertex, format, previous2);
+			Layout::read(vertex + stride, format, previous1);
+			vertex += 2 * stride;
+			for (size_t x = 2; x < primitiveObjectCount; x++, vertex += stride, out += 3) {
+				Layout::read(vertex, format, corner);
+				// Every second triangle is flipped to keep the winding order
+				if (x % 2 != 0) {
+					out[0] = corner;
+					out[1] = previous1;
+					out[2] = previous2;
+				}
+				else {
+					out[0] = previous2;
+					out[1] = previous1;
+					out[2] = corner;
+				}
+				previous2 = previous1;
+				previous1 = corner;
+			}
+		}
+		break;
+		case 0xA0: // Triangle Fan
+		{
+			result.fanCount++;
+			// The center is read even if the fan is empty
+			size_t vertexCount = primitiveObjectCount > 0 ? primitiveObjectCount : 1;
+			const uint8_t *vertex = readVertices(reader, vertexCount, stride, padding);
+			if (vertexCount < 3) break;
+
+			IndexTriplet center, previous, corner;
+			Layout::read(vertex, format, center);
+			Layout::read(vertex + stride, format, previous);
+			vertex += 2 * stride;
+			for (size_t x = 2; x < vertexCount; x++, vertex += stride, out += 3) {
+				Layout::read(vertex, format, corner);
+				out[0] = center;
+				out[1] = previous;
+				out[2] = corner;
+				previous = corner;
+			}
+		}
+		break;
+		default: // This could already be the header of the next section...
+			return PrimitiveDecoder::UnknownPrimitive;
+		}
+	}
+	return PrimitiveDecoder::Finished;
+}
+
+struct SpecializedDecoder
+{
+	int bytesToSkip;
+	bool hasNormal;
+	int colorCount;
+	bool hasUv;
+	PrimitiveDecoder::DecodeFunction decodeFunction;
+};
+
+// The layouts found in the game files. Anything else falls back to the generic decoder.
+static const SpecializedDecoder specializedDecoders[] = {
+	{ 0, true, 0, true, &decodePrimitives<FixedLayout<0, true, 0, true> > },	// Position, normal, UV
+	{ 0, false, 0, true, &decodePrimitives<FixedLayout<0, false, 0, true> > },	// Position, UV
+	{ 0, true, 0, false, &decodePrimitives<FixedLayout<0, true, 0, false> > },	// Position, normal
+	{ 1, true, 0, true, &decodePrimitives<FixedLayout<1, true, 0, true> > },
+	{ 2, true, 0, true, &decodePrimitives<FixedLayout<2, true, 0, true> > },
+	{ 0, true, 1, true, &decodePrimitives<FixedLayout<0, true, 1, true> > },	// Position, normal, color, UV
+	{ 2, true, 1, true, &decodePrimitives<FixedLayout<2, true, 1, true> > },
+	{ 0, true, 2, true, &decodePrimitives<FixedLayout<0, true, 2, true> > }		// Position, normal, 2 colors, UV
+};
+
+
+PrimitiveDecoder::PrimitiveDecoder(const VertexFormat &format, StripMode stripMode /*= TriangulateStrips*/)
+	: format(format), stripMode(stripMode), decodeFunction(&decodePrimitives<GenericLayout>), specialized(false)
+{
+	for (size_t i = 0; i < sizeof(specializedDecoders) / sizeof(specializedDecoders[0]); i++) {
+		const SpecializedDecoder &decoder = specializedDecoders[i];
+		if (decoder.bytesToSkip == format.bytesToSkip && decoder.hasNormal == format.hasNormal && decoder.colorCount == format.colorCount && decoder.hasUv == (format.uvCount >= 1)) {
+			this->decodeFunction = decoder.decodeFunction;
+			this->specialized = true;
+			break;
+		}
+	}
+}
+
+PrimitiveDecoder::Result PrimitiveDecoder::decode(SpanReader &reader, Submesh &result, uint8_t &primitiveFlag) const
+{
+	return this->decodeFunction(reader, this->format, this->stripMode, result, primitiveFlag);
+}
+
+bool PrimitiveDecoder::isSpecialized() const
+{
+	return this->specialized;
+}
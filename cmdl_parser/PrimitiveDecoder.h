@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "VertexFormat.h"
+
+// Decodes the primitive list of a submesh section (triangle lists, strips and fans) into a triangle list.
+// The triangles are written straight into the index buffer of the submesh, which is sized once per section.
+// The common vertex layouts have their own instantiation of the decoding loop with every index offset known at
+// compile time, so reading an index doesn't branch on the format. All other layouts use a generic loop.
+class PrimitiveDecoder
+{
+public:
+	enum Result
+	{
+		Finished,			// Zero flag or end of the section
+		UnknownPrimitive	// The reader stands right behind the unknown primitive flag
+	};
+
+	enum StripMode
+	{
+		TriangulateStrips,	// Strips are turned into triangles like everything else
+		KeepStrips			// Strips go to Submesh::stripCorners, for writers that can output strips
+	};
+
+	typedef Result (*DecodeFunction)(SpanReader &reader, const VertexFormat &format, StripMode stripMode, Submesh &result, uint8_t &primitiveFlag);
+
+	// Picks the decoder for the format.
+	PrimitiveDecoder(const VertexFormat &format, StripMode stripMode = TriangulateStrips);
+
+	// Appends the triangles of all primitives to result.
+	// primitiveFlag receives the flag of the last primitive that was read.
+	Result decode(SpanReader &reader, Submesh &result, uint8_t &primitiveFlag) const;
+	bool isSpecialized() const;
+
+private:
+	VertexFormat format;
+	StripMode stripMode;
+	DecodeFunction decodeFunction;
+	bool specialized;
+};
@@ -0,0 +1,276 @@
+#include "SelfTest.h"
+#include "PrimitiveDecoder.h"
+#include "MappedFile.h"
+#include "ConversionStats.h"
+
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+
+// Material flags of the generated cases: every combination of leading bytes, normals, colors and uv sets, which
+// covers the specialized decoding loops and the generic one.
+static const uint32_t leadingBytes[] = { 0x00000000, 0x01000000, 0x03000000, 0x02000000 };
+static const uint32_t normalFlags[] = { 0x0, 0xC, 0x4 };
+static const uint32_t colorFlags[] = { 0x00, 0x30, 0xC0, 0xF0 };
+static const uint32_t uvFlags[] = { 0x0, 0x300, 0xF00, 0x3F00, 0x100 };
+
+static uint16_t readIndex(const uint8_t *vertex, size_t offset)
+{
+	return static_cast<uint16_t>((vertex[offset] << 8) | vertex[offset + 1]);
+}
+
+// One vertex the way the original converter read it: every index on its own. Bytes missing at the end of a
+// truncated section read as zero.
+static IndexTriplet readReferenceVertex(SpanReader &reader, const VertexFormat &format)
+{
+	uint8_t vertex[32] = { 0 };
+	size_t available = std::min(format.stride, reader.remaining());
+	reader.readRaw(vertex, available);
+	if (available < format.stride) reader.skip(format.stride);
+
+	IndexTriplet corner;
+	corner.pos = readIndex(vertex, format.positionOffset);
+	corner.norm = format.hasNormal ? readIndex(vertex, format.normalOffset) : 0;
+	corner.tex = (format.uvCount >= 1) ? readIndex(vertex, format.uvOffset) : 0;
+	return corner;
+}
+
+static void appendTriangle(std::vector<IndexTriplet> &triangles, const IndexTriplet &a, const IndexTriplet &b, const IndexTriplet &c)
+{
+	triangles.push_back(a);
+	triangles.push_back(b);
+	triangles.push_back(c);
+}
+
+static bool sameCorners(const IndexTriplet *a, const IndexTriplet *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (a[i].pos != b[i].pos || a[i].norm != b[i].norm || a[i].tex != b[i].tex) return false;
+	}
+	return true;
+}
+
+// Only checks the structure of the sequences, that is enough to find bytes that were copied through.
+static bool isUtf8(const std::string &text)
+{
+	for (size_t i = 0; i < text.length(); i++) {
+		unsigned char lead = static_cast<unsigned char>(text[i]);
+		size_t length = (lead < 0x80) ? 1 : (lead >= 0xC2 && lead <= 0xDF) ? 2 : (lead >= 0xE0 && lead <= 0xEF) ? 3 : (lead >= 0xF0 && lead <= 0xF4) ? 4 : 0;
+		if (length == 0 || i + length > text.length()) return false;
+		for (size_t c = 1; c < length; c++) {
+			if ((static_cast<unsigned char>(text[i + c]) & 0xC0) != 0x80) return false;
+		}
+		i += length - 1;
+	}
+	return true;
+}
+
+
+SelfTest::SelfTest(unsigned int caseCount, uint32_t seed, std::ostream &out)
+	: caseCount(caseCount), seed(seed), out(out)
+{
+}
+
+bool SelfTest::run()
+{
+	std::mt19937 generator(this->seed);
+	unsigned int failures = 0;
+	for (unsigned int i = 0; i < this->caseCount; i++) {
+		uint32_t flags = leadingBytes[generator() % 4] | normalFlags[generator() % 3] | colorFlags[generator() % 4] | uvFlags[generator() % 5];
+		VertexFormat format = VertexFormat::fromAttributeFlags(flags);
+
+		// Random primitives with random indices, the counts include the ones that make no triangle. Some lists end
+		// with a zero flag, some with an unknown primitive and some are cut off in the middle.
+		std::vector<uint8_t> data;
+		unsigned int primitiveCount = generator() % 8;
+		for (unsigned int p = 0; p < primitiveCount; p++) {
+			static const uint8_t primitiveTypes[] = { 0x90, 0x98, 0xA0 };
+			uint8_t primitiveFlag = static_cast<uint8_t>(primitiveTypes[generator() % 3] | (generator() % 8));
+			uint16_t count = static_cast<uint16_t>(generator() % 16);
+			data.push_back(primitiveFlag);
+			data.push_back(static_cast<uint8_t>(count >> 8));
+			data.push_back(static_cast<uint8_t>(count));
+			for (size_t b = 0; b < count * format.stride; b++) {
+				data.push_back(static_cast<uint8_t>(generator()));
+			}
+		}
+		switch (generator() % 4) {
+		case 0:
+			data.push_back(0);
+			break;
+		case 1:
+			data.push_back(0x33);
+			data.push_back(0);
+			data.push_back(3);
+			break;
+		case 2:
+			if (!data.empty()) data.resize(generator() % data.size());
+			break;
+		}
+
+		if (!this->checkPrimitives(i, flags, data, format)) {
+			if (++failures >= 10) break;
+		}
+	}
+
+	if (failures == 0) {
+		this->out << "Primitive decoding: " << this->caseCount << " cases match the reference" << std::endl;
+	}
+	bool statsValid = this->checkStatsJson();
+	return failures == 0 && statsValid;
+}
+
+bool SelfTest::checkPrimitives(unsigned int caseIndex, uint32_t flags, const std::vector<uint8_t> &data, const VertexFormat &format)
+{
+	ReferenceResult reference;
+	triangulateReference(data, format, reference);
+
+	static const PrimitiveDecoder::StripMode stripModes[] = { PrimitiveDecoder::TriangulateStrips, PrimitiveDecoder::KeepStrips };
+	for (int m = 0; m < 2; m++) {
+		const char *mode = (m == 0) ? "triangulated strips" : "kept strips";
+		SpanReader reader(ByteSpan(data.data(), data.size()));
+		Submesh submesh;
+		uint8_t primitiveFlag = 0;
+		PrimitiveDecoder decoder(format, stripModes[m]);
+		int result = decoder.decode(reader, submesh, primitiveFlag);
+
+		if (result != reference.result || primitiveFlag != reference.primitiveFlag) {
+			return this->fail(caseIndex, flags, mode, "the result or the last primitive flag differs");
+		}
+		if (reader.tell() != reference.end || reader.fail() != reference.failed) {
+			return this->fail(caseIndex, flags, mode, "the primitive list ends at a different offset");
+		}
+		if (submesh.triangleListCount != reference.triangleListCount || submesh.stripCount != reference.stripCount || submesh.fanCount != reference.fanCount) {
+			return this->fail(caseIndex, flags, mode, "the primitive counts differ");
+		}
+
+		// Same corners in the same order, so the winding is the same too
+		const std::vector<IndexTriplet> &triangles = (stripModes[m] == PrimitiveDecoder::KeepStrips) ? reference.otherTriangles : reference.triangles;
+		if (submesh.indices.size() != triangles.size() || !sameCorners(submesh.indices.data(), triangles.data(), triangles.size())) {
+			return this->fail(caseIndex, flags, mode, "the triangles differ");
+		}
+		if (stripModes[m] == PrimitiveDecoder::KeepStrips) {
+			if (submesh.stripCorners.size() != reference.stripCorners.size() || !sameCorners(submesh.stripCorners.data(), reference.stripCorners.data(), reference.stripCorners.size())
+				|| submesh.stripLengths.size() != reference.stripLengths.size() || !std::equal(reference.stripLengths.begin(), reference.stripLengths.end(), submesh.stripLengths.begin())) {
+				return this->fail(caseIndex, flags, mode, "the kept strips differ");
+			}
+		}
+		else if (!submesh.stripCorners.empty() || !submesh.stripLengths.empty()) {
+			return this->fail(caseIndex, flags, mode, "strips were kept");
+		}
+	}
+	return true;
+}
+
+// The primitive loop of the original converter, with the triangles collected instead of written to the OBJ file.
+void SelfTest::triangulateReference(const std::vector<uint8_t> &data, const VertexFormat &format, ReferenceResult &reference)
+{
+	reference.result = PrimitiveDecoder::Finished;
+	reference.primitiveFlag = 0;
+	reference.triangleListCount = reference.stripCount = reference.fanCount = 0;
+
+	SpanReader reader(ByteSpan(data.data(), data.size()));
+	std::vector<IndexTriplet> corners;
+	while (reader.remaining() > 0) {
+		uint8_t primitiveFlag = reader.readU8();
+		reference.primitiveFlag = primitiveFlag;
+		if (primitiveFlag == 0) {
+			break;
+		}
+		uint16_t primitiveObjectCount = reader.readU16();
+
+		switch (primitiveFlag & 0xF8) {
+		case 0x90: // Triangles
+			reference.triangleListCount++;
+			for (int x = 0; x < primitiveObjectCount / 3; x++) {
+				for (int y = 0; y < 3; y++) {
+					IndexTriplet corner = readReferenceVertex(reader, format);
+					reference.triangles.push_back(corner);
+					reference.otherTriangles.push_back(corner);
+				}
+			}
+			break;
+		case 0x98: // Triangle Strip
+			reference.stripCount++;
+			corners.clear();
+			for (unsigned int x = 0; x < primitiveObjectCount; x++) {
+				corners.push_back(readReferenceVertex(reader, format));
+			}
+			for (size_t x = 2; x < corners.size(); x++) {
+				if (x % 2 != 0) appendTriangle(reference.triangles, corners[x], corners[x - 1], corners[x - 2]);
+				else appendTriangle(reference.triangles, corners[x - 2], corners[x - 1], corners[x]);
+			}
+			if (corners.size() >= 3) {
+				reference.stripCorners.insert(reference.stripCorners.end(), corners.begin(), corners.end());
+				reference.stripLengths.push_back(static_cast<uint32_t>(corners.size()));
+			}
+			break;
+		case 0xA0: // Triangle Fan
+		{
+			reference.fanCount++;
+			IndexTriplet center = readReferenceVertex(reader, format);
+			corners.clear();
+			for (unsigned int u = 1; u < primitiveObjectCount; u++) {
+				corners.push_back(readReferenceVertex(reader, format));
+			}
+			for (size_t l = 1; l < corners.size(); l++) {
+				appendTriangle(reference.triangles, center, corners[l - 1], corners[l]);
+				appendTriangle(reference.otherTriangles, center, corners[l - 1], corners[l]);
+			}
+		}
+		break;
+		default:
+			reference.result = PrimitiveDecoder::UnknownPrimitive;
+			reference.end = reader.tell();
+			reference.failed = reader.fail();
+			return;
+		}
+	}
+	reference.end = reader.tell();
+	reference.failed = reader.fail();
+}
+
+bool SelfTest::checkStatsJson()
+{
+	// 0xFC is a letter in most ANSI code pages (u with an umlaut in Windows-1252), 0x81 isn't one in Windows-1252, so the
+	// second name can't be converted and its bytes have to be escaped.
+	static const char *const inputFiles[] = { "models/T\xFCr.CMDL", "models/\x81\xFC.CMDL" };
+	ConversionStats stats;
+	for (size_t i = 0; i < 2; i++) {
+		FileStats file;
+		file.inputFile = inputFiles[i];
+		file.error = std::string("Opening CMDL File failed: ") + inputFiles[i];
+		stats.addFile(file);
+	}
+
+	const char *fileName = "selftest_stats.json";
+	bool written = stats.writeJson(fileName, 0.0);
+	std::ifstream json(fileName, std::ifstream::binary);
+	std::stringstream text;
+	text << json.rdbuf();
+	json.close();
+	remove(fileName);
+
+	if (!written) {
+		this->out << "Stats JSON: " << fileName << " could not be written" << std::endl;
+		return false;
+	}
+	if (!isUtf8(text.str()) || text.str().find("r.CMDL") == std::string::npos) {
+		this->out << "Stats JSON: a file name that isn't ASCII doesn't end up as UTF-8" << std::endl;
+		return false;
+	}
+	this->out << "Stats JSON: file names that aren't ASCII are written as UTF-8" << std::endl;
+	return true;
+}
+
+bool SelfTest::fail(unsigned int caseIndex, uint32_t flags, const char *mode, const char *what)
+{
+	char text[160];
+	sprintf_s(text, sizeof(text), "Primitive decoding, case %u (flags %08X, %s): %s", caseIndex, flags, mode, what);
+	this->out << text << std::endl;
+	return false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "VertexFormat.h"
+
+// Checks the optimized decoders against plain reference implementations on generated data (-selftest), so a change
+// to them can be verified without game data.
+class SelfTest
+{
+public:
+	SelfTest(unsigned int caseCount, uint32_t seed, std::ostream &out);
+
+	// Returns false if any case differs.
+	bool run();
+
+private:
+	// What the reference triangulator read from a primitive list
+	struct ReferenceResult
+	{
+		int result;						// PrimitiveDecoder::Result
+		uint8_t primitiveFlag;
+		size_t end;						// Reader position afterwards
+		bool failed;					// The list ran past the end of the data
+		std::vector<IndexTriplet> triangles;		// All triangles in file order, strips triangulated
+		std::vector<IndexTriplet> otherTriangles;	// The triangles of the lists and fans only
+		std::vector<IndexTriplet> stripCorners;		// The strips with at least 3 corners, as they are in the file
+		std::vector<uint32_t> stripLengths;
+		uint32_t triangleListCount;
+		uint32_t stripCount;
+		uint32_t fanCount;
+	};
+
+	// PrimitiveDecoder with both strip modes against the triangulation of the original converter.
+	bool checkPrimitives(unsigned int caseIndex, uint32_t flags, const std::vector<uint8_t> &data, const VertexFormat &format);
+	static void triangulateReference(const std::vector<uint8_t> &data, const VertexFormat &format, ReferenceResult &reference);
+	bool fail(unsigned int caseIndex, uint32_t flags, const char *mode, const char *what);
+	// The -stats file has to be UTF-8 whatever bytes the file names hold.
+	bool checkStatsJson();
+
+private:
+	unsigned int caseCount;
+	uint32_t seed;
+	std::ostream &out;
+};
@@ -0,0 +1,44 @@
+#include "Stopwatch.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+
+// The frequency is fixed at boot, so it is read once before main runs.
+static double querySecondsPerTick()
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return 1.0 / static_cast<double>(frequency.QuadPart);
+}
+
+static const double secondsPerTick = querySecondsPerTick();
+
+
+Stopwatch::Stopwatch()
+	: startTicks(getTicks())
+{
+}
+
+void Stopwatch::restart()
+{
+	this->startTicks = getTicks();
+}
+
+double Stopwatch::getSeconds() const
+{
+	return ticksToSeconds(getTicks() - this->startTicks);
+}
+
+int64_t Stopwatch::getTicks()
+{
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return ticks.QuadPart;
+}
+
+double Stopwatch::ticksToSeconds(int64_t ticks)
+{
+	return static_cast<double>(ticks) * secondsPerTick;
+}
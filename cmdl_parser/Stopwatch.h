@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// Measures wall time with the high resolution performance counter.
+class Stopwatch
+{
+public:
+	// Starts right away.
+	Stopwatch();
+
+	void restart();
+	double getSeconds() const;
+
+	static int64_t getTicks();
+	static double ticksToSeconds(int64_t ticks);
+
+private:
+	int64_t startTicks;
+};
@@ -0,0 +1,245 @@
+#include "SyntheticData.h"
+
+#include <fstream>
+#include <random>
+#include <string.h>
+
+
+// Vertex attribute layouts (material flags) and the primitive vertex they describe.
+struct VertexLayout
+{
+	uint32_t flags;
+	int bytesToSkip;
+	bool hasNormal;
+	int colorCount;
+	bool hasUv;
+};
+
+static const VertexLayout vertexLayouts[] = {
+	{ 0x0000030F, 0, true, 0, true },
+	{ 0x00000303, 0, false, 0, true },
+	{ 0x0100030F, 1, true, 0, true },
+	{ 0x0300033F, 2, true, 1, true },
+	{ 0x0000000F, 0, true, 0, false },
+	{ 0x000003FF, 0, true, 2, true }
+};
+static const size_t vertexLayoutCount = sizeof(vertexLayouts) / sizeof(vertexLayouts[0]);
+
+static void appendU8(std::vector<uint8_t> &data, uint8_t value)
+{
+	data.push_back(value);
+}
+
+static void appendU16(std::vector<uint8_t> &data, uint16_t value)
+{
+	data.push_back(static_cast<uint8_t>(value >> 8));
+	data.push_back(static_cast<uint8_t>(value));
+}
+
+static void appendU32(std::vector<uint8_t> &data, uint32_t value)
+{
+	appendU16(data, static_cast<uint16_t>(value >> 16));
+	appendU16(data, static_cast<uint16_t>(value));
+}
+
+static void appendU64(std::vector<uint8_t> &data, uint64_t value)
+{
+	appendU32(data, static_cast<uint32_t>(value >> 32));
+	appendU32(data, static_cast<uint32_t>(value));
+}
+
+static void appendFloat(std::vector<uint8_t> &data, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendU32(data, bits);
+}
+
+static void appendTag(std::vector<uint8_t> &data, const char *tag)
+{
+	data.insert(data.end(), tag, tag + 4);
+}
+
+static void appendZeros(std::vector<uint8_t> &data, size_t count)
+{
+	data.insert(data.end(), count, 0);
+}
+
+// Sections are padded to 32 bytes
+static void padSection(std::vector<uint8_t> &section)
+{
+	appendZeros(section, (32 - section.size() % 32) % 32);
+}
+
+static std::vector<uint8_t> generateMaterials(const SyntheticData::ModelParameters &parameters)
+{
+	std::vector<uint8_t> section;
+	appendU32(section, static_cast<uint32_t>(parameters.textureIds.size()));
+	for (size_t i = 0; i < parameters.textureIds.size(); i++) {
+		std::vector<uint8_t> material;
+		appendZeros(material, 12);
+		appendU32(material, vertexLayouts[i % vertexLayoutCount].flags);
+		appendZeros(material, 12);
+
+		appendTag(material, "PASS");
+		appendU32(material, 24);
+		appendTag(material, "DIFF");
+		appendU32(material, 0);
+		appendU64(material, parameters.textureIds[i]);
+		appendU32(material, 0);
+		appendU32(material, 0);
+
+		if (i % 2 == 0) {
+			appendTag(material, "CLR ");
+			appendTag(material, "DIFB");
+			appendU32(material, 0xFF8040FF);
+			appendTag(material, "INT ");
+			appendTag(material, "OPAC");
+			appendU32(material, 0x80);
+		}
+		appendTag(material, "END ");
+
+		appendU32(section, static_cast<uint32_t>(material.size()));
+		section.insert(section.end(), material.begin(), material.end());
+	}
+	return section;
+}
+
+std::vector<uint8_t> SyntheticData::generateCmdl(const ModelParameters &parameters)
+{
+	std::mt19937 generator(parameters.seed);
+	uint32_t positionCount = parameters.vertexCount < 3 ? 3 : (parameters.vertexCount > 0x10000 ? 0x10000 : parameters.vertexCount);
+	uint32_t normalCount = positionCount / 2 + 1;
+	uint32_t uvCount = positionCount / 3 + 1;
+
+	std::vector<std::vector<uint8_t> > sections;
+	sections.push_back(generateMaterials(parameters));
+
+	// Positions
+	std::vector<uint8_t> positions;
+	std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+	for (uint32_t i = 0; i < positionCount * 3; i++) {
+		if (parameters.quantizedPositions) {
+			appendU16(positions, static_cast<uint16_t>(generator()));
+		}
+		else {
+			appendFloat(positions, coordinate(generator));
+		}
+	}
+	sections.push_back(positions);
+
+	// Normals, 1.0 is 0x4000
+	std::vector<uint8_t> normals;
+	std::uniform_int_distribution<int> normalComponent(-0x4000, 0x4000);
+	for (uint32_t i = 0; i < normalCount * 3; i++) {
+		appendU16(normals, static_cast<uint16_t>(normalComponent(generator)));
+	}
+	sections.push_back(normals);
+
+	// Sections 3 and 4 are not decoded
+	sections.push_back(std::vector<uint8_t>(40, 0x11));
+	sections.push_back(std::vector<uint8_t>());
+
+	std::vector<uint8_t> uvs;
+	for (uint32_t i = 0; i < uvCount * 2; i++) {
+		appendU16(uvs, static_cast<uint16_t>(generator()));
+	}
+	sections.push_back(uvs);
+
+	// Section 6 is not decoded
+	sections.push_back(std::vector<uint8_t>(8, 0x22));
+
+	// Submeshes
+	size_t materialCount = parameters.textureIds.size(); // Submeshes need a material
+	for (uint32_t s = 0; s < parameters.submeshCount && materialCount > 0; s++) {
+		std::vector<uint8_t> submesh(0x1A, 0x33);
+		uint16_t materialIndex = static_cast<uint16_t>(generator() % materialCount);
+		const VertexLayout &layout = vertexLayouts[materialIndex % vertexLayoutCount];
+		appendU16(submesh, materialIndex);
+		appendU16(submesh, static_cast<uint16_t>(parameters.visibilityGroups ? s % 2 : 0)); // Visibility group
+		appendU16(submesh, static_cast<uint16_t>(s));
+
+		for (uint32_t p = 0; p < parameters.primitivesPerSubmesh; p++) {
+			// 0x90 triangles, 0x98 strip, 0xA0 fan
+			static const uint8_t primitiveTypes[] = { 0x90, 0x98, 0xA0 };
+			uint8_t primitiveType = primitiveTypes[generator() % 3];
+			uint16_t cornerCount = (primitiveType == 0x90) ? static_cast<uint16_t>(3 * (1 + generator() % 8)) : static_cast<uint16_t>(3 + generator() % 30);
+
+			appendU8(submesh, primitiveType);
+			appendU16(submesh, cornerCount);
+			for (uint16_t c = 0; c < cornerCount; c++) {
+				appendZeros(submesh, layout.bytesToSkip);
+				appendU16(submesh, static_cast<uint16_t>(generator() % positionCount));
+				if (layout.hasNormal) appendU16(submesh, static_cast<uint16_t>(generator() % normalCount));
+				appendZeros(submesh, 2 * layout.colorCount);
+				if (layout.hasUv) appendU16(submesh, static_cast<uint16_t>(generator() % uvCount));
+			}
+		}
+		sections.push_back(submesh); // The zero padding ends the primitive list
+	}
+
+	std::vector<uint8_t> file;
+	appendU32(file, 0xDEADBABE);
+	appendU32(file, (parameters.quantizedPositions ? 0x20 : 0) | (parameters.visibilityGroups ? 0x10 : 0));
+	// Bounding box
+	appendFloat(file, -100.0f);
+	appendFloat(file, -100.0f);
+	appendFloat(file, -100.0f);
+	appendFloat(file, 100.0f);
+	appendFloat(file, 100.0f);
+	appendFloat(file, 100.0f);
+	appendU32(file, static_cast<uint32_t>(sections.size()));
+	appendU32(file, 1); // Material sets
+
+	if (parameters.visibilityGroups) {
+		static const char *groupNames[] = { "GroupA", "Second" };
+		appendU32(file, 0);
+		appendU32(file, 2);
+		for (int i = 0; i < 2; i++) {
+			appendU32(file, static_cast<uint32_t>(strlen(groupNames[i])));
+			file.insert(file.end(), groupNames[i], groupNames[i] + strlen(groupNames[i]));
+		}
+		appendZeros(file, 20);
+	}
+
+	for (size_t i = 0; i < sections.size(); i++) {
+		padSection(sections[i]);
+		appendU32(file, static_cast<uint32_t>(sections[i].size()));
+	}
+	// The header is padded with 1 to 32 bytes
+	appendZeros(file, 32 - file.size() % 32);
+
+	for (size_t i = 0; i < sections.size(); i++) {
+		file.insert(file.end(), sections[i].begin(), sections[i].end());
+	}
+	return file;
+}
+
+std::vector<uint8_t> SyntheticData::generateTxtr(uint16_t width, uint16_t height, uint32_t mipCount, uint32_t seed)
+{
+	std::mt19937 generator(seed);
+	std::vector<uint8_t> file;
+	appendU32(file, 0xA); // CMPR
+	appendU16(file, width);
+	appendU16(file, height);
+	appendU32(file, mipCount);
+
+	for (uint32_t i = 0; i < mipCount; i++) {
+		uint32_t blocksWide = ((width >> i > 1 ? width >> i : 1) + 3) / 4;
+		uint32_t blocksHigh = ((height >> i > 1 ? height >> i : 1) + 3) / 4;
+		size_t mipSize = static_cast<size_t>((blocksWide + 1) / 2) * ((blocksHigh + 1) / 2) * 32;
+		for (size_t b = 0; b < mipSize; b += 4) {
+			appendU32(file, static_cast<uint32_t>(generator()));
+		}
+	}
+	return file;
+}
+
+bool SyntheticData::writeFile(const std::string &fileName, const std::vector<uint8_t> &data)
+{
+	std::ofstream file(fileName, std::ofstream::binary);
+	if (!file.is_open()) return false;
+	file.write(reinterpret_cast<const char *>(data.data()), data.size());
+	file.close();
+	return !file.fail();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Generates CMDL and TXTR files with the same structure as the game files, filled with random data.
+// They make it possible to test and measure the converter without any copyrighted data.
+class SyntheticData
+{
+public:
+	struct ModelParameters
+	{
+		uint32_t vertexCount;			// Positions, at most 65536 (the indices are 16-bit)
+		uint32_t submeshCount;
+		uint32_t primitivesPerSubmesh;
+		bool quantizedPositions;		// Header flag 0x20
+		bool visibilityGroups;			// Header flag 0x10
+		std::vector<uint64_t> textureIds; // One material per texture id
+		uint32_t seed;
+
+		ModelParameters() : vertexCount(20000), submeshCount(32), primitivesPerSubmesh(200), quantizedPositions(false), visibilityGroups(false), seed(1) {}
+	};
+
+	// A CMDL file. The materials cycle through all known vertex attribute layouts and the submeshes mix
+	// triangle lists, strips and fans.
+	static std::vector<uint8_t> generateCmdl(const ModelParameters &parameters);
+	// A CMPR TXTR file with mipCount mips, every mip padded to whole 8x8 tiles like on the GX.
+	static std::vector<uint8_t> generateTxtr(uint16_t width, uint16_t height, uint32_t mipCount, uint32_t seed);
+
+	static bool writeFile(const std::string &fileName, const std::vector<uint8_t> &data);
+};
@@ -0,0 +1,336 @@
+#include "TextureAtlas.h"
+#include "ConversionCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+
+
+static const uint32_t DxtFormat = 0xA;	// TXTR format of the textures convertTXTRtoDDS understands
+static const size_t DdsHeaderSize = 128;
+static const size_t BlockSize = 8;		// Bytes of a 4x4 DXT1 block
+
+// Owners of a uv in TextureAtlas::apply()
+static const uint64_t NoOwner = 0;
+static const uint64_t StaysOwner = ~0ULL;		// Used by a submesh that isn't moved
+static const uint64_t SharedOwner = ~0ULL - 1;	// Used by submeshes with different textures
+static const uint32_t NoCopy = 0xFFFFFFFF;
+
+struct PackItem
+{
+	uint64_t textureId;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Highest first, so every shelf is filled with textures of about the same height
+static bool packOrder(const PackItem &a, const PackItem &b)
+{
+	if (a.height != b.height) return a.height > b.height;
+	if (a.width != b.width) return a.width > b.width;
+	return a.textureId < b.textureId;
+}
+
+// The texture repeats unless every uv of the submesh lies inside it. v is flipped, so it runs from -1 to 0.
+static bool hasUnitUvs(const Mesh &mesh, const Submesh &submesh)
+{
+	for (int list = 0; list < 2; list++) {
+		const ArenaVector<IndexTriplet> &corners = (list == 0) ? submesh.indices : submesh.stripCorners;
+		for (size_t c = 0; c < corners.size(); c++) {
+			unsigned short tex = corners[c].tex;
+			if (tex >= mesh.uvs.size()) return false;
+			float u = mesh.uvs.u[tex], v = mesh.uvs.v[tex];
+			if (!(u >= 0.0f && u <= 1.0f && v >= -1.0f && v <= 0.0f)) return false;
+		}
+	}
+	return true;
+}
+
+// Which submeshes use every uv: the texture of the submeshes that move, StaysOwner or SharedOwner.
+// Indices past the end of the uvs aren't owned, the writers give them default uvs.
+static void findUvOwners(const Mesh &mesh, const std::vector<uint64_t> &submeshTextures, std::vector<uint64_t> &owners)
+{
+	owners.assign(mesh.uvs.size(), NoOwner);
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const Submesh &submesh = mesh.submeshes[s];
+		if (!submesh.hasUvs) continue;
+		uint64_t owner = (submeshTextures[s] != 0) ? submeshTextures[s] : StaysOwner;
+		for (int list = 0; list < 2; list++) {
+			const ArenaVector<IndexTriplet> &corners = (list == 0) ? submesh.indices : submesh.stripCorners;
+			for (size_t c = 0; c < corners.size(); c++) {
+				if (corners[c].tex >= owners.size()) continue;
+				uint64_t &uvOwner = owners[corners[c].tex];
+				if (uvOwner == NoOwner) uvOwner = owner;
+				else if (uvOwner != owner) uvOwner = SharedOwner;
+			}
+		}
+	}
+}
+
+
+TextureAtlas::TextureAtlas(const std::string &textureDir)
+	: textureDir(textureDir)
+{
+}
+
+bool TextureAtlas::isAtlasTexture(uint64_t textureId)
+{
+	return textureId >= AtlasIdBase && textureId - AtlasIdBase < 0x100000000ULL;
+}
+
+uint64_t TextureAtlas::getAtlasCandidate(const Material &material)
+{
+	uint64_t textureId = 0;
+	const ArenaVector<MaterialPass> &passes = material.getPasses();
+	for (size_t i = 0; i < passes.size(); i++) {
+		if (passes[i].textureId == 0) continue;
+		if (textureId != 0) return 0;
+		textureId = passes[i].textureId;
+	}
+	return textureId;
+}
+
+void TextureAtlas::build(const std::vector<uint64_t> &textureIds, AssetSource &source, std::ostream &log)
+{
+	this->placements.clear();
+	this->atlasHeights.clear();
+
+	std::vector<PackItem> items;
+	Asset txtrFile;
+	std::string error;
+	for (size_t i = 0; i < textureIds.size(); i++) {
+		// Textures that can't be read are reported by their conversion
+		if (textureIds[i] == 0 || !source.load(textureIds[i], txtrFile, error)) continue;
+		SpanReader header(txtrFile.span());
+		PackItem item;
+		item.textureId = textureIds[i];
+		uint32_t format = header.readU32();
+		item.width = header.readU16();
+		item.height = header.readU16();
+		if (header.fail() || format != DxtFormat) continue;
+		// Whole blocks only, so the blocks can be copied as they are
+		if (item.width == 0 || item.height == 0 || item.width % 4 != 0 || item.height % 4 != 0) continue;
+		if (item.width > MaxTextureSize || item.height > MaxTextureSize) continue;
+		items.push_back(item);
+	}
+	std::sort(items.begin(), items.end(), packOrder);
+
+	// Shelves from top to bottom, filled from left to right
+	uint32_t x = 0, shelfY = 0, shelfHeight = 0;
+	for (size_t i = 0; i < items.size(); i++) {
+		const PackItem &item = items[i];
+		if (this->placements.count(item.textureId) != 0) continue;
+		uint32_t slotWidth = item.width + 2 * Gutter;
+		uint32_t slotHeight = item.height + 2 * Gutter;
+		if (x + slotWidth > AtlasSize) {
+			shelfY += shelfHeight;
+			x = 0;
+			shelfHeight = 0;
+		}
+		if (this->atlasHeights.empty() || shelfY + slotHeight > AtlasSize) {
+			this->atlasHeights.push_back(0);
+			x = shelfY = shelfHeight = 0;
+		}
+
+		AtlasPlacement placement;
+		placement.atlasIndex = static_cast<uint32_t>(this->atlasHeights.size() - 1);
+		placement.x = x + Gutter;
+		placement.y = shelfY + Gutter;
+		placement.width = item.width;
+		placement.height = item.height;
+		this->placements.insert(std::make_pair(item.textureId, placement));
+
+		x += slotWidth;
+		shelfHeight = std::max(shelfHeight, slotHeight);
+		this->atlasHeights.back() = std::max(this->atlasHeights.back(), shelfY + slotHeight);
+	}
+
+	log << "Atlas: " << this->placements.size() << " of " << textureIds.size() << " textures in " << this->atlasHeights.size() << " atlases" << std::endl;
+}
+
+bool TextureAtlas::find(uint64_t textureId, AtlasPlacement &placement) const
+{
+	std::unordered_map<uint64_t, AtlasPlacement>::const_iterator found = this->placements.find(textureId);
+	if (found == this->placements.end()) return false;
+	placement = found->second;
+	return true;
+}
+
+size_t TextureAtlas::getAtlasCount() const
+{
+	return this->atlasHeights.size();
+}
+
+size_t TextureAtlas::getTextureCount() const
+{
+	return this->placements.size();
+}
+
+size_t TextureAtlas::apply(Mesh &mesh, std::ostream &log) const
+{
+	if (this->placements.empty() || mesh.uvs.size() == 0) return 0;
+
+	// The texture every submesh moves to, 0 if it stays
+	std::vector<uint64_t> submeshTextures(mesh.submeshes.size(), 0);
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		const Submesh &submesh = mesh.submeshes[s];
+		if (!submesh.hasUvs || submesh.materialIndex >= mesh.materials.size()) continue;
+		uint64_t textureId = getAtlasCandidate(*mesh.materials[submesh.materialIndex]);
+		if (textureId != 0 && this->placements.count(textureId) != 0 && hasUnitUvs(mesh, submesh)) {
+			submeshTextures[s] = textureId;
+		}
+	}
+
+	// UVs used by the submeshes of one texture only are moved in place, the others are copied. A submesh that can't
+	// move keeps its UVs, which turns them into shared ones for the others, so which submeshes move is settled
+	// before anything is changed.
+	size_t uvCount = mesh.uvs.size();
+	std::vector<uint64_t> owners;
+	std::vector<uint32_t> copies;
+	std::vector<char> needsMaterial(mesh.materials.size(), 0);
+	bool settled = false;
+	while (!settled) {
+		findUvOwners(mesh, submeshTextures, owners);
+		settled = true;
+		size_t uvTotal = uvCount, materialTotal = mesh.materials.size();
+		needsMaterial.assign(mesh.materials.size(), 0);
+		for (size_t s = 0; s < mesh.submeshes.size() && settled; s++) {
+			uint64_t textureId = submeshTextures[s];
+			if (textureId == 0) continue;
+			const Submesh &submesh = mesh.submeshes[s];
+
+			// The copies have to fit into 16-bit indices
+			copies.assign(uvCount, NoCopy);
+			size_t copyCount = 0;
+			for (int list = 0; list < 2; list++) {
+				const ArenaVector<IndexTriplet> &corners = (list == 0) ? submesh.indices : submesh.stripCorners;
+				for (size_t c = 0; c < corners.size(); c++) {
+					unsigned short tex = corners[c].tex;
+					if (owners[tex] != textureId && copies[tex] == NoCopy) {
+						copies[tex] = 0;
+						copyCount++;
+					}
+				}
+			}
+			if (uvTotal + copyCount > 0x10000) {
+				log << "Section " << submesh.sectionIndex << " keeps its texture, the mesh has too many UVs for the atlas" << std::endl;
+				submeshTextures[s] = 0;
+				settled = false;
+				continue;
+			}
+			if (!needsMaterial[submesh.materialIndex]) {
+				if (materialTotal >= 0xFFFF) {
+					log << "Section " << submesh.sectionIndex << " keeps its texture, the mesh has too many materials" << std::endl;
+					submeshTextures[s] = 0;
+					settled = false;
+					continue;
+				}
+				needsMaterial[submesh.materialIndex] = 1;
+				materialTotal++;
+			}
+			uvTotal += copyCount;
+		}
+	}
+
+	std::vector<char> moved(uvCount, 0);
+	std::vector<int> atlasMaterials(mesh.materials.size(), -1);
+	size_t movedSubmeshes = 0;
+	for (size_t s = 0; s < mesh.submeshes.size(); s++) {
+		uint64_t textureId = submeshTextures[s];
+		if (textureId == 0) continue;
+		Submesh &submesh = mesh.submeshes[s];
+		const AtlasPlacement &placement = this->placements.find(textureId)->second;
+
+		int &atlasMaterial = atlasMaterials[submesh.materialIndex];
+		if (atlasMaterial < 0) {
+			const Material &material = *mesh.materials[submesh.materialIndex];
+			ArenaPtr<Material> atlased = makeArenaObject<Material>(mesh.getArena(), material);
+			const ArenaVector<MaterialPass> &passes = material.getPasses();
+			for (size_t p = 0; p < passes.size(); p++) {
+				if (passes[p].textureId == textureId) atlased->setPassTexture(p, AtlasIdBase + placement.atlasIndex);
+			}
+			atlased->setMaterialName(material.getMaterialName() + "_atlas");
+			atlasMaterial = static_cast<int>(mesh.materials.size());
+			mesh.materials.push_back(std::move(atlased));
+		}
+
+		// u runs from left to right, -v from top to bottom, in the texture and in the atlas.
+		float uScale = static_cast<float>(placement.width) / AtlasSize;
+		float uBias = static_cast<float>(placement.x) / AtlasSize;
+		float atlasHeight = static_cast<float>(this->atlasHeights[placement.atlasIndex]);
+		float vScale = placement.height / atlasHeight;
+		float vBias = -(placement.y / atlasHeight);
+		copies.assign(uvCount, NoCopy);
+		for (int list = 0; list < 2; list++) {
+			ArenaVector<IndexTriplet> &corners = (list == 0) ? submesh.indices : submesh.stripCorners;
+			for (size_t c = 0; c < corners.size(); c++) {
+				unsigned short tex = corners[c].tex;
+				if (owners[tex] == textureId) {
+					if (!moved[tex]) {
+						mesh.uvs.u[tex] = mesh.uvs.u[tex] * uScale + uBias;
+						mesh.uvs.v[tex] = mesh.uvs.v[tex] * vScale + vBias;
+						moved[tex] = 1;
+					}
+					continue;
+				}
+				if (copies[tex] == NoCopy) {
+					copies[tex] = static_cast<uint32_t>(mesh.uvs.size());
+					mesh.uvs.u.push_back(mesh.uvs.u[tex] * uScale + uBias);
+					mesh.uvs.v.push_back(mesh.uvs.v[tex] * vScale + vBias);
+				}
+				corners[c].tex = static_cast<unsigned short>(copies[tex]);
+			}
+		}
+		submesh.materialIndex = static_cast<uint16_t>(atlasMaterial);
+		movedSubmeshes++;
+	}
+	return movedSubmeshes;
+}
+
+bool TextureAtlas::writeAtlases(std::ostream &log) const
+{
+	bool success = true;
+	for (uint32_t a = 0; a < this->atlasHeights.size(); a++) {
+		std::vector<uint8_t> blocks(static_cast<size_t>(AtlasSize / 4) * (this->atlasHeights[a] / 4) * BlockSize, 0);
+		for (std::unordered_map<uint64_t, AtlasPlacement>::const_iterator texture = this->placements.begin(); texture != this->placements.end(); ++texture) {
+			if (texture->second.atlasIndex == a) this->copyTexture(texture->first, texture->second, blocks, log);
+		}
+
+		std::string fileName = this->textureDir + "dds/" + ConversionCache::getTextureFileName(AtlasIdBase + a, ".dds");
+		std::ofstream ddsFile(fileName, std::ofstream::binary);
+		Material::writeDdsHeader(ddsFile, AtlasSize, this->atlasHeights[a], 1);
+		ddsFile.write(reinterpret_cast<const char *>(blocks.data()), blocks.size());
+		ddsFile.close();
+		if (ddsFile.fail()) {
+			log << "Failed to write " << fileName << std::endl;
+			success = false;
+		}
+	}
+	return success;
+}
+
+bool TextureAtlas::copyTexture(uint64_t textureId, const AtlasPlacement &placement, std::vector<uint8_t> &atlasBlocks, std::ostream &log) const
+{
+	std::string fileName = this->textureDir + "dds/" + ConversionCache::getTextureFileName(textureId, ".dds");
+	int blocksWide = placement.width / 4;
+	int blocksHigh = placement.height / 4;
+	MappedFile ddsFile;
+	if (!ddsFile.open(fileName) || ddsFile.span().size() < DdsHeaderSize + static_cast<size_t>(blocksWide) * blocksHigh * BlockSize) {
+		log << "Warning: " << fileName << " is missing, its part of the atlas stays black" << std::endl;
+		return false;
+	}
+
+	// The first mip, with the edge blocks repeated into the gutter
+	const uint8_t *source = ddsFile.span().data() + DdsHeaderSize;
+	int firstX = static_cast<int>(placement.x / 4);
+	int firstY = static_cast<int>(placement.y / 4);
+	for (int y = -1; y <= blocksHigh; y++) {
+		int sourceY = std::min(std::max(y, 0), blocksHigh - 1);
+		for (int x = -1; x <= blocksWide; x++) {
+			int sourceX = std::min(std::max(x, 0), blocksWide - 1);
+			size_t block = static_cast<size_t>(firstY + y) * (AtlasSize / 4) + (firstX + x);
+			memcpy(&atlasBlocks[block * BlockSize], source + (sourceY * blocksWide + sourceX) * BlockSize, BlockSize);
+		}
+	}
+	return true;
+}
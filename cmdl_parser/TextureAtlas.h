@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "AssetSource.h"
+
+// Where a texture lies in an atlas, in texels
+struct AtlasPlacement
+{
+	uint32_t atlasIndex;
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Packs the small DXT1 textures of a batch into atlases (-atlas), so a renderer can draw the submeshes of many materials
+// in one go. The layout is made from the TXTR headers before the models are converted; the models then get their UVs
+// moved into the atlas, and once all textures are converted the atlases are copied together from the DDS files block by
+// block, without recompressing. Atlases have no mips.
+// Atlases are textures like any other: atlas i has the texture id AtlasIdBase + i and is written to dds/<id>.dds.
+class TextureAtlas
+{
+public:
+	static const uint32_t AtlasSize = 2048;		// Width and maximum height
+	static const uint32_t MaxTextureSize = 512;	// Bigger textures stay on their own
+	static const uint32_t Gutter = 4;			// One block of repeated edge texels around every texture against bleeding
+	static const uint64_t AtlasIdBase = 0xA71A500000000000ULL;
+
+	// textureDir holds the dds/ directory, with trailing slash.
+	explicit TextureAtlas(const std::string &textureDir);
+
+	static bool isAtlasTexture(uint64_t textureId);
+	// The texture of a material that can be moved into an atlas: the only pass with a texture. Other textured passes
+	// would share the UVs and break. Returns 0 if there is none.
+	static uint64_t getAtlasCandidate(const Material &material);
+
+	// Packs the textures that are DXT1 and at most MaxTextureSize in both directions. Only reads the TXTR headers,
+	// from the source.
+	void build(const std::vector<uint64_t> &textureIds, AssetSource &source, std::ostream &log);
+	bool find(uint64_t textureId, AtlasPlacement &placement) const;
+	size_t getAtlasCount() const;
+	size_t getTextureCount() const;
+
+	// Moves the UVs of every submesh whose texture is in an atlas into the atlas and gives the submesh a copy of its
+	// material that uses the atlas. Submeshes with UVs outside of 0..1 repeat their texture and are left alone.
+	// Returns the number of moved submeshes.
+	size_t apply(Mesh &mesh, std::ostream &log) const;
+
+	// Writes the atlases. The DDS files of the packed textures have to be complete.
+	bool writeAtlases(std::ostream &log) const;
+
+private:
+	TextureAtlas(const TextureAtlas &) = delete;
+	TextureAtlas &operator=(const TextureAtlas &) = delete;
+
+	// Copies the blocks of one texture and its gutter into the blocks of the atlas.
+	bool copyTexture(uint64_t textureId, const AtlasPlacement &placement, std::vector<uint8_t> &atlasBlocks, std::ostream &log) const;
+
+private:
+	std::string textureDir;
+	std::unordered_map<uint64_t, AtlasPlacement> placements;
+	std::vector<uint32_t> atlasHeights;
+};
@@ -0,0 +1,122 @@
+#include "TextureQueue.h"
+#include "Material.h"
+#include "Stopwatch.h"
+
+#include <sstream>
+
+
+TextureQueue::TextureQueue(ThreadPool *pool, ConversionCache *cache, ConversionStats *stats, AssetSource &source, const std::string &textureDir, std::ostream &log, std::mutex &logMutex)
+	: pool(pool), cache(cache), stats(stats), source(source), textureDir(textureDir), verbose(false), log(log), logMutex(logMutex)
+{
+}
+
+void TextureQueue::setVerbose(bool verbose)
+{
+	this->verbose = verbose;
+}
+
+const std::string &TextureQueue::getTextureDir() const
+{
+	return this->textureDir;
+}
+
+void TextureQueue::request(uint64_t textureId)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->stateMutex);
+		// Looked up first, inserting makes a node even if the texture is known
+		if (this->textures.find(textureId) != this->textures.end()) return;
+		this->textures.insert(std::make_pair(textureId, Queued));
+	}
+
+	if (this->pool == nullptr) {
+		if (this->claim(textureId)) this->convert(textureId);
+		return;
+	}
+	this->pool->submit([this, textureId](unsigned int) {
+		if (this->claim(textureId)) this->convert(textureId);
+	});
+}
+
+void TextureQueue::waitFor(uint64_t textureId)
+{
+	std::unique_lock<std::mutex> lock(this->stateMutex);
+	State &state = this->textures.insert(std::make_pair(textureId, Queued)).first->second;
+	if (state == Queued) { // Nobody has started it yet, so it is converted right here.
+		state = Converting;
+		lock.unlock();
+		this->convert(textureId);
+		return;
+	}
+	while (this->textures[textureId] != Done) {
+		this->textureDone.wait(lock);
+	}
+}
+
+bool TextureQueue::claim(uint64_t textureId)
+{
+	std::lock_guard<std::mutex> lock(this->stateMutex);
+	State &state = this->textures[textureId];
+	if (state != Queued) return false;
+	state = Converting;
+	return true;
+}
+
+void TextureQueue::convert(uint64_t textureId)
+{
+	Stopwatch stopwatch;
+	// Buffer the messages, so they don't interleave with the output of other threads.
+	std::stringstream textureLog;
+	textureLog << "Texture " << std::hex << textureId << std::dec << ": ";
+
+	CacheEntry entry;
+	uint64_t key = 0;
+	std::string ddsFile = this->textureDir + "dds/" + ConversionCache::getTextureFileName(textureId, ".dds");
+	Asset txtrFile;
+	std::string error;
+	bool loaded = this->source.load(textureId, txtrFile, error);
+	bool cached = false;
+	if (loaded && this->cache != nullptr) {
+		key = ConversionCache::hashBytes(txtrFile.span().data(), txtrFile.span().size());
+		key = ConversionCache::makeKey(key, this->textureDir);
+		cached = this->cache->lookup(ConversionCache::getTextureEntryName(textureId), key, entry);
+	}
+
+	bool success = cached;
+	if (!loaded) {
+		textureLog << error << std::endl;
+	}
+	else if (cached) {
+		textureLog << "Up to date (cached)" << std::endl;
+	}
+	else {
+		success = Material::convertTXTRtoDDS(textureId, txtrFile.span(), this->textureDir, textureLog);
+		if (success && this->cache != nullptr && key != 0) {
+			entry = CacheEntry();
+			entry.key = key;
+			entry.outputFiles.push_back(ddsFile);
+			this->cache->store(ConversionCache::getTextureEntryName(textureId), entry);
+		}
+	}
+
+	if (this->stats != nullptr) {
+		TextureStats textureStats;
+		textureStats.textureId = textureId;
+		textureStats.success = success;
+		textureStats.cached = cached;
+		textureStats.seconds = stopwatch.getSeconds();
+		textureStats.bytesRead = txtrFile.span().size();
+		if (success && !cached) textureStats.bytesWritten = MappedFile::getFileSize(ddsFile);
+		this->stats->addTexture(textureStats);
+	}
+	if (!success || this->verbose) {
+		std::lock_guard<std::mutex> lock(this->logMutex);
+		this->log << textureLog.str();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->stateMutex);
+		this->textures[textureId] = Done;
+	}
+	this->textureDone.notify_all();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "ThreadPool.h"
+#include "ConversionCache.h"
+#include "ConversionStats.h"
+#include "AssetSource.h"
+
+// Converts the TXTR textures of all models to DDS in the background.
+// Every texture id is converted only once per run, no matter how many materials or files reference it.
+class TextureQueue
+{
+public:
+	// The conversions run on the pool, or right away on the calling thread if pool is null.
+	// log is shared with other threads, every write to it is made under logMutex.
+	// With a cache, textures whose TXTR file didn't change since their last conversion are skipped.
+	// With stats, the time and size of every conversion is recorded there.
+	// The TXTR files are read from source, e.g. the archives of the run and the loose files in textureDir. The DDS
+	// files are written to textureDir/dds/.
+	TextureQueue(ThreadPool *pool, ConversionCache *cache, ConversionStats *stats, AssetSource &source, const std::string &textureDir, std::ostream &log, std::mutex &logMutex);
+
+	// Only failed conversions are logged unless verbose is set.
+	void setVerbose(bool verbose);
+
+	// Queues the conversion of the texture unless it was requested before. Doesn't wait for it.
+	void request(uint64_t textureId);
+	// Returns once the texture is converted (successfully or not). A texture that no worker has started yet is
+	// converted on the calling thread, so this never waits for the pool to get to it.
+	void waitFor(uint64_t textureId);
+
+	const std::string &getTextureDir() const;
+
+private:
+	TextureQueue(const TextureQueue &) = delete;
+	TextureQueue &operator=(const TextureQueue &) = delete;
+
+	enum State
+	{
+		Queued,
+		Converting,
+		Done
+	};
+
+	// Takes over a queued texture. Returns false if another thread got it first.
+	bool claim(uint64_t textureId);
+	void convert(uint64_t textureId);
+
+private:
+	ThreadPool *pool;
+	ConversionCache *cache;
+	ConversionStats *stats;
+	AssetSource &source;
+	std::string textureDir;
+	bool verbose;
+	std::ostream &log;
+	std::mutex &logMutex;
+
+	std::mutex stateMutex;
+	std::condition_variable textureDone;
+	std::unordered_map<uint64_t, State> textures;
+};
@@ -0,0 +1,154 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned int threadCount /*= 0*/)
+	: queuedTasks(0), pendingTasks(0), nextQueue(0), stopping(false)
+{
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	if (threadCount == 0) threadCount = hardwareThreads;
+	threadCount = std::min(threadCount, MaxThreadsPerCore * hardwareThreads);
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		this->queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	for (unsigned int i = 0; i < threadCount; i++) {
+		this->workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->stateMutex);
+		this->stopping = true;
+	}
+	this->workAvailable.notify_all();
+	for (size_t i = 0; i < this->workers.size(); i++) {
+		this->workers[i].join();
+	}
+}
+
+void ThreadPool::submit(const Task &task)
+{
+	// The counters are raised before the task becomes visible, so a worker can never pick it up before it is counted.
+	unsigned int queueIndex;
+	{
+		std::lock_guard<std::mutex> lock(this->stateMutex);
+		queueIndex = this->nextQueue;
+		this->nextQueue = (this->nextQueue + 1) % this->queues.size();
+		this->queuedTasks++;
+		this->pendingTasks++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->queues[queueIndex]->mutex);
+		this->queues[queueIndex]->tasks.push_back(task);
+	}
+	this->workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(this->stateMutex);
+	while (this->pendingTasks > 0) {
+		this->allDone.wait(lock);
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &body)
+{
+	if (count == 0) return;
+
+	std::shared_ptr<ParallelLoop> loop = std::make_shared<ParallelLoop>();
+	loop->body = &body;
+	loop->count = count;
+	loop->next = 0;
+	loop->finished = 0;
+
+	size_t helperCount = count - 1 < this->workers.size() ? count - 1 : this->workers.size();
+	for (size_t i = 0; i < helperCount; i++) {
+		this->submit([loop](unsigned int) {
+			runLoopItems(*loop);
+		});
+	}
+	runLoopItems(*loop);
+
+	std::unique_lock<std::mutex> lock(loop->mutex);
+	while (loop->finished < count) {
+		loop->allFinished.wait(lock);
+	}
+}
+
+void ThreadPool::runLoopItems(ParallelLoop &loop)
+{
+	size_t finishedHere = 0;
+	for (size_t i = loop.next++; i < loop.count; i = loop.next++) {
+		(*loop.body)(i);
+		finishedHere++;
+	}
+	if (finishedHere == 0) return;
+
+	std::lock_guard<std::mutex> lock(loop.mutex);
+	loop.finished += finishedHere;
+	if (loop.finished == loop.count) {
+		loop.allFinished.notify_all();
+	}
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+	return static_cast<unsigned int>(this->workers.size());
+}
+
+bool ThreadPool::popTask(unsigned int workerIndex, Task &task)
+{
+	// Own queue first, then steal from the others. Tasks are always taken from the front, so work that was
+	// submitted first (the batch mode submits the biggest files first) is also started first.
+	for (size_t i = 0; i < this->queues.size(); i++) {
+		WorkerQueue &queue = *this->queues[(workerIndex + i) % this->queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(unsigned int workerIndex)
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(this->stateMutex);
+			while (this->queuedTasks == 0 && !this->stopping) {
+				this->workAvailable.wait(lock);
+			}
+			if (this->queuedTasks == 0 && this->stopping) {
+				return;
+			}
+		}
+
+		Task task;
+		if (!this->popTask(workerIndex, task)) {
+			continue; // Somebody else was faster
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->stateMutex);
+			this->queuedTasks--;
+		}
+
+		task(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(this->stateMutex);
+			this->pendingTasks--;
+			if (this->pendingTasks == 0) {
+				this->allDone.notify_all();
+			}
+		}
+	}
+}
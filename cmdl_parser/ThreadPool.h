@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+// A fixed-size pool of worker threads with one task queue per worker.
+// Idle workers steal from the queues of busy workers, so a long task never holds up the tasks queued behind it.
+class ThreadPool
+{
+public:
+	// The argument is the index of the worker thread that runs the task (0 .. getThreadCount() - 1).
+	typedef std::function<void(unsigned int)> Task;
+
+	static const unsigned int MaxThreadsPerCore = 4;
+
+	// A threadCount of 0 uses one thread per hardware thread. More than MaxThreadsPerCore threads per hardware thread
+	// are not started.
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	void submit(const Task &task);
+	// Blocks until every submitted task has finished.
+	void wait();
+	// Runs body(0) .. body(count - 1) on the pool and on the calling thread and returns once all of them have finished.
+	// The calling thread only waits for items that are already running, so this can be called from a task of the pool.
+	void parallelFor(size_t count, const std::function<void(size_t)> &body);
+	unsigned int getThreadCount() const;
+
+private:
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	// Shared by the threads of one parallelFor(). Helpers that start after all items were taken only touch next.
+	struct ParallelLoop
+	{
+		const std::function<void(size_t)> *body;
+		size_t count;
+		std::atomic<size_t> next;
+		std::mutex mutex;
+		std::condition_variable allFinished;
+		size_t finished;
+	};
+
+	void workerLoop(unsigned int workerIndex);
+	bool popTask(unsigned int workerIndex, Task &task);
+	static void runLoopItems(ParallelLoop &loop);
+
+private:
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+	std::mutex stateMutex;
+	std::condition_variable workAvailable;
+	std::condition_variable allDone;
+	size_t queuedTasks;		// Submitted but not yet picked up
+	size_t pendingTasks;	// Submitted but not yet finished
+	unsigned int nextQueue;
+	bool stopping;
+};
@@ -0,0 +1,492 @@
+#include "VertexDecoder.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+#include <math.h>
+#include <limits>
+
+
+// All kernels write count elements to each output array. The vector kernels hand their tail to the scalar ones.
+typedef void (*DecodeShort3Kernel)(const uint8_t *src, size_t count, float scale, float *x, float *y, float *z);
+typedef void (*DecodeFloat3Kernel)(const uint8_t *src, size_t count, float *x, float *y, float *z);
+typedef void (*DecodeUShort2Kernel)(const uint8_t *src, size_t count, float scaleU, float scaleV, float *u, float *v);
+// Extends bounds (min x, y, z, max x, y, z) by the positions of count corners. NaN positions are ignored.
+typedef void (*BoundsKernel)(const IndexTriplet *corners, size_t count, const float *x, const float *y, const float *z, size_t positionCount, float *bounds);
+
+struct DecoderKernels
+{
+	VertexDecoder::InstructionSet instructionSet;
+	DecodeShort3Kernel decodeShort3;
+	DecodeFloat3Kernel decodeFloat3;
+	DecodeUShort2Kernel decodeUShort2;
+	BoundsKernel bounds;
+};
+
+
+// Scalar
+
+static inline uint16_t loadBigEndian16(const uint8_t *src)
+{
+	return static_cast<uint16_t>((src[0] << 8) | src[1]);
+}
+
+static void decodeShort3Scalar(const uint8_t *src, size_t count, float scale, float *x, float *y, float *z)
+{
+	for (size_t i = 0; i < count; i++, src += 6) {
+		x[i] = static_cast<int16_t>(loadBigEndian16(src)) * scale;
+		y[i] = static_cast<int16_t>(loadBigEndian16(src + 2)) * scale;
+		z[i] = static_cast<int16_t>(loadBigEndian16(src + 4)) * scale;
+	}
+}
+
+static void decodeFloat3Scalar(const uint8_t *src, size_t count, float *x, float *y, float *z)
+{
+	float *out[3] = { x, y, z };
+	for (size_t i = 0; i < count; i++) {
+		for (int c = 0; c < 3; c++, src += 4) {
+			uint32_t bits;
+			memcpy(&bits, src, sizeof(bits));
+			bits = _byteswap_ulong(bits);
+			memcpy(&out[c][i], &bits, sizeof(bits));
+		}
+	}
+}
+
+static void decodeUShort2Scalar(const uint8_t *src, size_t count, float scaleU, float scaleV, float *u, float *v)
+{
+	for (size_t i = 0; i < count; i++, src += 4) {
+		u[i] = loadBigEndian16(src) * scaleU;
+		v[i] = loadBigEndian16(src + 2) * scaleV;
+	}
+}
+
+// Written like _mm_min_ps and _mm_max_ps (the second operand if either is NaN), so all kernels give the same bounds.
+static inline float minScalar(float value, float bound) { return value < bound ? value : bound; }
+static inline float maxScalar(float value, float bound) { return value > bound ? value : bound; }
+
+static void boundsScalar(const IndexTriplet *corners, size_t count, const float *x, const float *y, const float *z, size_t positionCount, float *bounds)
+{
+	for (size_t i = 0; i < count; i++) {
+		unsigned int index = corners[i].pos;
+		bool valid = index < positionCount;
+		float px = valid ? x[index] : 0.0f;
+		float py = valid ? y[index] : 0.0f;
+		float pz = valid ? z[index] : 0.0f;
+		bounds[0] = minScalar(px, bounds[0]);
+		bounds[1] = minScalar(py, bounds[1]);
+		bounds[2] = minScalar(pz, bounds[2]);
+		bounds[3] = maxScalar(px, bounds[3]);
+		bounds[4] = maxScalar(py, bounds[4]);
+		bounds[5] = maxScalar(pz, bounds[5]);
+	}
+}
+
+// Folds the lanes of the vector min and max into bounds.
+static void reduceBounds(const float *minX, const float *minY, const float *minZ, const float *maxX, const float *maxY, const float *maxZ, size_t lanes, float *bounds)
+{
+	for (size_t i = 0; i < lanes; i++) {
+		bounds[0] = minScalar(minX[i], bounds[0]);
+		bounds[1] = minScalar(minY[i], bounds[1]);
+		bounds[2] = minScalar(minZ[i], bounds[2]);
+		bounds[3] = maxScalar(maxX[i], bounds[3]);
+		bounds[4] = maxScalar(maxY[i], bounds[4]);
+		bounds[5] = maxScalar(maxZ[i], bounds[5]);
+	}
+}
+
+
+// SSE2
+
+static inline __m128i byteswap16SSE2(__m128i value)
+{
+	return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+static inline __m128i byteswap32SSE2(__m128i value)
+{
+	value = byteswap16SSE2(value);
+	value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3 -> x0..x3, y0..y3, z0..z3
+static inline void deinterleave3SSE2(__m128 a, __m128 b, __m128 c, float *x, float *y, float *z)
+{
+	__m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));	// x2 - x3 -
+	_mm_storeu_ps(x, _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0)));
+
+	__m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1));		// y0 - y1 -
+	bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3));			// y2 - y3 -
+	_mm_storeu_ps(y, _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(2, 0, 2, 0)));
+
+	ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2));			// z0 - z1 -
+	__m128 cc = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0));		// z2 - z3 -
+	_mm_storeu_ps(z, _mm_shuffle_ps(ab, cc, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static inline __m128 signedLowToFloatSSE2(__m128i value, __m128 scale)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16)), scale);
+}
+
+static inline __m128 signedHighToFloatSSE2(__m128i value, __m128 scale)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16)), scale);
+}
+
+static void decodeShort3SSE2(const uint8_t *src, size_t count, float scale, float *x, float *y, float *z)
+{
+	const __m128 scaleVector = _mm_set1_ps(scale);
+	size_t i = 0;
+	// 8 vertices (48 bytes) per iteration
+	for (; i + 8 <= count; i += 8, src += 48) {
+		__m128i r0 = byteswap16SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+		__m128i r1 = byteswap16SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16)));
+		__m128i r2 = byteswap16SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32)));
+
+		deinterleave3SSE2(signedLowToFloatSSE2(r0, scaleVector), signedHighToFloatSSE2(r0, scaleVector), signedLowToFloatSSE2(r1, scaleVector), x + i, y + i, z + i);
+		deinterleave3SSE2(signedHighToFloatSSE2(r1, scaleVector), signedLowToFloatSSE2(r2, scaleVector), signedHighToFloatSSE2(r2, scaleVector), x + i + 4, y + i + 4, z + i + 4);
+	}
+	decodeShort3Scalar(src, count - i, scale, x + i, y + i, z + i);
+}
+
+static void decodeFloat3SSE2(const uint8_t *src, size_t count, float *x, float *y, float *z)
+{
+	size_t i = 0;
+	// 4 vertices (48 bytes) per iteration
+	for (; i + 4 <= count; i += 4, src += 48) {
+		__m128 a = _mm_castsi128_ps(byteswap32SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))));
+		__m128 b = _mm_castsi128_ps(byteswap32SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16))));
+		__m128 c = _mm_castsi128_ps(byteswap32SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32))));
+		deinterleave3SSE2(a, b, c, x + i, y + i, z + i);
+	}
+	decodeFloat3Scalar(src, count - i, x + i, y + i, z + i);
+}
+
+static void decodeUShort2SSE2(const uint8_t *src, size_t count, float scaleU, float scaleV, float *u, float *v)
+{
+	const __m128 scaleVector = _mm_setr_ps(scaleU, scaleV, scaleU, scaleV);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	// 4 uvs (16 bytes) per iteration
+	for (; i + 4 <= count; i += 4, src += 16) {
+		__m128i r = byteswap16SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+		__m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(r, zero)), scaleVector);	// u0 v0 u1 v1
+		__m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(r, zero)), scaleVector);	// u2 v2 u3 v3
+		_mm_storeu_ps(u + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(v + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	decodeUShort2Scalar(src, count - i, scaleU, scaleV, u + i, v + i);
+}
+
+static void boundsSSE2(const IndexTriplet *corners, size_t count, const float *x, const float *y, const float *z, size_t positionCount, float *bounds)
+{
+	__m128 minX = _mm_set1_ps(bounds[0]), minY = _mm_set1_ps(bounds[1]), minZ = _mm_set1_ps(bounds[2]);
+	__m128 maxX = _mm_set1_ps(bounds[3]), maxY = _mm_set1_ps(bounds[4]), maxZ = _mm_set1_ps(bounds[5]);
+	size_t i = 0;
+	// 4 corners per iteration. The positions are gathered one by one, SSE2 has no gather.
+	for (; i + 4 <= count; i += 4) {
+		float px[4], py[4], pz[4];
+		for (int k = 0; k < 4; k++) {
+			unsigned int index = corners[i + k].pos;
+			bool valid = index < positionCount;
+			px[k] = valid ? x[index] : 0.0f;
+			py[k] = valid ? y[index] : 0.0f;
+			pz[k] = valid ? z[index] : 0.0f;
+		}
+		__m128 vx = _mm_loadu_ps(px), vy = _mm_loadu_ps(py), vz = _mm_loadu_ps(pz);
+		minX = _mm_min_ps(vx, minX);
+		minY = _mm_min_ps(vy, minY);
+		minZ = _mm_min_ps(vz, minZ);
+		maxX = _mm_max_ps(vx, maxX);
+		maxY = _mm_max_ps(vy, maxY);
+		maxZ = _mm_max_ps(vz, maxZ);
+	}
+
+	float lanes[6][4];
+	_mm_storeu_ps(lanes[0], minX);
+	_mm_storeu_ps(lanes[1], minY);
+	_mm_storeu_ps(lanes[2], minZ);
+	_mm_storeu_ps(lanes[3], maxX);
+	_mm_storeu_ps(lanes[4], maxY);
+	_mm_storeu_ps(lanes[5], maxZ);
+	reduceBounds(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5], 4, bounds);
+	boundsScalar(corners + i, count - i, x, y, z, positionCount, bounds);
+}
+
+
+// AVX2
+
+static inline __m256i byteswap16AVX2(__m256i value)
+{
+	const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	return _mm256_shuffle_epi8(value, mask);
+}
+
+static inline __m256i byteswap32AVX2(__m256i value)
+{
+	const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	return _mm256_shuffle_epi8(value, mask);
+}
+
+// a, b, c hold the components of 8 interleaved xyz vertices -> x0..x7, y0..y7, z0..z7
+// Every component of a vertex sits at a different position in a, b and c, so two blends and one permute gather it.
+static inline void deinterleave3AVX2(__m256 a, __m256 b, __m256 c, float *x, float *y, float *z)
+{
+	const __m256i xOrder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+	const __m256i yOrder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+	const __m256i zOrder = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+
+	_mm256_storeu_ps(x, _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24), xOrder));
+	_mm256_storeu_ps(y, _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49), yOrder));
+	_mm256_storeu_ps(z, _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92), zOrder));
+}
+
+static inline __m256 signedToFloatAVX2(__m128i value, __m256 scale)
+{
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(value)), scale);
+}
+
+static void decodeShort3AVX2(const uint8_t *src, size_t count, float scale, float *x, float *y, float *z)
+{
+	const __m256 scaleVector = _mm256_set1_ps(scale);
+	size_t i = 0;
+	// 16 vertices (96 bytes) per iteration
+	for (; i + 16 <= count; i += 16, src += 96) {
+		__m256i r0 = byteswap16AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+		__m256i r1 = byteswap16AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32)));
+		__m256i r2 = byteswap16AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 64)));
+
+		deinterleave3AVX2(
+			signedToFloatAVX2(_mm256_castsi256_si128(r0), scaleVector),
+			signedToFloatAVX2(_mm256_extracti128_si256(r0, 1), scaleVector),
+			signedToFloatAVX2(_mm256_castsi256_si128(r1), scaleVector),
+			x + i, y + i, z + i);
+		deinterleave3AVX2(
+			signedToFloatAVX2(_mm256_extracti128_si256(r1, 1), scaleVector),
+			signedToFloatAVX2(_mm256_castsi256_si128(r2), scaleVector),
+			signedToFloatAVX2(_mm256_extracti128_si256(r2, 1), scaleVector),
+			x + i + 8, y + i + 8, z + i + 8);
+	}
+	decodeShort3SSE2(src, count - i, scale, x + i, y + i, z + i);
+}
+
+static void decodeFloat3AVX2(const uint8_t *src, size_t count, float *x, float *y, float *z)
+{
+	size_t i = 0;
+	// 8 vertices (96 bytes) per iteration
+	for (; i + 8 <= count; i += 8, src += 96) {
+		__m256 a = _mm256_castsi256_ps(byteswap32AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src))));
+		__m256 b = _mm256_castsi256_ps(byteswap32AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32))));
+		__m256 c = _mm256_castsi256_ps(byteswap32AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 64))));
+		deinterleave3AVX2(a, b, c, x + i, y + i, z + i);
+	}
+	decodeFloat3SSE2(src, count - i, x + i, y + i, z + i);
+}
+
+static void decodeUShort2AVX2(const uint8_t *src, size_t count, float scaleU, float scaleV, float *u, float *v)
+{
+	const __m256 scaleVector = _mm256_setr_ps(scaleU, scaleV, scaleU, scaleV, scaleU, scaleV, scaleU, scaleV);
+	size_t i = 0;
+	// 8 uvs (32 bytes) per iteration
+	for (; i + 8 <= count; i += 8, src += 32) {
+		__m256i r = byteswap16AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+		__m256 lo = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(r))), scaleVector);		// u0 v0 .. u3 v3
+		__m256 hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(r, 1))), scaleVector);	// u4 v4 .. u7 v7
+
+		// The in-lane shuffle yields u0 u1 u4 u5 | u2 u3 u6 u7, the 64-bit permute puts the pairs back in order.
+		__m256 uLanes = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 vLanes = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm256_storeu_ps(u + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(uLanes), _MM_SHUFFLE(3, 1, 2, 0))));
+		_mm256_storeu_ps(v + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(vLanes), _MM_SHUFFLE(3, 1, 2, 0))));
+	}
+	decodeUShort2SSE2(src, count - i, scaleU, scaleV, u + i, v + i);
+}
+
+static void boundsAVX2(const IndexTriplet *corners, size_t count, const float *x, const float *y, const float *z, size_t positionCount, float *bounds)
+{
+	__m256 minX = _mm256_set1_ps(bounds[0]), minY = _mm256_set1_ps(bounds[1]), minZ = _mm256_set1_ps(bounds[2]);
+	__m256 maxX = _mm256_set1_ps(bounds[3]), maxY = _mm256_set1_ps(bounds[4]), maxZ = _mm256_set1_ps(bounds[5]);
+	const __m256i positionLimit = _mm256_set1_epi32(static_cast<int>(positionCount));
+	const __m256 zero = _mm256_setzero_ps();
+	size_t i = 0;
+	// 8 corners per iteration. Corners past the end of the positions are masked out of the gather and stay 0.
+	for (; i + 8 <= count; i += 8) {
+		const IndexTriplet *c = corners + i;
+		__m256i indices = _mm256_setr_epi32(c[0].pos, c[1].pos, c[2].pos, c[3].pos, c[4].pos, c[5].pos, c[6].pos, c[7].pos);
+		__m256 valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(positionLimit, indices));
+		__m256 vx = _mm256_mask_i32gather_ps(zero, x, indices, valid, 4);
+		__m256 vy = _mm256_mask_i32gather_ps(zero, y, indices, valid, 4);
+		__m256 vz = _mm256_mask_i32gather_ps(zero, z, indices, valid, 4);
+		minX = _mm256_min_ps(vx, minX);
+		minY = _mm256_min_ps(vy, minY);
+		minZ = _mm256_min_ps(vz, minZ);
+		maxX = _mm256_max_ps(vx, maxX);
+		maxY = _mm256_max_ps(vy, maxY);
+		maxZ = _mm256_max_ps(vz, maxZ);
+	}
+
+	float lanes[6][8];
+	_mm256_storeu_ps(lanes[0], minX);
+	_mm256_storeu_ps(lanes[1], minY);
+	_mm256_storeu_ps(lanes[2], minZ);
+	_mm256_storeu_ps(lanes[3], maxX);
+	_mm256_storeu_ps(lanes[4], maxY);
+	_mm256_storeu_ps(lanes[5], maxZ);
+	reduceBounds(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5], 8, bounds);
+	boundsSSE2(corners + i, count - i, x, y, z, positionCount, bounds);
+}
+
+
+// Dispatch
+
+static const DecoderKernels scalarKernels = { VertexDecoder::Scalar, decodeShort3Scalar, decodeFloat3Scalar, decodeUShort2Scalar, boundsScalar };
+static const DecoderKernels sse2Kernels = { VertexDecoder::SSE2, decodeShort3SSE2, decodeFloat3SSE2, decodeUShort2SSE2, boundsSSE2 };
+static const DecoderKernels avx2Kernels = { VertexDecoder::AVX2, decodeShort3AVX2, decodeFloat3AVX2, decodeUShort2AVX2, boundsAVX2 };
+
+static const DecoderKernels *getKernels(VertexDecoder::InstructionSet instructionSet)
+{
+	switch (instructionSet) {
+	case VertexDecoder::AVX2:
+		return &avx2Kernels;
+	case VertexDecoder::SSE2:
+		return &sse2Kernels;
+	default:
+		return &scalarKernels;
+	}
+}
+
+// Selected during static initialization, before any thread can use it.
+static const DecoderKernels *activeKernels = getKernels(VertexDecoder::getSupportedInstructionSet());
+
+VertexDecoder::InstructionSet VertexDecoder::getSupportedInstructionSet()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+	bool hasSSE2 = (cpuInfo[3] & (1 << 26)) != 0;
+	bool hasOSXSAVE = (cpuInfo[2] & (1 << 27)) != 0;
+	bool hasAVX = (cpuInfo[2] & (1 << 28)) != 0;
+
+	// AVX2 also needs the OS to save the ymm registers.
+	if (hasOSXSAVE && hasAVX && maxLeaf >= 7 && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(cpuInfo, 7, 0);
+		if ((cpuInfo[1] & (1 << 5)) != 0) {
+			return AVX2;
+		}
+	}
+	return hasSSE2 ? SSE2 : Scalar;
+}
+
+VertexDecoder::InstructionSet VertexDecoder::getInstructionSet()
+{
+	return activeKernels->instructionSet;
+}
+
+void VertexDecoder::setInstructionSet(InstructionSet instructionSet)
+{
+	if (instructionSet > getSupportedInstructionSet()) instructionSet = getSupportedInstructionSet();
+	activeKernels = getKernels(instructionSet);
+}
+
+const char *VertexDecoder::getInstructionSetName(InstructionSet instructionSet)
+{
+	switch (instructionSet) {
+	case AVX2:
+		return "AVX2";
+	case SSE2:
+		return "SSE2";
+	default:
+		return "Scalar";
+	}
+}
+
+void VertexDecoder::decodeFloatPositions(const ByteSpan &section, AttributeArray3 &positions)
+{
+	size_t count = section.size() / 12; // 12 (3 float a 4 bytes) per Vertex
+	positions.resize(count);
+	if (count == 0) return;
+	activeKernels->decodeFloat3(section.data(), count, positions.x.data(), positions.y.data(), positions.z.data());
+}
+
+void VertexDecoder::decodeQuantizedPositions(const ByteSpan &section, AttributeArray3 &positions)
+{
+	// value / 0x8000 with the wrap around for values >= 1.0 is exactly the signed value / 0x8000,
+	// and a division by a power of two is exactly a multiplication with its reciprocal.
+	size_t count = section.size() / 6; // 6 (3 shorts a 2 bytes) per Vertex
+	positions.resize(count);
+	if (count == 0) return;
+	activeKernels->decodeShort3(section.data(), count, 1.0f / PositionDivisor, positions.x.data(), positions.y.data(), positions.z.data());
+}
+
+void VertexDecoder::decodeNormals(const ByteSpan &section, AttributeArray3 &normals)
+{
+	size_t count = section.size() / 6; // 6 (3 short a 2 bytes) per Vertex
+	normals.resize(count);
+	if (count == 0) return;
+	activeKernels->decodeShort3(section.data(), count, 1.0f / NormalDivisor, normals.x.data(), normals.y.data(), normals.z.data());
+}
+
+void VertexDecoder::decodeUvs(const ByteSpan &section, AttributeArray2 &uvs)
+{
+	size_t count = section.size() / 4; // 4 (2 short a 2 bytes) per Vertex
+	uvs.resize(count);
+	if (count == 0) return;
+	activeKernels->decodeUShort2(section.data(), count, 1.0f / UvDivisor, -1.0f / UvDivisor, uvs.u.data(), uvs.v.data());
+}
+
+void VertexDecoder::computeBounds(const AttributeArray3 &positions, Submesh &submesh)
+{
+	const float infinity = std::numeric_limits<float>::infinity();
+	float bounds[6] = { infinity, infinity, infinity, -infinity, -infinity, -infinity };
+	const ArenaVector<IndexTriplet> *lists[2] = { &submesh.indices, &submesh.stripCorners };
+	for (int l = 0; l < 2; l++) {
+		if (lists[l]->empty()) continue;
+		activeKernels->bounds(lists[l]->data(), lists[l]->size(), positions.x.data(), positions.y.data(), positions.z.data(), positions.size(), bounds);
+	}
+
+	// Without corners (or with NaN positions only) the infinities are left, they become 0.
+	// + 0.0f turns -0.0 into 0.0, which of the two a kernel keeps depends on the order of the corners.
+	for (int c = 0; c < 3; c++) {
+		bool empty = !(bounds[c] <= bounds[c + 3]);
+		bounds[c] = empty ? 0.0f : bounds[c] + 0.0f;
+		bounds[c + 3] = empty ? 0.0f : bounds[c + 3] + 0.0f;
+	}
+	submesh.boundingBox[0].x = bounds[0];
+	submesh.boundingBox[0].y = bounds[1];
+	submesh.boundingBox[0].z = bounds[2];
+	submesh.boundingBox[1].x = bounds[3];
+	submesh.boundingBox[1].y = bounds[4];
+	submesh.boundingBox[1].z = bounds[5];
+}
+
+// value * divisor rounded and clamped to [min, max]. nan gives 0.
+static int quantize(float value, int divisor, int min, int max)
+{
+	float scaled = value * divisor;
+	if (!(scaled >= min)) return (scaled < min) ? min : 0;
+	if (scaled >= max) return max;
+	return static_cast<int>(floorf(scaled + 0.5f));
+}
+
+int16_t VertexDecoder::quantizePosition(float value)
+{
+	return static_cast<int16_t>(quantize(value, PositionDivisor, -0x8000, 0x7FFF));
+}
+
+int16_t VertexDecoder::quantizeNormal(float value)
+{
+	return static_cast<int16_t>(quantize(value, NormalDivisor, -0x8000, 0x7FFF));
+}
+
+uint16_t VertexDecoder::quantizeU(float u)
+{
+	return static_cast<uint16_t>(quantize(u, UvDivisor, 0, 0xFFFF));
+}
+
+uint16_t VertexDecoder::quantizeV(float v)
+{
+	return static_cast<uint16_t>(quantize(-v, UvDivisor, 0, 0xFFFF));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+// Byteswaps and dequantizes whole vertex attribute sections in bulk, and computes the bounds of decoded submeshes.
+// The kernels are picked at runtime from what the CPU supports (AVX2, SSE2 or plain scalar code).
+// All of them produce bit-identical results.
+class VertexDecoder
+{
+public:
+	enum InstructionSet
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	// Divisors of the 16-bit fixed point attributes
+	static const int PositionDivisor = 0x8000;
+	static const int NormalDivisor = 0x4000;
+	static const int UvDivisor = 0x2000;
+
+	static InstructionSet getSupportedInstructionSet();
+	static InstructionSet getInstructionSet();
+	// Forces a specific kernel set (it is clamped to what the CPU supports). Not thread safe, call it before any decoding.
+	static void setInstructionSet(InstructionSet instructionSet);
+	static const char *getInstructionSetName(InstructionSet instructionSet);
+
+	// 3 big-endian floats per vertex.
+	static void decodeFloatPositions(const ByteSpan &section, AttributeArray3 &positions);
+	// 3 big-endian 16-bit values per vertex (header flag 0x20). value / 0x8000, values >= 1.0 wrap around to -2.0 + value.
+	static void decodeQuantizedPositions(const ByteSpan &section, AttributeArray3 &positions);
+	// 3 big-endian signed shorts per normal. value / 0x4000
+	static void decodeNormals(const ByteSpan &section, AttributeArray3 &normals);
+	// 2 big-endian unsigned shorts per uv. value / 0x2000, v is flipped.
+	static void decodeUvs(const ByteSpan &section, AttributeArray2 &uvs);
+
+	// Sets Submesh::boundingBox to the min and max of the positions its triangles and strips use. Corners past the
+	// end of the positions count as the origin, like in the writers. A submesh without corners gets an empty box at the origin.
+	static void computeBounds(const AttributeArray3 &positions, Submesh &submesh);
+
+	// The integers of the file back from the decoded values. Every decoded value is exactly integer / divisor, so
+	// nothing is lost. Other values are rounded and clamped to the range of the integers.
+	static int16_t quantizePosition(float value);
+	static int16_t quantizeNormal(float value);
+	static uint16_t quantizeU(float u);
+	static uint16_t quantizeV(float v);	// Flipped back
+};
@@ -0,0 +1,61 @@
+#include "VertexFormat.h"
+
+
+VertexFormat::VertexFormat()
+	: bytesToSkip(0), hasNormal(false), colorCount(0), uvCount(0), positionOffset(0), normalOffset(0), uvOffset(0), stride(2)
+{
+}
+
+VertexFormat VertexFormat::fromAttributeFlags(uint32_t flags)
+{
+	VertexFormat format;
+	if ((flags & 0xFF000000) == 0x1000000) format.bytesToSkip = 1;	// Don't know if this is completely true yet, but this happens from time to time...
+	if ((flags & 0xFF000000) == 0x3000000) format.bytesToSkip = 2;
+	if ((flags & 0xC) == 0xC) format.hasNormal = true;
+
+	switch (flags & 0xF0) {
+	case 0x30:
+	case 0xC0:
+		format.colorCount = 1;
+		break;
+	case 0xF0:
+		format.colorCount = 2;
+		break;
+	}
+
+	switch (flags & 0x3FFF00) {
+	case 0x0:
+		format.uvCount = 0;
+		break;
+	case 0x300:
+		format.uvCount = 1;
+		break;
+	case 0xF00:
+		format.uvCount = 2;
+		break;
+	case 0x3F00:
+		format.uvCount = 3;
+		break;
+	case 0xFF00:
+		format.uvCount = 4;
+		break;
+	case 0x3FF00:
+		format.uvCount = 5;
+		break;
+	case 0xFFF00:
+		format.uvCount = 6;
+		break;
+	case 0x3FFF00:
+		format.uvCount = 7;
+		break;
+	default:
+		format.uvCount = 2;
+		break;
+	}
+
+	format.positionOffset = format.bytesToSkip;
+	format.normalOffset = format.positionOffset + 2;
+	format.uvOffset = format.normalOffset + (format.hasNormal ? 2 : 0) + 2 * format.colorCount; // Colors are skipped
+	format.stride = format.uvOffset + (format.uvCount >= 1 ? 2 : 0);
+	return format;
+}
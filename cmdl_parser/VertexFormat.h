@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The layout of one primitive vertex in a submesh section, worked out once per material from its vertex attribute flags.
+// A primitive vertex is a list of big-endian 16-bit indices: position, normal, colors and UVs.
+struct VertexFormat
+{
+	int bytesToSkip;	// Leading bytes (matrix index?), from the top byte of the flags
+	bool hasNormal;
+	int colorCount;
+	int uvCount;		// UV sets announced by the flags. Only the index of the first set is read.
+
+	// Byte offsets of the indices inside a vertex and the size of a vertex
+	size_t positionOffset;
+	size_t normalOffset;
+	size_t uvOffset;
+	size_t stride;
+
+	VertexFormat();
+
+	static VertexFormat fromAttributeFlags(uint32_t flags);
+};
@@ -1,660 +1,572 @@
 #include <vector>
 #include <stdint.h>
-#include <iomanip>
-#include <intrin.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
 #include <memory>
-
-#include "Material.h"
-
-struct float3 {
-	float x;
-	float y;
-	float z;
-};
-
-struct float2 {
-	float u;
-	float v;
-};
-
-struct IndexTriplet {
-	unsigned short pos;
-	unsigned short norm;
-	unsigned short tex;
-};
-
-struct Vertex {
-	float3 position;
-	float3 normal;
-	float2 uv;
-};
-
-struct CMDL_HEADER
+#include <unordered_set>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include "CmdlConverter.h"
+#include "ThreadPool.h"
+#include "TextureQueue.h"
+#include "VertexDecoder.h"
+#include "Benchmark.h"
+#include "SelfTest.h"
+#include "ConversionStats.h"
+#include "Stopwatch.h"
+#include "MeshFile.h"
+#include "CmdlParser.h"
+#include "MaterialLibrary.h"
+#include "TextureAtlas.h"
+#include "PakFile.h"
+#include "LogBuffer.h"
+
+
+// extension in upper case, e.g. ".CMDL"
+static bool hasExtension(const std::string &fileName, const std::string &extension)
 {
-	// 0x00
-	uint32_t flags;
-	float3 boundingBox[2];
-	uint32_t sectionCount; // includes header count
-	uint32_t headerCount; // number of header sections
-	uint32_t materialSetCount;
-	std::vector<uint32_t> sectionSizes;
-} fileHeader;
-
-
-inline void toDWORD(uint32_t& d)
-{
-	uint8_t w1 = d & 0xff;
-	uint8_t w2 = (d >> 8) & 0xff;
-	uint8_t w3 = (d >> 16) & 0xff;
-	uint8_t w4 = d >> 24;
-	d = (w1 << 24) | (w2 << 16) | (w3 << 8) | w4;
+	if (fileName.length() < extension.length()) return false;
+	std::string fileExtension = fileName.substr(fileName.length() - extension.length());
+	std::transform(fileExtension.begin(), fileExtension.end(), fileExtension.begin(), ::toupper);
+	return fileExtension == extension;
 }
 
-inline void toWORD(uint16_t& d)
+static std::string getOutputName(const std::string &inputFile)
 {
-	uint8_t w1 = d & 0xff;
-	uint8_t w2 = (d >> 8) & 0xff;
-	d = (w1 << 8) | w2;
+	size_t slash = inputFile.find_last_of("/\\");
+	std::string name = (slash == std::string::npos) ? inputFile : inputFile.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	if (dot != std::string::npos) name = name.substr(0, dot);
+	return name;
 }
 
-float FloatSwap(float f)
+static void addJob(std::vector<ConversionJob> &jobs, const std::string &inputFile, uint64_t fileSize, const std::string &outputDir)
 {
-	union
-	{
-		float f;
-		unsigned char b[4];
-	} dat1, dat2;
-
-	dat1.f = f;
-	dat2.b[0] = dat1.b[3];
-	dat2.b[1] = dat1.b[2];
-	dat2.b[2] = dat1.b[1];
-	dat2.b[3] = dat1.b[0];
-	return dat2.f;
+	ConversionJob job;
+	job.inputFile = inputFile;
+	job.outputDir = outputDir;
+	job.outputName = getOutputName(inputFile);
+	job.fileSize = fileSize;
+	jobs.push_back(job);
 }
 
-
-void main(int argc, char* argv[])
+// Adds every CMDL file in the directory and all of its subdirectories.
+static void collectDirectory(std::vector<ConversionJob> &jobs, const std::string &directory, const std::string &outputDir)
 {
-	char errBuff[256];
-	char* fileName;
-	if (argc < 2) {
-		std::cout << "No Input file. Using Testfile" << std::endl;
-		fileName = "testing.CMDL";
-	}
-	else {
-		fileName = argv[1];
-	}
-
-	std::ifstream inputFile(fileName, std::ifstream::in | std::ifstream::binary);
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA((directory + "/*").c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) return;
 
-	if (inputFile.fail()) {
-		strerror_s(errBuff, 100, errno);
-		std::cout << "Failed to open input file (ErrorCode: " << errBuff << ")" << std::endl;
-		exit(0);
-	}
-	uint32_t toWaste;
-	inputFile.read(reinterpret_cast<char *>(&toWaste), sizeof(toWaste));
+	do {
+		std::string name = findData.cFileName;
+		if (name == "." || name == "..") continue;
 
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.flags), sizeof(toWaste));
-	toDWORD(fileHeader.flags);
-	std::cout << "Header Flags: " << std::hex << fileHeader.flags << std::dec << std::endl;
-
-	// Min Bounding Box
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[0].x), sizeof(float));
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[0].y), sizeof(float));
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[0].z), sizeof(float));
+		std::string path = directory + "/" + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			collectDirectory(jobs, path, outputDir);
+		}
+		else if (hasExtension(name, ".CMDL")) {
+			uint64_t fileSize = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+			addJob(jobs, path, fileSize, outputDir);
+		}
+	} while (FindNextFileA(findHandle, &findData));
 
-	// Max Bounding Box
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[1].x), sizeof(float));
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[1].y), sizeof(float));
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.boundingBox[1].z), sizeof(float));
+	FindClose(findHandle);
+}
 
-	// Section Count
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.sectionCount), sizeof(fileHeader.sectionCount));
-	toDWORD(fileHeader.sectionCount);
-	std::cout << "Section Count: " << fileHeader.sectionCount << std::endl;
+// The archives given as inputs. They stay open for the whole run, the models and textures are read from them.
+struct InputArchives
+{
+	std::vector<std::unique_ptr<PakFile> > paks;
+	std::unordered_set<uint64_t> modelIds;	// Models shared by several archives are converted once
+};
 
-	// Material Set Count
-	inputFile.read(reinterpret_cast<char *>(&fileHeader.materialSetCount), sizeof(fileHeader.materialSetCount));
-	toDWORD(fileHeader.materialSetCount);
-	std::cout << "Material-Set Count: " << fileHeader.materialSetCount << std::endl;
+// STRG names can hold any character, the output names only the ones that are safe in file names.
+static std::string getResourceOutputName(const PakResource &resource)
+{
+	if (resource.name.empty()) return ConversionCache::getTextureFileName(resource.id, "");
+	std::string name = resource.name;
+	for (size_t i = 0; i < name.length(); i++) {
+		if (!isalnum(static_cast<unsigned char>(name[i])) && name[i] != '_' && name[i] != '-' && name[i] != '.') name[i] = '_';
+	}
+	return name;
+}
 
-	int visibilityGroupSize = 0;
-	if ((fileHeader.flags & 0x10) == 0x10) { // We need to parse/skip visibility groups...
-		inputFile.ignore(4); // Ignore Unknown bytes.
-		uint32_t visGroupCount;
-		inputFile.read(reinterpret_cast<char *>(&visGroupCount), sizeof(visGroupCount)); // We need this to skip the right amount of bytes...
-		toDWORD(visGroupCount);
-		std::cout << "Visibility Group Count: " << visGroupCount << std::endl;
-		visibilityGroupSize = 8;
-		for (unsigned int i = 0; i < visGroupCount; i++) {
-			std::cout << '\t';
-			uint32_t visGroupNameLength;
-			inputFile.read(reinterpret_cast<char *>(&visGroupNameLength), sizeof(visGroupNameLength));
-			toDWORD(visGroupNameLength);
+// Adds every CMDL resource of the archive.
+static void collectArchive(std::vector<ConversionJob> &jobs, InputArchives &archives, const std::string &fileName, const std::string &outputDir)
+{
+	std::unique_ptr<PakFile> pak(new PakFile());
+	if (!pak->open(fileName)) {
+		std::cout << fileName << ": " << pak->getError() << std::endl;
+		return;
+	}
 
-			char* visGroupName = new char[visGroupNameLength];
-			inputFile.read(visGroupName, visGroupNameLength);
-			std::cout << visGroupName << std::endl;
+	const std::vector<PakResource> &resources = pak->getResources();
+	for (size_t i = 0; i < resources.size(); i++) {
+		const PakResource &resource = resources[i];
+		if (resource.type != PakFile::CmdlType || !archives.modelIds.insert(resource.id).second) continue;
+		ConversionJob job;
+		job.outputName = getResourceOutputName(resource);
+		job.inputFile = fileName + ":" + job.outputName;
+		job.outputDir = outputDir;
+		job.fileSize = resource.size;
+		job.source = pak.get();
+		job.assetId = resource.id;
+		jobs.push_back(job);
+	}
+	archives.paks.push_back(std::move(pak));
+}
 
-			delete visGroupName;
-			visibilityGroupSize += (4 + visGroupNameLength);
+// Adds a single file, an archive, a directory, or every line of a file list ("@list.txt").
+static void collectInput(std::vector<ConversionJob> &jobs, InputArchives &archives, const std::string &input, const std::string &outputDir)
+{
+	if (input.length() > 1 && input[0] == '@') {
+		std::ifstream listFile(input.substr(1));
+		if (listFile.fail()) {
+			std::cout << "Failed to open file list " << input.substr(1) << std::endl;
+			return;
 		}
-		inputFile.ignore(20); // Ignore the last 20 bytes (unknown)
-		visibilityGroupSize += 20;
-	}
-	// Section Sizes
-	for (unsigned int i = 0; i < fileHeader.sectionCount; i++) {
-		uint32_t sectionSize;
-		inputFile.read(reinterpret_cast<char *>(&sectionSize), sizeof(sectionSize));
-		toDWORD(sectionSize);
-		fileHeader.sectionSizes.push_back(sectionSize);
+		std::string line;
+		while (std::getline(listFile, line)) {
+			if (!line.empty() && line[line.length() - 1] == '\r') line.erase(line.length() - 1);
+			if (!line.empty()) collectInput(jobs, archives, line, outputDir);
+		}
+		return;
 	}
 
-	std::cout << "Section Sizes: " << std::endl;
-	for (unsigned int i = 0; i < fileHeader.sectionCount; i++) {
-		std::cout << "\tSection" << i << ": " << fileHeader.sectionSizes[i] << std::endl;
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA(input.c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) {
+		std::cout << "Input not found: " << input << std::endl;
+		return;
 	}
+	FindClose(findHandle);
 
-	int headerSize = 40 + visibilityGroupSize + fileHeader.sectionCount * 4;
-	inputFile.ignore(32 - (headerSize % 32)); // Pad this shit...
-
-	// For Debug Purposes
-	std::streamoff curFp = inputFile.tellg();
-	for (unsigned int i = 0; i < 1; i++) { //fileHeader.sectionCount
-		std::stringstream fileName;
-		fileName << "Section" << i << ".sec";
-		std::ofstream debugFiles(fileName.str());
-
-		char* fileBuffer = new char[fileHeader.sectionSizes[i]];
-		inputFile.read(fileBuffer, fileHeader.sectionSizes[i]);
-		debugFiles.write(fileBuffer, fileHeader.sectionSizes[i]);
-
-		debugFiles.close();
-		delete fileBuffer;
+	if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+		collectDirectory(jobs, input, outputDir);
 	}
-	inputFile.seekg(curFp, inputFile.beg);
-
-	// Materials
-	uint32_t sizeRemainder = fileHeader.sectionSizes[0];
-
-	uint32_t materialCount;
-	inputFile.read(reinterpret_cast<char *>(&materialCount), sizeof(materialCount));
-	toDWORD(materialCount);
-
-	sizeRemainder -= 4;
-
-	std::ofstream materialFile("test.mtl");
-
-	std::vector<std::unique_ptr<Material>> materials;
-	for (unsigned int i = 0; i < materialCount; i++) {
-		uint32_t mSize, mFlags;
-		uint32_t curSectionSize = 0;
-
-		inputFile.read(reinterpret_cast<char *>(&mSize), sizeof(mSize));
-		toDWORD(mSize);
-
-		sizeRemainder -= (mSize + 4);
-
-		inputFile.ignore(12);
-		curSectionSize += 12;
-
-		inputFile.read(reinterpret_cast<char *>(&mFlags), sizeof(mFlags));
-		toDWORD(mFlags);
-		std::cout << "Flag" << i << ": " << std::hex << mFlags << std::dec << std::endl;
-		curSectionSize += 4;
-
-		inputFile.ignore(12);
-		curSectionSize += 12;
-
-		std::stringstream matName;
-		matName << "mat" << i;
-		std::unique_ptr<Material> matPtr(new Material(matName.str()));
+	else if (hasExtension(input, ".PAK")) {
+		collectArchive(jobs, archives, input, outputDir);
+	}
+	else {
+		uint64_t fileSize = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+		addJob(jobs, input, fileSize, outputDir);
+	}
+}
 
-		while (curSectionSize < (mSize-4)) { // -4 because we ignore the END
-			uint32_t mSectionType;
+static bool biggerFileFirst(const ConversionJob &a, const ConversionJob &b)
+{
+	return a.fileSize > b.fileSize;
+}
 
-			inputFile.read(reinterpret_cast<char *>(&mSectionType), sizeof(mSectionType));
-			toDWORD(mSectionType);
-			curSectionSize += 4;
+static void writeStats(const ConversionStats *stats, const std::string &statsFile, const Stopwatch &runTime)
+{
+	if (stats == nullptr) return;
+	if (!stats->writeJson(statsFile, runTime.getSeconds())) {
+		std::cout << "Failed to write " << statsFile << std::endl;
+	}
+}
 
-			matPtr->setVertexAttributeFlags(mFlags);
+// Reads the materials of every file and returns the textures that could go into an atlas, each once.
+static std::vector<uint64_t> collectAtlasCandidates(const std::vector<ConversionJob> &jobs, unsigned int threadCount)
+{
+	std::vector<std::vector<uint64_t> > jobTextures(jobs.size());
+	ThreadPool pool(threadCount);
+	pool.parallelFor(jobs.size(), [&jobs, &jobTextures](size_t i) {
+		std::stringstream log;
+		CmdlParser parser(log);
+		Mesh mesh;
+		Asset input;
+		std::string error;
+		// The conversion reports the errors
+		if (jobs[i].source != nullptr) {
+			if (!jobs[i].source->load(jobs[i].assetId, input, error) || !parser.open(input.span())) return;
+		}
+		else if (!parser.open(jobs[i].inputFile, CmdlParser::MapFile)) {
+			return;
+		}
+		if (!parser.parseMaterials(mesh)) return;
+		for (size_t m = 0; m < mesh.materials.size(); m++) {
+			uint64_t textureId = TextureAtlas::getAtlasCandidate(*mesh.materials[m]);
+			if (textureId != 0) jobTextures[i].push_back(textureId);
+		}
+	});
 
-			switch (mSectionType) {
-			case 0x50415353: // PASS Just extract the texture and move on!
-			{
-				uint32_t sectionSize;
-				inputFile.read(reinterpret_cast<char *>(&sectionSize), sizeof(sectionSize));
-				sectionSize = _byteswap_ulong(sectionSize);
+	std::vector<uint64_t> textureIds;
+	for (size_t i = 0; i < jobTextures.size(); i++) {
+		textureIds.insert(textureIds.end(), jobTextures[i].begin(), jobTextures[i].end());
+	}
+	std::sort(textureIds.begin(), textureIds.end());
+	textureIds.erase(std::unique(textureIds.begin(), textureIds.end()), textureIds.end());
+	return textureIds;
+}
 
-				char* sectionBuffer = new char[sectionSize];
-				inputFile.read(sectionBuffer, sectionSize);
+// The files made from all models of the batch, once every model and texture is converted.
+static bool writeBatchFiles(const MaterialLibrary *materialLibrary, const TextureAtlas *atlas, const std::string &outputDir)
+{
+	bool success = true;
+	if (atlas != nullptr) {
+		success = atlas->writeAtlases(std::cout) && success;
+	}
+	if (materialLibrary != nullptr) {
+		std::cout << "Materials: " << materialLibrary->getMaterialCount() << " distinct of " << materialLibrary->getAddedCount() << std::endl;
+		success = materialLibrary->write(outputDir, std::cout) && success;
+	}
+	return success;
+}
 
-				matPtr->addMaterialSection<Pass>(*matPtr.get(), sectionBuffer, sectionSize);
+// Checks .cmesh files completely (-validate) and prints what they hold.
+static bool validateMeshFiles(const std::vector<std::string> &fileNames)
+{
+	bool allValid = true;
+	for (size_t i = 0; i < fileNames.size(); i++) {
+		MeshFileReader reader;
+		if (!reader.open(fileNames[i]) || !reader.validate()) {
+			std::cout << fileNames[i] << ": " << reader.getError() << std::endl;
+			allValid = false;
+			continue;
+		}
+		const MeshFileHeader &header = reader.getHeader();
+		std::cout << fileNames[i] << ": valid, " << header.positionCount << " positions, " << header.normalCount << " normals, "
+			<< header.uvCount << " uvs, " << header.cornerCount / 3 << " triangles, " << header.submeshCount << " submeshes, "
+			<< header.materialCount << " materials" << (header.quantized != 0 ? ", quantized" : "");
+		if (header.bvhNodeCount > 0) std::cout << ", " << header.bvhNodeCount << " BVH nodes";
+		std::cout << std::endl;
+	}
+	return allValid;
+}
 
-				delete sectionBuffer;
-				curSectionSize += (sectionSize + 4);
-				//inputFile.ignore(sectionSize - 16); // -16 because 8 we skipped and 8 for the texture id...
-			}
-			break;
-			case 0x434C5220: // CLR - need to be verified
-			{
-				inputFile.ignore(4); // We ignore the subtype because it is not relevant at the moment...
+// The whole text has to be a decimal number from minimum to maximum.
+static bool parseNumber(const char *text, long minimum, long maximum, long &value)
+{
+	char *end;
+	errno = 0;
+	value = strtol(text, &end, 10);
+	return end != text && *end == '\0' && errno == 0 && value >= minimum && value <= maximum;
+}
 
-				// Extract the rgba value
-				uint32_t rgba;
-				inputFile.read(reinterpret_cast<char *>(&rgba), sizeof(rgba));
-				rgba = _byteswap_ulong(rgba);
+static void printUsage()
+{
+	std::cout << "Usage: cmdl_parser [-o <output dir>] [-cache <dir>] [-stats <file>] [-v] [-j <threads>] [-format obj,glb,cmesh] [-embed] [-fixed <digits>] [-simd scalar|sse2|avx2] [-stream] [-strips] [-optimize] [-quantize] [-bvh] [-sharedmtl] [-atlas] [-groups <name>,...] [-splitgroups] <input> [<input> ...]" << std::endl;
+	std::cout << "       cmdl_parser -bench [-o <work dir>]" << std::endl;
+	std::cout << "       cmdl_parser -selftest" << std::endl;
+	std::cout << "       cmdl_parser -validate <X.cmesh> [<X.cmesh> ...]" << std::endl;
+	std::cout << "  <input> is a CMDL file, a PAK archive, a directory (searched recursively for *.CMDL)" << std::endl;
+	std::cout << "  or @<list> with one input per line." << std::endl;
+	std::cout << "  Every input X.CMDL is converted to X.obj and X.mtl in the output directory." << std::endl;
+	std::cout << "  Every model of a PAK archive is converted, named after its name in the archive or its id." << std::endl;
+	std::cout << "  Textures are read from the PAK archives of the run first and from Textures/ otherwise." << std::endl;
+	std::cout << "  -cache keeps a record of finished conversions in <dir> and skips them on the next run," << std::endl;
+	std::cout << "  as long as input, options and outputs are unchanged." << std::endl;
+	std::cout << "  -stats writes the time of every stage and the sizes and counts of every file and texture as JSON." << std::endl;
+	std::cout << "  -v prints the details of every file, by default only failures are reported." << std::endl;
+	std::cout << "  -format selects the outputs: obj (X.obj and X.mtl, the default), glb (binary glTF, X.glb)" << std::endl;
+	std::cout << "  and/or cmesh (binary mesh file that can be mapped and used without parsing, X.cmesh)." << std::endl;
+	std::cout << "  -embed copies the DDS textures into the GLB files instead of referencing Textures/dds/." << std::endl;
+	std::cout << "  -fixed writes OBJ numbers with a fixed number of decimals (0 to 9) instead of the shortest exact text." << std::endl;
+	std::cout << "  -stream reads and writes one submesh at a time, so memory use doesn't grow with the file size (OBJ only)." << std::endl;
+	std::cout << "  -strips writes triangle strips as strips instead of triangles (GLB only)." << std::endl;
+	std::cout << "  -optimize welds the vertices and reorders triangles and vertices for the GPU vertex cache." << std::endl;
+	std::cout << "  -quantize keeps the 16-bit vertex attributes of the CMDL file instead of floats (GLB and cmesh only)." << std::endl;
+	std::cout << "  -bvh adds a bounding volume hierarchy over the triangles to the cmesh files." << std::endl;
+	std::cout << "  -sharedmtl writes one materials.mtl for all models, with every distinct material once." << std::endl;
+	std::cout << "  -atlas packs the small textures into atlases and moves the UVs of the models into them." << std::endl;
+	std::cout << "  -groups only decodes the submeshes in these visibility groups, the other sections are skipped." << std::endl;
+	std::cout << "  Files without visibility groups are converted whole." << std::endl;
+	std::cout << "  -splitgroups writes every visibility group to its own outputs X_<group>, with only the vertices it uses." << std::endl;
+	std::cout << "  -simd limits the vertex decoding kernels (default: the best the CPU supports)." << std::endl;
+	std::cout << "  -validate checks .cmesh files." << std::endl;
+	std::cout << "  -bench times every conversion stage on generated files in <work dir> (default bench/)." << std::endl;
+	std::cout << "  -selftest checks the primitive decoding against the triangulation of the original converter and the encoding of -stats." << std::endl;
+}
 
-				curSectionSize += 8;
+void main(int argc, char* argv[])
+{
+	Stopwatch runTime;
+	std::string outputDir;
+	std::string cacheDir;
+	std::string statsFile;
+	bool verbose = false;
+	unsigned int threadCount = 0;
+	bool runBenchmark = false;
+	bool runSelfTest = false;
+	bool validate = false;
+	bool sharedMaterials = false;
+	bool buildAtlas = false;
+	ConversionOptions options;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-o" && i + 1 < argc) {
+			outputDir = argv[++i];
+			if (!outputDir.empty() && outputDir[outputDir.length() - 1] != '/' && outputDir[outputDir.length() - 1] != '\\') {
+				outputDir += "/";
 			}
-			break;
-			case 0x494E5420: // INT - need to be verified
-			{
-				inputFile.ignore(4); // We ignore the subtype because it is not relevant at the moment...
-
-				// Extract the rgba value
-				uint32_t rgba;
-				inputFile.read(reinterpret_cast<char *>(&rgba), sizeof(rgba));
-				rgba = _byteswap_ulong(rgba);
-
-				curSectionSize += 8;
+			CreateDirectoryA(outputDir.c_str(), NULL);
+		}
+		else if (arg == "-cache" && i + 1 < argc) {
+			cacheDir = argv[++i];
+		}
+		else if (arg == "-stats" && i + 1 < argc) {
+			statsFile = argv[++i];
+		}
+		else if (arg == "-v") {
+			verbose = true;
+		}
+		else if (arg == "-j" && i + 1 < argc) {
+			long count;
+			if (!parseNumber(argv[++i], 1, LONG_MAX, count)) {
+				std::cout << "-j needs a number of threads above 0, not " << argv[i] << std::endl;
+				printUsage();
+				exit(-1);
 			}
-			break;
-			default:
-				std::cout << "Unknown section type " << reinterpret_cast<char*>(mSectionType) << std::endl;
+			threadCount = static_cast<unsigned int>(count);
+		}
+		else if (arg == "-fixed" && i + 1 < argc) {
+			long digits;
+			if (!parseNumber(argv[++i], 0, NumberFormat::MaxFixedPrecision, digits)) {
+				std::cout << "-fixed needs a number of decimals from 0 to " << NumberFormat::MaxFixedPrecision << ", not " << argv[i] << std::endl;
+				printUsage();
 				exit(-1);
-				break;
 			}
+			options.floatFormat = ObjWriter::Fixed;
+			options.floatPrecision = static_cast<int>(digits);
 		}
-
-		mSize = mSize - curSectionSize;
-		if (mSize < 0) mSize = 0;
-
-		materialFile << matPtr->getMaterialDefinition();
-		materials.push_back(std::move(matPtr));
-		inputFile.ignore(mSize);	 // -20 because -4 + -12 (we ignored) + -4 for the flags + -8 for the ID
-	}
-	inputFile.ignore(sizeRemainder);
-	materialFile.close();
-
-	std::ofstream outFile("check.obj");
-	outFile << "#" << std::endl << "#" << std::endl;
-	outFile << "mtllib test.mtl" << std::endl;
-	// Get the Vertex coordinates.
-	std::vector<float3> positions;
-	uint32_t numVerts = fileHeader.sectionSizes[1] / 12; // 12 (3 float a 4 bytes) per Vertex
-	if ((fileHeader.flags & 0x20) == 0x20) {
-		numVerts = fileHeader.sectionSizes[1] / 6; // 6 (3 shorts a 2 bytes) per Vertex
-	}
-	for (unsigned int i = 0; i < numVerts; i++) {
-		float3 vertexPos;
-		if ((fileHeader.flags & 0x20) == 0x20) {
-			uint16_t x, y, z;
-			inputFile.read(reinterpret_cast<char *>(&x), sizeof(x));
-			inputFile.read(reinterpret_cast<char *>(&y), sizeof(y));
-			inputFile.read(reinterpret_cast<char *>(&z), sizeof(z));
-			toWORD(x);
-			toWORD(y);
-			toWORD(z);
-			vertexPos.x = (float)x / 0x8000;
-			if (vertexPos.x >= 1.0) vertexPos.x = -2.0f + vertexPos.x;
-			vertexPos.y = (float)y / 0x8000;
-			if (vertexPos.y >= 1.0) vertexPos.y = -2.0f + vertexPos.y;
-			vertexPos.z = (float)z / 0x8000;
-			if (vertexPos.z >= 1.0) vertexPos.z = -2.0f + vertexPos.z;
+		else if (arg == "-format" && i + 1 < argc) {
+			std::string formats = argv[++i];
+			options.writeObj = formats.find("obj") != std::string::npos;
+			options.writeGlb = formats.find("glb") != std::string::npos;
+			options.writeCmesh = formats.find("cmesh") != std::string::npos;
+		}
+		else if (arg == "-stream") {
+			options.streamSubmeshes = true;
+		}
+		else if (arg == "-optimize") {
+			options.optimize = true;
+		}
+		else if (arg == "-strips") {
+			options.keepStrips = true;
+		}
+		else if (arg == "-quantize") {
+			options.quantize = true;
+		}
+		else if (arg == "-bvh") {
+			options.buildBvh = true;
+		}
+		else if (arg == "-sharedmtl") {
+			sharedMaterials = true;
+		}
+		else if (arg == "-atlas") {
+			buildAtlas = true;
+		}
+		else if (arg == "-groups" && i + 1 < argc) {
+			std::stringstream groups(argv[++i]);
+			std::string group;
+			while (std::getline(groups, group, ',')) {
+				if (!group.empty()) options.visibilityGroups.push_back(group);
+			}
+		}
+		else if (arg == "-splitgroups") {
+			options.splitGroups = true;
+		}
+		else if (arg == "-embed") {
+			options.glbTextures = GlbWriter::EmbedTextures;
+		}
+		else if (arg == "-simd" && i + 1 < argc) {
+			std::string instructionSet = argv[++i];
+			if (instructionSet == "scalar") VertexDecoder::setInstructionSet(VertexDecoder::Scalar);
+			else if (instructionSet == "sse2") VertexDecoder::setInstructionSet(VertexDecoder::SSE2);
+			else if (instructionSet == "avx2") VertexDecoder::setInstructionSet(VertexDecoder::AVX2);
+		}
+		else if (arg == "-bench") {
+			runBenchmark = true;
+		}
+		else if (arg == "-selftest") {
+			runSelfTest = true;
+		}
+		else if (arg == "-validate") {
+			validate = true;
+		}
+		else if (arg == "-h" || arg == "--help") {
+			printUsage();
+			exit(0);
 		}
 		else {
-			inputFile.read(reinterpret_cast<char *>(&vertexPos.x), sizeof(vertexPos.x));
-			inputFile.read(reinterpret_cast<char *>(&vertexPos.y), sizeof(vertexPos.y));
-			inputFile.read(reinterpret_cast<char *>(&vertexPos.z), sizeof(vertexPos.z));
-			vertexPos.x = FloatSwap(vertexPos.x);
-			vertexPos.y = FloatSwap(vertexPos.y);
-			vertexPos.z = FloatSwap(vertexPos.z);
+			inputs.push_back(arg);
 		}
-		outFile << "v " << vertexPos.x << " " << vertexPos.y << " " << vertexPos.z << std::endl;
 	}
-	if (numVerts > 0) {
-		inputFile.ignore(fileHeader.sectionSizes[1] % numVerts);
+
+	if (runBenchmark) {
+		Benchmark benchmark(outputDir.empty() ? "bench/" : outputDir, 5, std::cout);
+		exit(benchmark.run() ? 0 : -1);
 	}
-	else {
-		inputFile.ignore(fileHeader.sectionSizes[1]);
-	}
-
-	// Get Vertex Normals
-	std::vector<float3> normals;
-	uint32_t numNormals = fileHeader.sectionSizes[2] / 6; // 6 (3 short a 2 bytes) per Vertex
-	for (unsigned int i = 0; i < numNormals; i++) {
-		float3 normal;
-		short x, y, z;
-		inputFile.read(reinterpret_cast<char *>(&x), sizeof(x));
-		inputFile.read(reinterpret_cast<char *>(&y), sizeof(y));
-		inputFile.read(reinterpret_cast<char *>(&z), sizeof(z));
-		x = _byteswap_ushort(x);
-		y = _byteswap_ushort(y);
-		z = _byteswap_ushort(z);
-		//toWORD(x);
-		//toWORD(y);
-		//toWORD(z);
-		normal.x = x / (float)0x4000;
-		normal.y = y / (float)0x4000;
-		normal.z = z / (float)0x4000;
-
-		outFile << "vn " << normal.x << " " << normal.y << " " << normal.z << std::endl;
-	}
-	if (numNormals > 0) {
-		inputFile.ignore(fileHeader.sectionSizes[2] % numNormals);
+	if (runSelfTest) {
+		SelfTest selfTest(20000, 1, std::cout);
+		exit(selfTest.run() ? 0 : -1);
 	}
-	else {
-		inputFile.ignore(fileHeader.sectionSizes[2]);
+	if (validate) {
+		exit(validateMeshFiles(inputs) ? 0 : -1);
 	}
 
-	inputFile.ignore(fileHeader.sectionSizes[3]);
-	inputFile.ignore(fileHeader.sectionSizes[4]);
-
-	// Get Vertex UVs
-	std::vector<float2> uvs;
-	uint32_t numUvs = fileHeader.sectionSizes[5] / 4; // 4 (2 short a 2 bytes) per Vertex
-	for (unsigned int i = 0; i < numUvs; i++) {
-		uint16_t u, v;
-		inputFile.read(reinterpret_cast<char *>(&u), sizeof(u));
-		inputFile.read(reinterpret_cast<char *>(&v), sizeof(v));
-		float2 uv;
-		toWORD(u);
-		toWORD(v);
-		uv.u = (float)u / 0x2000;
-		//if (uv.u >= 1.0)  uv.u = -2.0 + uv.u;
-		uv.v = (float)v / 0x2000;
-		//if (uv.v >= 1.0)  uv.v = -2.0 + uv.v;
-
-		uv.v = -uv.v;
-
-		outFile << "vt " << uv.u << " " << uv.v << std::endl;
+	if (options.streamSubmeshes && (options.writeGlb || options.writeCmesh)) {
+		std::cout << "-stream is ignored, the GLB and cmesh outputs need the whole mesh in memory" << std::endl;
 	}
-	if (numUvs > 0) {
-		inputFile.ignore(fileHeader.sectionSizes[5] % numUvs);
+	else if (options.streamSubmeshes && options.optimize) {
+		std::cout << "-stream is ignored, -optimize needs the whole mesh in memory" << std::endl;
+	}
+	else if (options.streamSubmeshes && buildAtlas) {
+		std::cout << "-stream is ignored, -atlas needs the whole mesh in memory" << std::endl;
+	}
+	else if (options.streamSubmeshes && options.splitGroups) {
+		std::cout << "-stream is ignored, -splitgroups needs the whole mesh in memory" << std::endl;
+	}
+	if (buildAtlas && options.glbTextures == GlbWriter::EmbedTextures) {
+		std::cout << "-embed doesn't apply to atlases, they are written after the models and referenced" << std::endl;
+	}
+	if (sharedMaterials && !options.writeObj) {
+		std::cout << "-sharedmtl only changes the material names, there is no OBJ output" << std::endl;
 	}
-	else {
-		inputFile.ignore(fileHeader.sectionSizes[5]);
-	}
-
-
-	inputFile.ignore(fileHeader.sectionSizes[6]);
-
-	// Get all Submeshes..
-	int stripCnt = 0, fanCnt = 0, trianglesCnt = 0;
-	for (unsigned int i = 7; i < fileHeader.sectionSizes.size(); i++) {
-		bool hasNrm = false;
-		int bytesRead = 0;
-		int bytesToSkip = 0;
-		int numColors, numUVs = 0;
-		inputFile.ignore(0x1A);
-		bytesRead += 0x1A;
-		uint16_t matID;
-		inputFile.read(reinterpret_cast<char *>(&matID), sizeof(matID));
-		bytesRead += 2;
-		toWORD(matID);
-
-		if ((materials[matID]->getVertexAttributeFlags() & 0x3) != 0x3) {
-			std::cout << "FATAAAAAAL" << std::endl;
-			exit(-1);
-		}
-		inputFile.ignore(2);
-		uint16_t unknownFlag;
-		inputFile.read(reinterpret_cast<char *>(&unknownFlag), sizeof(unknownFlag));
-		toWORD(unknownFlag);
-		bytesRead += 4;
-
-		// Set the material file and write it.
-		outFile << "usemtl " << materials[matID]->getMaterialName() << std::endl;
-		outFile << "s off" << std::endl;
-
-		if ((materials[matID]->getVertexAttributeFlags() & 0xFF000000) == 0x1000000) bytesToSkip = 1;	// Don't know if this is completely true yet, but this happens from time to time...
-		if ((materials[matID]->getVertexAttributeFlags() & 0xFF000000) == 0x3000000) bytesToSkip = 2;
-		if ((materials[matID]->getVertexAttributeFlags() & 0xC) == 0xC) hasNrm = true;
-
-		switch (materials[matID]->getVertexAttributeFlags() & 0xF0) {
-		case 0x0:
-			numColors = 0;
-			break;
-		case 0x30:
-			numColors = 1;
-			break;
-		case 0xC0:
-			numColors = 1;
-			break;
-		case 0xF0:
-			numColors = 2;
-			break;
-		}
-
-		switch (materials[matID]->getVertexAttributeFlags() & 0x3FFF00) {
-		case 0x0:
-			numUVs = 0;
-			break;
-		case 0x300:
-			numUVs = 1;
-			break;
-		case 0xF00:
-			numUVs = 2;
-			break;
-		case 0x3F00:
-			numUVs = 3;
-			break;
-		case 0xFF00:
-			numUVs = 4;
-			break;
-		case 0x3FF00:
-			numUVs = 5;
-			break;
-		case 0xFFF00:
-			numUVs = 6;
-			break;
-		case 0x3FFF00:
-			numUVs = 7;
-			break;
-		default:
-			numUVs = 2;
-			break;
-		}
-
-		uint8_t primitveFlag = 1;
-
-		while (primitveFlag != 0) {
-			inputFile.read(reinterpret_cast<char *>(&primitveFlag), sizeof(primitveFlag));
-			bytesRead++;
-			if (primitveFlag == 0) { // This could already be the header of the next section...
-				inputFile.seekg(-1, inputFile.cur); // Set the file pointer 1 byte back to we don't get a corrupted header if this was the next section
-				bytesRead--;
-				break;
-			}
-
-			uint16_t primitiveObjectCount;
-			inputFile.read(reinterpret_cast<char *>(&primitiveObjectCount), sizeof(primitiveObjectCount));
-			bytesRead += 2;
-			toWORD(primitiveObjectCount);
-
-			std::vector<uint16_t> curVertices;
-			std::vector<uint16_t> curNormals;
-			std::vector<uint16_t> curUvs;
-
-			switch (primitveFlag & 0xF8) {
-			case 0x90: // Triangles
-				trianglesCnt++;
-				for (int x = 0; x < (primitiveObjectCount / 3); x++) {
-					outFile << "f ";
-					for (unsigned y = 0; y < 3; y++) {
-
-						inputFile.ignore(bytesToSkip);
-						bytesRead += bytesToSkip;
-
-						uint16_t indexPosition, indexNormal, indexUV;
-						inputFile.read(reinterpret_cast<char *>(&indexPosition), sizeof(indexPosition));
-						bytesRead += 2;
-						toWORD(indexPosition);
-
-						if (hasNrm) {
-							inputFile.read(reinterpret_cast<char *>(&indexNormal), sizeof(indexNormal));
-							bytesRead += 2;
-							toWORD(indexNormal);
-						}
-
-						inputFile.ignore(2 * numColors); // Ignore the Color Values (most of the time there aren't present anyways..
-						bytesRead += 2 * numColors;
-
-						if (numUVs >= 1) {
-							inputFile.read(reinterpret_cast<char *>(&indexUV), sizeof(indexUV));
-							bytesRead += 2;
-							toWORD(indexUV);
-						}
-
-						outFile << indexPosition + 1 << "/" << (numUVs >= 1 ? std::to_string(indexUV + 1) : "") << "/" << (hasNrm ? std::to_string(indexNormal + 1) : "") << " ";
-					}
-					outFile << std::endl;
-				}
-				break;
-			case 0x98: // Triangle Strip
-				stripCnt++;
-				for (unsigned x = 0; x < primitiveObjectCount; x++) {
-					inputFile.ignore(bytesToSkip);
-					bytesRead += bytesToSkip;
-
-					uint16_t indexPosition, indexNormal, indexUV;
-					inputFile.read(reinterpret_cast<char *>(&indexPosition), sizeof(indexPosition));
-					bytesRead += 2;
-					toWORD(indexPosition);
-
-					if (hasNrm) {
-						inputFile.read(reinterpret_cast<char *>(&indexNormal), sizeof(indexNormal));
-						bytesRead += 2;
-						toWORD(indexNormal);
-					}
-
-					inputFile.ignore(2 * numColors); // Ignore the Color Values (most of the time there aren't present anyways..
-					bytesRead += 2 * numColors;
-
-					if (numUVs >= 1) {
-						inputFile.read(reinterpret_cast<char *>(&indexUV), sizeof(indexUV));
-						bytesRead += 2;
-						toWORD(indexUV);
-					}
-
-					curVertices.push_back(indexPosition);
-					curNormals.push_back(indexNormal);
-					curUvs.push_back(indexUV);
-				}
-
-				for (unsigned x = 2; x < curVertices.size(); x++) {
-					// We do we do this?
-					if (x % 2 != 0) {
-						outFile << "f ";
-						outFile << curVertices[x] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x] + 1) : "") << " ";
-						outFile << curVertices[x - 1] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x - 1] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x - 1] + 1) : "") << " ";
-						outFile << curVertices[x - 2] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x - 2] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x - 2] + 1) : "") << " ";
-						outFile << std::endl;
-					}
-					else {
-						outFile << "f ";
-						outFile << curVertices[x - 2] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x - 2] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x - 2] + 1) : "") << " ";
-						outFile << curVertices[x - 1] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x - 1] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x - 1] + 1) : "") << " ";
-						outFile << curVertices[x] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[x] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[x] + 1) : "") << " ";
-						outFile << std::endl;
-					}
-				}
-				break;
-			case 0xA0: // Triangle Fan
-				fanCnt++;
-	
-				inputFile.ignore(bytesToSkip);
-				bytesRead += bytesToSkip;
-
-				uint16_t centerindexPosition, centerindexNormal, centerindexUV;
-				inputFile.read(reinterpret_cast<char *>(&centerindexPosition), sizeof(centerindexPosition));
-				bytesRead += 2;
-				toWORD(centerindexPosition);
-
-				if (hasNrm) {
-					inputFile.read(reinterpret_cast<char *>(&centerindexNormal), sizeof(centerindexNormal));
-					bytesRead += 2;
-					toWORD(centerindexNormal);
-				}
-
-				inputFile.ignore(2 * numColors); // Ignore the Color Values (most of the time there aren't present anyways..
-				bytesRead += 2 * numColors;
 
-				if (numUVs >= 1) {
-					inputFile.read(reinterpret_cast<char *>(&centerindexUV), sizeof(centerindexUV));
-					bytesRead += 2;
-					toWORD(centerindexUV);
-				}
+	if (options.keepStrips && (options.writeObj || options.writeCmesh)) {
+		std::cout << "-strips is ignored, OBJ and cmesh files can only hold triangles" << std::endl;
+	}
+	if (options.quantize && !options.writeGlb && !options.writeCmesh) {
+		std::cout << "-quantize is ignored, OBJ files only hold decimal numbers" << std::endl;
+	}
+	if (options.buildBvh && !options.writeCmesh) {
+		std::cout << "-bvh is ignored, the BVH is written to the cmesh files" << std::endl;
+	}
 
-				for (unsigned int u = 1; u < primitiveObjectCount; u++) {
+	if (inputs.empty()) {
+		std::cout << "No Input file. Using Testfile" << std::endl;
+		inputs.push_back("testing.CMDL");
+	}
 
-					inputFile.ignore(bytesToSkip);
-					bytesRead += bytesToSkip;
+	std::vector<ConversionJob> jobs;
+	InputArchives archives;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		collectInput(jobs, archives, inputs[i], outputDir);
+	}
+	if (jobs.empty()) {
+		std::cout << "Nothing to convert" << std::endl;
+		exit(-1);
+	}
 
-					uint16_t indexPosition, indexNormal, indexUV;
-					inputFile.read(reinterpret_cast<char *>(&indexPosition), sizeof(indexPosition));
-					bytesRead += 2;
-					toWORD(indexPosition);
+	std::unique_ptr<MaterialLibrary> materialLibrary;
+	if (sharedMaterials) {
+		materialLibrary.reset(new MaterialLibrary("materials.mtl"));
+		options.materialLibrary = materialLibrary.get();
+	}
+	// The textures of the models in the archives are usually in the same archives
+	AssetSourceList textureSource;
+	for (size_t i = 0; i < archives.paks.size(); i++) {
+		textureSource.add(archives.paks[i].get());
+	}
+	LooseFileSource textureFiles("Textures/", ".TXTR"); // With trailing slash /
+	textureSource.add(&textureFiles);
+
+	// The layout has to be known before the first model is converted
+	std::unique_ptr<TextureAtlas> atlas;
+	if (buildAtlas) {
+		atlas.reset(new TextureAtlas("Textures/"));
+		atlas->build(collectAtlasCandidates(jobs, threadCount), textureSource, std::cout);
+		options.atlas = atlas.get();
+	}
+	for (size_t i = 0; i < jobs.size(); i++) {
+		jobs[i].options = options;
+	}
 
-					if (hasNrm) {
-						inputFile.read(reinterpret_cast<char *>(&indexNormal), sizeof(indexNormal));
-						bytesRead += 2;
-						toWORD(indexNormal);
-					}
+	std::unique_ptr<ConversionCache> cache;
+	if (!cacheDir.empty()) {
+		cache.reset(new ConversionCache(cacheDir));
+	}
+	// Textures are still cached, models that depend on the whole batch or embed the textures aren't. The model key
+	// only covers the CMDL bytes, so a GLB with an outdated copy of a changed texture would count as up to date.
+	bool embedTextures = options.writeGlb && options.glbTextures == GlbWriter::EmbedTextures;
+	ConversionCache *modelCache = (materialLibrary || atlas || embedTextures) ? nullptr : cache.get();
+
+	std::unique_ptr<ConversionStats> stats;
+	if (!statsFile.empty()) {
+		stats.reset(new ConversionStats());
+	}
 
-					inputFile.ignore(2 * numColors); // Ignore the Color Values (most of the time there aren't present anyways..
-					bytesRead += 2 * numColors;
+	std::mutex logMutex;
+	if (jobs.size() == 1) {
+		// The textures are converted on the pool while the model is converted on this thread.
+		ThreadPool pool(threadCount);
+		TextureQueue textureQueue(&pool, cache.get(), stats.get(), textureSource, "Textures/", std::cout, logMutex); // With trailing slash /
+		textureQueue.setVerbose(verbose);
+		// Without -v the log is only printed if the conversion fails.
+		std::stringstream quietLog;
+		Arena arena;
+		CmdlConverter converter(jobs[0], textureQueue, modelCache, &pool, verbose ? static_cast<std::ostream &>(std::cout) : quietLog, &arena);
+		bool success = converter.convert();
+		pool.wait();
+		success = writeBatchFiles(materialLibrary.get(), atlas.get(), outputDir) && success;
+		if (stats) stats->addFile(converter.getStats());
+		writeStats(stats.get(), statsFile, runTime);
+		if (!success) std::cout << quietLog.str();
+		std::cout << (success ? "Done!" : "Failed!") << std::endl;
+		exit(success ? 0 : -1);
+	}
 
-					if (numUVs >= 1) {
-						inputFile.read(reinterpret_cast<char *>(&indexUV), sizeof(indexUV));
-						bytesRead += 2;
-						toWORD(indexUV);
-					}
+	// Batch mode. The biggest files go first, so the pool can fill the gaps with the small ones.
+	std::stable_sort(jobs.begin(), jobs.end(), biggerFileFirst);
 
-					curVertices.push_back(indexPosition);
-					curNormals.push_back(indexNormal);
-					curUvs.push_back(indexUV);
-				}
+	std::atomic<int> failedJobs(0);
+	{
+		ThreadPool pool(threadCount);
+		// Shared by all files, so a texture used by several models is converted only once.
+		TextureQueue textureQueue(&pool, cache.get(), stats.get(), textureSource, "Textures/", std::cout, logMutex);
+		textureQueue.setVerbose(verbose);
+		std::cout << "Converting " << jobs.size() << " files on " << pool.getThreadCount() << " threads" << std::endl;
+		// One arena and one log buffer per worker, reused for every file the worker converts. A worker runs one
+		// conversion at a time.
+		std::vector<std::unique_ptr<Arena> > arenas;
+		std::vector<std::unique_ptr<LogBuffer> > logBuffers;
+		for (unsigned int i = 0; i < pool.getThreadCount(); i++) {
+			arenas.push_back(std::unique_ptr<Arena>(new Arena()));
+			logBuffers.push_back(std::unique_ptr<LogBuffer>(new LogBuffer()));
+		}
 
-				for (unsigned int l = 1; l < curVertices.size(); l++) {
-					outFile << "f ";
-					outFile << centerindexPosition + 1 << "/" << (numUVs >= 1 ? std::to_string(centerindexUV + 1) : "") << "/" << (hasNrm ? std::to_string(centerindexNormal + 1) : "") << " ";
-					outFile << curVertices[l - 1] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[l - 1] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[l - 1] + 1) : "") << " ";
-					outFile << curVertices[l] + 1 << "/" << (numUVs >= 1 ? std::to_string(curUvs[l] + 1) : "") << "/" << (hasNrm ? std::to_string(curNormals[l] + 1) : "") << " ";
-					outFile << std::endl;
+		for (size_t i = 0; i < jobs.size(); i++) {
+			const ConversionJob &job = jobs[i];
+			ConversionCache *jobCache = modelCache;
+			ConversionStats *jobStats = stats.get();
+			pool.submit([&job, &textureQueue, jobCache, jobStats, verbose, &pool, &arenas, &logBuffers, &logMutex, &failedJobs](unsigned int workerIndex) {
+				// Buffer the log of each file, so the output of parallel jobs doesn't interleave.
+				LogBuffer &logBuffer = *logBuffers[workerIndex];
+				logBuffer.clear();
+				std::ostream log(&logBuffer);
+				CmdlConverter converter(job, textureQueue, jobCache, &pool, log, arenas[workerIndex].get());
+				bool success = converter.convert();
+				if (!success) failedJobs++;
+				if (jobStats != nullptr) jobStats->addFile(converter.getStats());
+
+				// Without -v only failed files are reported.
+				if (!success || verbose) {
+					std::lock_guard<std::mutex> lock(logMutex);
+					std::cout << "== " << job.inputFile << std::endl << logBuffer.getText() << (success ? "Done!" : "Failed!") << std::endl;
 				}
-				break;
-			default: // This could already be the header of the next section...
-				std::cout << "Warning: Encountered unknown primitive Flag (" << std::to_string(primitveFlag) << ") in Section: " << i << " at global offset " << std::hex << inputFile.tellg() << std::dec << std::endl;
-				inputFile.seekg(-3, inputFile.cur); // Set the file pointer 3 bytes (flags and count) back to we don't get a corrupted header if this was the next section
-				bytesRead -= 3;
-				primitveFlag = 0;
-				break;
-			}
+			});
 		}
-		inputFile.ignore(fileHeader.sectionSizes[i] - bytesRead); // We need to ignore the rest of the section because they are 32 byte aligned...
+		pool.wait();
 	}
-	outFile.close();
-
-	std::cout << "Triangles: " << trianglesCnt << std::endl;
-	std::cout << "Fans: " << fanCnt << std::endl;
-	std::cout << "Strips: " << stripCnt << std::endl;
-
-	// Change Byte Order!
-	//fileHeader.boundingBox[0].x = FloatSwap(fileHeader.boundingBox[0].x);
-	//fileHeader.boundingBox[0].y = FloatSwap(fileHeader.boundingBox[0].y);
-	//fileHeader.boundingBox[0].z = FloatSwap(fileHeader.boundingBox[0].z);
-	//fileHeader.boundingBox[1].x = FloatSwap(fileHeader.boundingBox[1].x);
-	//fileHeader.boundingBox[1].y = FloatSwap(fileHeader.boundingBox[1].y);
-	//fileHeader.boundingBox[1].z = FloatSwap(fileHeader.boundingBox[1].z);
-
-	//std::cout << "Min Bounding Box: " << "x: " << fileHeader.boundingBox[0].x << '\t' << "y: " << fileHeader.boundingBox[0].y << '\t' << "z: " << fileHeader.boundingBox[0].z << std::endl;
-	//std::cout << "Max Bounding Box: " << "x: " << fileHeader.boundingBox[1].x << '\t' << "y: " << fileHeader.boundingBox[1].y << '\t' << "z: " << fileHeader.boundingBox[1].z << std::endl;
+	bool batchWritten = writeBatchFiles(materialLibrary.get(), atlas.get(), outputDir);
 
-	std::cout << "Done!" << std::endl;
-	inputFile.close();
-	exit(0);
+	writeStats(stats.get(), statsFile, runTime);
+	std::cout << "Converted " << (jobs.size() - failedJobs) << " of " << jobs.size() << " files" << std::endl;
+	exit(failedJobs == 0 && batchWritten ? 0 : -1);
 }
\ No newline at end of file